@@ -1,7 +1,7 @@
 grammar SimpleLang;
 
 program
-    : stateBlock? functionDeclaration* EOF
+    : typeDeclaration* stateBlock? functionDeclaration* EOF
     ;
 
 stateBlock
@@ -37,9 +37,12 @@ statement
     | statementVariableDeclaration
     | statementVariableAssignment
     | statementTypeVariableAssignment
+    | statementArrayAssignment
+    | statementAppend
     | statementReturn
     | statementIf
     | statementWhile
+    | statementYield
     | statementExpression
     ;
 
@@ -55,6 +58,14 @@ statementTypeVariableAssignment
     : ID '.' ID '=' expression ';'
     ;
 
+statementArrayAssignment
+    : ID '[' expression ']' '=' expression ';'
+    ;
+
+statementAppend
+    : 'append' '(' ID ',' expression ')' ';'
+    ;
+
 statementReturn
     : 'return' expression? ';'
     ;
@@ -67,6 +78,10 @@ statementWhile
     : 'while' '(' expression ')' block
     ;
 
+statementYield
+    : 'yield' ';'
+    ;
+
 statementExpression
     : expressionCallFunction ';'
     ;
@@ -84,6 +99,10 @@ expression
     | expressionCallFunction
     | expressionTypeVariableAccess
     | expressionTypeInitializerList
+    | expressionArrayIndex
+    | expressionArrayLength
+    | expressionVectorConstructor
+    | expressionVectorBuiltin
     | ID
     | literal
     ;
@@ -97,7 +116,23 @@ expressionTypeVariableAccess
     ;
 
 expressionTypeInitializerList
-    : '{' (statementVariableAssignment)* '}'
+    : TYPE_ID '{' (statementVariableAssignment)* '}'
+    ;
+
+expressionArrayIndex
+    : ID '[' expression ']'
+    ;
+
+expressionArrayLength
+    : 'len' '(' expression ')'
+    ;
+
+expressionVectorConstructor
+    : op=('int2' | 'int4' | 'float2' | 'float3' | 'float4') '(' expressionList ')'
+    ;
+
+expressionVectorBuiltin
+    : op=('dot' | 'length') '(' expressionList ')'
     ;
 
 literal
@@ -113,7 +148,13 @@ type
     | 'bool' 
     | 'int'   
     | 'float'
+    | 'int2'
+    | 'int4'
+    | 'float2'
+    | 'float3'
+    | 'float4'
     | TYPE_ID
+    | type '[' ']'
     ;
 
 FLOAT   : [0-9]+ '.' [0-9]*;
@@ -0,0 +1,547 @@
+#include "batch_executor.h"
+
+#include <algorithm>
+
+static bool is_batch_type(Type type) {
+    return type == Type::INT || type == Type::FLOAT || type == Type::BOOL;
+}
+
+static BatchLane int_lane(int value) {
+    BatchLane lane;
+    lane.i = value;
+    return lane;
+}
+
+static BatchLane float_lane(float value) {
+    BatchLane lane;
+    lane.f = value;
+    return lane;
+}
+
+static BatchLane bool_lane(bool value) {
+    return int_lane(value ? 1 : 0);
+}
+
+// The result replaces the left column, which is what stays on the stack
+template<typename Operation>
+static void apply_binary(BatchColumn& left, const BatchColumn& right, Type result_type, Operation operation) {
+    BatchLane* out = left.lanes.data();
+    const BatchLane* in = right.lanes.data();
+
+    for (size_t i = 0, count = left.lanes.size(); i < count; i++) {
+        out[i] = operation(out[i], in[i]);
+    }
+
+    left.type = result_type;
+}
+
+template<typename Operation>
+static void apply_unary(BatchColumn& column, Operation operation) {
+    BatchLane* out = column.lanes.data();
+
+    for (size_t i = 0, count = column.lanes.size(); i < count; i++) {
+        out[i] = operation(out[i]);
+    }
+}
+
+static void copy_masked(const BatchColumn& from, BatchLane* to, const std::vector<unsigned char>& mask) {
+    const BatchLane* in = from.lanes.data();
+
+    for (size_t i = 0, count = mask.size(); i < count; i++) {
+        if (mask[i]) {
+            to[i] = in[i];
+        }
+    }
+}
+
+// Groups that reach the same place run together again
+static void merge_groups(std::vector<BatchGroup>& groups) {
+    for (size_t i = 0; i < groups.size(); i++) {
+        for (size_t j = groups.size() - 1; j > i; j--) {
+            if (groups[j].program_counter != groups[i].program_counter) {
+                continue;
+            }
+
+            for (size_t lane = 0; lane < groups[i].mask.size(); lane++) {
+                groups[i].mask[lane] |= groups[j].mask[lane];
+            }
+
+            groups.erase(groups.begin() + j);
+        }
+    }
+}
+
+// Columns
+
+BatchColumn BatchColumn::from_ints(const std::vector<int>& values) {
+    BatchColumn column;
+    column.type = Type::INT;
+
+    for (int value : values) {
+        column.lanes.push_back(int_lane(value));
+    }
+
+    return column;
+}
+
+BatchColumn BatchColumn::from_floats(const std::vector<float>& values) {
+    BatchColumn column;
+    column.type = Type::FLOAT;
+
+    for (float value : values) {
+        column.lanes.push_back(float_lane(value));
+    }
+
+    return column;
+}
+
+BatchColumn BatchColumn::from_bools(const std::vector<bool>& values) {
+    BatchColumn column;
+    column.type = Type::BOOL;
+
+    for (bool value : values) {
+        column.lanes.push_back(bool_lane(value));
+    }
+
+    return column;
+}
+
+int BatchColumn::get_int(size_t lane) const {
+    return lanes.at(lane).i;
+}
+
+float BatchColumn::get_float(size_t lane) const {
+    return lanes.at(lane).f;
+}
+
+bool BatchColumn::get_bool(size_t lane) const {
+    return lanes.at(lane).i != 0;
+}
+
+// Executor
+
+BatchExecutor::BatchExecutor(const Engine& engine)
+    : m_engine (engine)
+{}
+
+bool BatchExecutor::can_execute(const FunctionHandle& function) const {
+    if (function.type != FunctionType::SCRIPT) {
+        return false;
+    }
+
+    const Function& script_function = m_engine.get_program().functions.at(function.function_index);
+
+    if (!is_batch_type(script_function.return_type)) {
+        return false;
+    }
+
+    for (const Variable& variable : script_function.local_variables) {
+        if (!is_batch_type(variable.type)) {
+            return false;
+        }
+    }
+
+    // Follow every path through the function, checking each operation on the way
+    const std::vector<EngineOp>& operations = m_engine.get_operations();
+    std::vector<bool> visited(operations.size(), false);
+    std::vector<size_t> pending = { m_engine.get_function(function.function_index).code_index };
+
+    while (!pending.empty()) {
+        size_t program_counter = pending.back();
+        pending.pop_back();
+
+        if (program_counter >= operations.size()) {
+            return false;
+        }
+
+        if (visited[program_counter]) {
+            continue;
+        }
+
+        visited[program_counter] = true;
+
+        const EngineOp& op = operations[program_counter];
+
+        switch (op.type) {
+            case OpType::PUSH_LITERAL: {
+                if (!is_batch_type(m_engine.get_constant(op.operand).type)) {
+                    return false;
+                }
+
+                pending.push_back(program_counter + 1);
+                break;
+            }
+            case OpType::JUMP: {
+                pending.push_back(op.operand);
+                break;
+            }
+            case OpType::JUMP_IF_FALSE: {
+                pending.push_back(op.operand);
+                pending.push_back(program_counter + 1);
+                break;
+            }
+            case OpType::RETURN: {
+                break;
+            }
+            case OpType::PUSH_LOCAL:
+            case OpType::STORE_LOCAL:
+            case OpType::POP:
+            case OpType::NOT_BOOL:
+            case OpType::NEGATE_INT:
+            case OpType::NEGATE_FLOAT:
+            case OpType::ADD_INT:
+            case OpType::ADD_FLOAT:
+            case OpType::SUBTRACT_INT:
+            case OpType::SUBTRACT_FLOAT:
+            case OpType::MULTIPLY_INT:
+            case OpType::MULTIPLY_FLOAT:
+            case OpType::DIVIDE_INT:
+            case OpType::DIVIDE_FLOAT:
+            case OpType::EQUALS_BOOL:
+            case OpType::EQUALS_INT:
+            case OpType::EQUALS_FLOAT:
+            case OpType::NOT_EQUALS_BOOL:
+            case OpType::NOT_EQUALS_INT:
+            case OpType::NOT_EQUALS_FLOAT:
+            case OpType::LESS_THAN_INT:
+            case OpType::LESS_THAN_FLOAT:
+            case OpType::GREATER_THAN_INT:
+            case OpType::GREATER_THAN_FLOAT:
+            case OpType::LESS_THAN_EQUALS_INT:
+            case OpType::LESS_THAN_EQUALS_FLOAT:
+            case OpType::GREATER_THAN_EQUALS_INT:
+            case OpType::GREATER_THAN_EQUALS_FLOAT: {
+                pending.push_back(program_counter + 1);
+                break;
+            }
+            default: {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool BatchExecutor::execute(const FunctionHandle& function, const std::vector<BatchColumn>& arguments, BatchColumn& result) {
+    if (!can_execute(function)) {
+        return false;
+    }
+
+    const Function& script_function = m_engine.get_program().functions.at(function.function_index);
+
+    if (arguments.size() != script_function.argument_count) {
+        return false;
+    }
+
+    size_t lane_count = arguments.empty() ? 0 : arguments.front().lanes.size();
+
+    for (size_t i = 0; i < arguments.size(); i++) {
+        const BatchColumn& argument = arguments.at(i);
+
+        if (argument.type != script_function.local_variables.at(i).type || argument.lanes.size() != lane_count) {
+            return false;
+        }
+    }
+
+    result.type = script_function.return_type;
+    result.lanes.resize(lane_count);
+
+    m_locals.resize(m_engine.get_function(function.function_index).frame_size);
+
+    for (size_t first_lane = 0; first_lane < lane_count; first_lane += m_chunk_size) {
+        m_lane_count = std::min(m_chunk_size, lane_count - first_lane);
+        execute_chunk(function, arguments, first_lane, result);
+    }
+
+    return true;
+}
+
+void BatchExecutor::set_chunk_size(size_t chunk_size) {
+    m_chunk_size = std::max<size_t>(chunk_size, 1);
+}
+
+void BatchExecutor::execute_chunk(const FunctionHandle& function, const std::vector<BatchColumn>& arguments, size_t first_lane, BatchColumn& result) {
+    m_stack_size = 0;
+
+    // The function starts by storing its arguments, the same as a call on a fiber
+    for (const BatchColumn& argument : arguments) {
+        BatchColumn& column = push(argument.type);
+        std::copy(argument.lanes.begin() + first_lane, argument.lanes.begin() + first_lane + m_lane_count, column.lanes.begin());
+    }
+
+    std::vector<BatchGroup> groups = {
+        { m_engine.get_function(function.function_index).code_index, std::vector<unsigned char>(m_lane_count, 1) }
+    };
+
+    while (!groups.empty()) {
+        auto behind = std::min_element(groups.begin(), groups.end(),
+            [](const BatchGroup& a, const BatchGroup& b) {
+                return a.program_counter < b.program_counter;
+            }
+        );
+
+        size_t group_index = behind - groups.begin();
+
+        if (!execute_op(groups[group_index], groups, result, first_lane)) {
+            groups.erase(groups.begin() + group_index);
+            continue;
+        }
+
+        if (groups.size() > 1) {
+            merge_groups(groups);
+        }
+    }
+}
+
+bool BatchExecutor::execute_op(BatchGroup& group, std::vector<BatchGroup>& groups, BatchColumn& result, size_t first_lane) {
+    const EngineOp& op = m_engine.get_operations()[group.program_counter];
+    size_t next_program_counter = group.program_counter + 1;
+
+    switch (op.type) {
+        case OpType::PUSH_LITERAL: {
+            const VariableSlot& constant = m_engine.get_constant(op.operand);
+            BatchLane value = int_lane(0);
+
+            switch (constant.type) {
+                case Type::BOOL:  value = bool_lane(std::get<bool>(constant.value)); break;
+                case Type::INT:   value = int_lane(std::get<int>(constant.value)); break;
+                case Type::FLOAT: value = float_lane(std::get<float>(constant.value)); break;
+                default:          break;
+            }
+
+            BatchColumn& column = push(constant.type);
+            std::fill(column.lanes.begin(), column.lanes.end(), value);
+            break;
+        }
+
+        case OpType::PUSH_LOCAL: {
+            const BatchColumn& local = m_locals[op.operand];
+            BatchColumn& column = push(local.type);
+            std::copy(local.lanes.begin(), local.lanes.end(), column.lanes.begin());
+            break;
+        }
+
+        case OpType::STORE_LOCAL: {
+            BatchColumn& local = m_locals[op.operand];
+            local.type = top().type;
+            local.lanes.resize(m_lane_count);
+            copy_masked(top(), local.lanes.data(), group.mask);
+            pop();
+            break;
+        }
+
+        case OpType::POP: {
+            pop();
+            break;
+        }
+
+        case OpType::RETURN: {
+            copy_masked(top(), result.lanes.data() + first_lane, group.mask);
+            pop();
+            return false;
+        }
+
+        case OpType::JUMP: {
+            next_program_counter = op.operand;
+            break;
+        }
+
+        case OpType::JUMP_IF_FALSE: {
+            const BatchColumn& condition = top();
+            size_t jump_count = 0;
+            size_t stay_count = 0;
+
+            for (size_t i = 0; i < m_lane_count; i++) {
+                if (group.mask[i]) {
+                    condition.lanes[i].i ? stay_count++ : jump_count++;
+                }
+            }
+
+            if (stay_count == 0) {
+                next_program_counter = op.operand;
+            }
+
+            // The branch diverged, the lanes that jump carry on as their own group
+            else if (jump_count > 0) {
+                BatchGroup jumped { op.operand, group.mask };
+
+                for (size_t i = 0; i < m_lane_count; i++) {
+                    bool stays = condition.lanes[i].i != 0;
+                    jumped.mask[i] &= !stays;
+                    group.mask[i] &= stays;
+                }
+
+                pop();
+
+                group.program_counter = next_program_counter;
+                groups.push_back(std::move(jumped));
+                return true;
+            }
+
+            pop();
+            break;
+        }
+
+        // Unary
+
+        case OpType::NOT_BOOL: {
+            apply_unary(top(), [](BatchLane a) { return bool_lane(!a.i); });
+            break;
+        }
+        case OpType::NEGATE_INT: {
+            apply_unary(top(), [](BatchLane a) { return int_lane(-a.i); });
+            break;
+        }
+        case OpType::NEGATE_FLOAT: {
+            apply_unary(top(), [](BatchLane a) { return float_lane(-a.f); });
+            break;
+        }
+
+        // Binary
+
+        case OpType::ADD_INT: {
+            apply_binary(top(1), top(0), Type::INT, [](BatchLane a, BatchLane b) { return int_lane(a.i + b.i); });
+            pop();
+            break;
+        }
+        case OpType::ADD_FLOAT: {
+            apply_binary(top(1), top(0), Type::FLOAT, [](BatchLane a, BatchLane b) { return float_lane(a.f + b.f); });
+            pop();
+            break;
+        }
+        case OpType::SUBTRACT_INT: {
+            apply_binary(top(1), top(0), Type::INT, [](BatchLane a, BatchLane b) { return int_lane(a.i - b.i); });
+            pop();
+            break;
+        }
+        case OpType::SUBTRACT_FLOAT: {
+            apply_binary(top(1), top(0), Type::FLOAT, [](BatchLane a, BatchLane b) { return float_lane(a.f - b.f); });
+            pop();
+            break;
+        }
+        case OpType::MULTIPLY_INT: {
+            apply_binary(top(1), top(0), Type::INT, [](BatchLane a, BatchLane b) { return int_lane(a.i * b.i); });
+            pop();
+            break;
+        }
+        case OpType::MULTIPLY_FLOAT: {
+            apply_binary(top(1), top(0), Type::FLOAT, [](BatchLane a, BatchLane b) { return float_lane(a.f * b.f); });
+            pop();
+            break;
+        }
+        case OpType::DIVIDE_INT: {
+            // Lanes outside the group hold whatever was left there, so don't divide them
+            BatchColumn& left = top(1);
+            const BatchColumn& right = top(0);
+
+            for (size_t i = 0; i < m_lane_count; i++) {
+                if (group.mask[i]) {
+                    left.lanes[i].i = left.lanes[i].i / right.lanes[i].i;
+                }
+            }
+
+            pop();
+            break;
+        }
+        case OpType::DIVIDE_FLOAT: {
+            apply_binary(top(1), top(0), Type::FLOAT, [](BatchLane a, BatchLane b) { return float_lane(a.f / b.f); });
+            pop();
+            break;
+        }
+
+        // Comparisons
+
+        case OpType::EQUALS_BOOL:
+        case OpType::EQUALS_INT: {
+            apply_binary(top(1), top(0), Type::BOOL, [](BatchLane a, BatchLane b) { return bool_lane(a.i == b.i); });
+            pop();
+            break;
+        }
+        case OpType::EQUALS_FLOAT: {
+            apply_binary(top(1), top(0), Type::BOOL, [](BatchLane a, BatchLane b) { return bool_lane(a.f == b.f); });
+            pop();
+            break;
+        }
+        case OpType::NOT_EQUALS_BOOL:
+        case OpType::NOT_EQUALS_INT: {
+            apply_binary(top(1), top(0), Type::BOOL, [](BatchLane a, BatchLane b) { return bool_lane(a.i != b.i); });
+            pop();
+            break;
+        }
+        case OpType::NOT_EQUALS_FLOAT: {
+            apply_binary(top(1), top(0), Type::BOOL, [](BatchLane a, BatchLane b) { return bool_lane(a.f != b.f); });
+            pop();
+            break;
+        }
+        case OpType::LESS_THAN_INT: {
+            apply_binary(top(1), top(0), Type::BOOL, [](BatchLane a, BatchLane b) { return bool_lane(a.i < b.i); });
+            pop();
+            break;
+        }
+        case OpType::LESS_THAN_FLOAT: {
+            apply_binary(top(1), top(0), Type::BOOL, [](BatchLane a, BatchLane b) { return bool_lane(a.f < b.f); });
+            pop();
+            break;
+        }
+        case OpType::GREATER_THAN_INT: {
+            apply_binary(top(1), top(0), Type::BOOL, [](BatchLane a, BatchLane b) { return bool_lane(a.i > b.i); });
+            pop();
+            break;
+        }
+        case OpType::GREATER_THAN_FLOAT: {
+            apply_binary(top(1), top(0), Type::BOOL, [](BatchLane a, BatchLane b) { return bool_lane(a.f > b.f); });
+            pop();
+            break;
+        }
+        case OpType::LESS_THAN_EQUALS_INT: {
+            apply_binary(top(1), top(0), Type::BOOL, [](BatchLane a, BatchLane b) { return bool_lane(a.i <= b.i); });
+            pop();
+            break;
+        }
+        case OpType::LESS_THAN_EQUALS_FLOAT: {
+            apply_binary(top(1), top(0), Type::BOOL, [](BatchLane a, BatchLane b) { return bool_lane(a.f <= b.f); });
+            pop();
+            break;
+        }
+        case OpType::GREATER_THAN_EQUALS_INT: {
+            apply_binary(top(1), top(0), Type::BOOL, [](BatchLane a, BatchLane b) { return bool_lane(a.i >= b.i); });
+            pop();
+            break;
+        }
+        case OpType::GREATER_THAN_EQUALS_FLOAT: {
+            apply_binary(top(1), top(0), Type::BOOL, [](BatchLane a, BatchLane b) { return bool_lane(a.f >= b.f); });
+            pop();
+            break;
+        }
+
+        default: {
+            exit(1);
+        }
+    }
+
+    group.program_counter = next_program_counter;
+    return true;
+}
+
+BatchColumn& BatchExecutor::push(Type type) {
+    if (m_stack_size == m_stack.size()) {
+        m_stack.emplace_back();
+    }
+
+    BatchColumn& column = m_stack[m_stack_size];
+    column.type = type;
+    column.lanes.resize(m_lane_count);
+
+    m_stack_size++;
+
+    return column;
+}
+
+BatchColumn& BatchExecutor::top(size_t item_index) {
+    return m_stack[m_stack_size - 1 - item_index];
+}
+
+void BatchExecutor::pop(size_t item_count) {
+    m_stack_size -= item_count;
+}
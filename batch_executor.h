@@ -0,0 +1,80 @@
+#pragma once
+
+#include "engine.h"
+
+#include <vector>
+
+// One value of a lane, bools are stored as 0 or 1 in the int
+union BatchLane {
+    int i;
+    float f;
+};
+
+// Every lane's value of one argument, variable, or stack item, laid out one after another
+struct BatchColumn {
+    Type type = Type::VOID;
+    std::vector<BatchLane> lanes;
+
+    static BatchColumn from_ints(const std::vector<int>& values);
+    static BatchColumn from_floats(const std::vector<float>& values);
+    static BatchColumn from_bools(const std::vector<bool>& values);
+
+    int get_int(size_t lane) const;
+    float get_float(size_t lane) const;
+    bool get_bool(size_t lane) const;
+};
+
+// Lanes that are at the same place in the function, divergent branches split a group
+struct BatchGroup {
+    size_t program_counter;
+    std::vector<unsigned char> mask;
+};
+
+// Runs one script function over many argument tuples in lockstep. Each operation is
+// dispatched once for a whole chunk of lanes and runs as a loop over their columns.
+//
+// When a branch diverges the lanes are split into groups, and the group furthest
+// behind in the function always runs next so groups meet again where the branches
+// join. Branches only happen between statements, where the stack is empty apart
+// from the function's own items, so groups share the stack and only stores into
+// variables and return values need their lane mask.
+//
+// Only functions that take and return ints, floats, or bools, and don't touch
+// globals, strings, arrays, vectors, or other functions can run in a batch.
+class BatchExecutor {
+public:
+    BatchExecutor(const Engine& engine);
+
+    bool can_execute(const FunctionHandle& function) const;
+
+    // Calls the function once per lane of the argument columns and writes each result
+    // into the result column. Returns false if the function can't run in a batch.
+    bool execute(const FunctionHandle& function, const std::vector<BatchColumn>& arguments, BatchColumn& result);
+
+    // Lanes run together, small enough for a chunk's columns to stay in cache
+    void set_chunk_size(size_t chunk_size);
+
+private:
+    void execute_chunk(const FunctionHandle& function, const std::vector<BatchColumn>& arguments, size_t first_lane, BatchColumn& result);
+
+    // Runs one operation for a group, returns false once the group has returned
+    bool execute_op(BatchGroup& group, std::vector<BatchGroup>& groups, BatchColumn& result, size_t first_lane);
+
+    BatchColumn& push(Type type);
+
+    BatchColumn& top(size_t item_index = 0);
+
+    void pop(size_t item_count = 1);
+
+private:
+    const Engine& m_engine;
+
+    size_t m_chunk_size = 1024;
+    size_t m_lane_count = 0;
+
+    // Columns above the stack size are kept so their memory is reused
+    std::vector<BatchColumn> m_stack;
+    size_t m_stack_size = 0;
+
+    std::vector<BatchColumn> m_locals;
+};
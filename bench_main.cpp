@@ -0,0 +1,456 @@
+#include "compiler.h"
+#include "byte_code_vm.h"
+#include "external_function_binding.h"
+#include "heap_allocation_counter.h"
+#include "standard_externals.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// Times a fixed set of scripts, one for each part of the vm and compiler we tune, so
+// every change can be measured against the same workloads.
+//
+//   SimpleLangBench [--filter <name>] [--min-time <ms>] [--json <file or ->]
+//                   [--baseline <json file>] [--threshold <percent>]
+//
+// With a baseline written by --json on an earlier build, each workload is compared
+// against it and the exit code is 1 when any got slower by more than the threshold.
+
+static size_t get_peak_rss_kb() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// Counts the ops a run dispatches, so the timed runs can go without a hook
+class OpCounter : public OpHook {
+public:
+    void before_op(const Fiber&, size_t, OpType) override {
+        count++;
+    }
+
+    void after_op(const Fiber&, size_t, OpType) override {}
+
+    size_t count = 0;
+};
+
+struct Workload {
+    std::string name;
+    std::string text;
+
+    // Times compiling the text instead of running its main
+    bool compile_only = false;
+};
+
+struct WorkloadResult {
+    std::string name;
+    size_t runs = 0;
+    double ns_per_run = 0;
+    double ns_per_op = 0;
+    double instructions_per_second = 0;
+    double allocations_per_run = 0;
+    double vm_allocations_per_run = 0;
+    size_t peak_rss_kb = 0;
+};
+
+static std::string make_large_function() {
+    std::string text = "int large() {\n    int total = 0;\n";
+
+    for (int i = 0; i < 1000; i++) {
+        std::string name = "v" + std::to_string(i);
+        text += "    int " + name + " = total * 2 + " + std::to_string(i) + ";\n";
+        text += "    if (" + name + " > 10) {\n        total = total + " + name + " - 10;\n    }\n";
+    }
+
+    text += "    return total;\n}\n\nvoid main() {}\n";
+    return text;
+}
+
+static std::vector<Workload> make_workloads() {
+    return {
+        {
+            "loop_sum",
+            "void main() {"
+            "    int i = 0;"
+            "    int sum = 0;"
+            "    while (i < 100000) {"
+            "        sum = sum + i;"
+            "        i = i + 1;"
+            "    }"
+            "}"
+        },
+        {
+            "recursive_fib",
+            "int fib(int n) {"
+            "    if (n < 2) {"
+            "        return n;"
+            "    }"
+            "    return fib(n - 1) + fib(n - 2);"
+            "}"
+            ""
+            "void main() {"
+            "    int x = fib(20);"
+            "}"
+        },
+        {
+            "string_compare",
+            "void main() {"
+            "    string a = \"the quick brown fox jumps over the lazy dog\";"
+            "    string b = \"the quick brown fox \" + \"jumps over the lazy dog\";"
+            "    string c = \"the quick brown fox jumps over the lazy cat\";"
+            "    int matches = 0;"
+            "    int i = 0;"
+            "    while (i < 20000) {"
+            "        if (a == b) {"
+            "            matches = matches + 1;"
+            "        }"
+            "        if (a != c) {"
+            "            matches = matches + 1;"
+            "        }"
+            "        i = i + 1;"
+            "    }"
+            "}"
+        },
+        {
+            "external_call_storm",
+            "void main() {"
+            "    int sum = 0;"
+            "    int i = 0;"
+            "    while (i < 20000) {"
+            "        sum = host_add(sum, i);"
+            "        i = i + 1;"
+            "    }"
+            "}"
+        },
+        {
+            "string_passing",
+            "void main() {"
+            "    int i = 0;"
+            "    while (i < 20000) {"
+            "        print(to_string(i));"
+            "        i = i + 1;"
+            "    }"
+            "}"
+        },
+        {
+            "nested_ifs",
+            "void main() {"
+            "    int low = 0;"
+            "    int middle = 0;"
+            "    int high = 0;"
+            "    int i = 0;"
+            "    while (i < 20000) {"
+            "        int bucket = i - i / 100 * 100;"
+            "        if (bucket < 50) {"
+            "            if (bucket < 25) {"
+            "                if (bucket < 10) {"
+            "                    low = low + 1;"
+            "                }"
+            "                if (bucket >= 10) {"
+            "                    middle = middle + 1;"
+            "                }"
+            "            }"
+            "            if (bucket >= 25) {"
+            "                middle = middle + 1;"
+            "            }"
+            "        }"
+            "        if (bucket >= 50) {"
+            "            high = high + 1;"
+            "        }"
+            "        i = i + 1;"
+            "    }"
+            "}"
+        },
+        {
+            "state_block_access",
+            "state {"
+            "    int counter = 0;"
+            "    int total = 0;"
+            "}"
+            ""
+            "void main() {"
+            "    counter = 0;"
+            "    total = 0;"
+            "    int i = 0;"
+            "    while (i < 50000) {"
+            "        counter = counter + 1;"
+            "        total = total + counter;"
+            "        i = i + 1;"
+            "    }"
+            "}"
+        },
+        {
+            "large_function_compile",
+            make_large_function(),
+            true
+        }
+    };
+}
+
+static std::vector<ExternalFunction> make_external_functions() {
+    return {
+        bind_external("host_add", +[](int a, int b) {
+            return a + b;
+        }),
+
+        // Does nothing with the string, so the workload times passing it
+        bind_external("print", +[](std::string_view) {}),
+
+        bind_to_string()
+    };
+}
+
+static double get_median(std::vector<double>& values) {
+    std::sort(values.begin(), values.end());
+    return values.at(values.size() / 2);
+}
+
+// Runs the workload once to warm up, then until min_time has passed and at least a
+// few times, taking the median so a stray slow run doesn't move the result
+static bool run_workload(const Workload& workload, std::chrono::milliseconds min_time, WorkloadResult& result) {
+    std::vector<ExternalFunction> external_functions = make_external_functions();
+    CompilationResults compilation = compile(workload.text, external_functions, false, true);
+
+    if (compilation.error.type != CompilationErrorType::NONE) {
+        fprintf(stderr, "%s: doesn't compile\n", workload.name.c_str());
+        return false;
+    }
+
+    ByteCodeVm vm(compilation.program);
+    size_t op_count = 0;
+
+    if (!workload.compile_only) {
+        OpCounter counter;
+        vm.set_op_hook(&counter);
+        ExecutionStatus status = vm.rerun();
+        vm.set_op_hook(nullptr);
+        op_count = counter.count;
+
+        // A workload that yields or stops early would time only part of its script
+        if (status != ExecutionStatus::COMPLETED || vm.get_is_not_halted()) {
+            fprintf(stderr, "%s: doesn't run to completion\n", workload.name.c_str());
+            return false;
+        }
+    }
+
+    auto run_once = [&]() {
+        if (workload.compile_only) {
+            compile(workload.text, external_functions, false, true);
+        } else {
+            vm.rerun();
+        }
+    };
+
+    run_once();
+    vm.get_memory().reset_stats();
+
+    std::vector<double> samples;
+    size_t heap_allocations = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    while (samples.size() < 5 || std::chrono::steady_clock::now() - start < min_time) {
+        size_t allocations_before = get_heap_allocation_count();
+        auto run_start = std::chrono::steady_clock::now();
+        run_once();
+        auto run_end = std::chrono::steady_clock::now();
+        heap_allocations += get_heap_allocation_count() - allocations_before;
+
+        samples.push_back(std::chrono::duration<double, std::nano>(run_end - run_start).count());
+    }
+
+    result.name = workload.name;
+    result.runs = samples.size();
+    result.ns_per_run = get_median(samples);
+    result.allocations_per_run = static_cast<double>(heap_allocations) / result.runs;
+    result.vm_allocations_per_run = static_cast<double>(vm.get_memory_stats().allocation_count) / result.runs;
+    result.peak_rss_kb = get_peak_rss_kb();
+
+    if (op_count > 0) {
+        result.ns_per_op = result.ns_per_run / op_count;
+        result.instructions_per_second = op_count * 1e9 / result.ns_per_run;
+    }
+
+    return true;
+}
+
+static void write_json(FILE* file, const std::vector<WorkloadResult>& results) {
+    fprintf(file, "{\n  \"workloads\": [\n");
+
+    // One workload per line, which is also what read_baseline() expects
+    for (size_t i = 0; i < results.size(); i++) {
+        const WorkloadResult& result = results.at(i);
+        fprintf(file,
+            "    { \"name\": \"%s\", \"runs\": %zu, \"ns_per_run\": %.1f, \"ns_per_op\": %.3f, "
+            "\"instructions_per_second\": %.0f, \"allocations_per_run\": %.2f, "
+            "\"vm_allocations_per_run\": %.2f, \"peak_rss_kb\": %zu }%s\n",
+            result.name.c_str(), result.runs, result.ns_per_run, result.ns_per_op,
+            result.instructions_per_second, result.allocations_per_run,
+            result.vm_allocations_per_run, result.peak_rss_kb,
+            i + 1 < results.size() ? "," : "");
+    }
+
+    fprintf(file, "  ]\n}\n");
+}
+
+static bool read_json_field(const std::string& line, const std::string& key, std::string& value) {
+    size_t start = line.find("\"" + key + "\": ");
+
+    if (start == std::string::npos) {
+        return false;
+    }
+
+    start += key.size() + 4;
+
+    if (line.at(start) == '"') {
+        size_t end = line.find('"', start + 1);
+        value = line.substr(start + 1, end - start - 1);
+    } else {
+        value = line.substr(start, line.find_first_of(",}", start) - start);
+    }
+
+    return true;
+}
+
+// Reads the ns per run of each workload back out of a file written by write_json()
+static bool read_baseline(const std::string& path, std::map<std::string, double>& baseline) {
+    std::ifstream file(path);
+
+    if (!file) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string name;
+        std::string ns_per_run;
+
+        if (read_json_field(line, "name", name) && read_json_field(line, "ns_per_run", ns_per_run)) {
+            baseline[name] = std::strtod(ns_per_run.c_str(), nullptr);
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    std::string json_path;
+    std::string baseline_path;
+    std::chrono::milliseconds min_time(500);
+    double threshold = 5.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (value && arg == "--filter") {
+            filter = value;
+        } else if (value && arg == "--json") {
+            json_path = value;
+        } else if (value && arg == "--baseline") {
+            baseline_path = value;
+        } else if (value && arg == "--min-time") {
+            min_time = std::chrono::milliseconds(std::strtoul(value, nullptr, 10));
+        } else if (value && arg == "--threshold") {
+            threshold = std::strtod(value, nullptr);
+        } else {
+            fprintf(stderr, "usage: %s [--filter <name>] [--min-time <ms>] [--json <file or ->]\n", argv[0]);
+            fprintf(stderr, "       %*s [--baseline <json file>] [--threshold <percent>]\n", static_cast<int>(strlen(argv[0])), "");
+            return 1;
+        }
+
+        i++;
+    }
+
+    std::map<std::string, double> baseline;
+
+    if (!baseline_path.empty() && !read_baseline(baseline_path, baseline)) {
+        fprintf(stderr, "%s: can't be read\n", baseline_path.c_str());
+        return 1;
+    }
+
+    // The table goes to stderr when the json goes to stdout
+    FILE* table = json_path == "-" ? stderr : stdout;
+    std::vector<WorkloadResult> results;
+    bool regressed = false;
+
+    fprintf(table, "\n%-24s %8s %14s %10s %14s %12s %12s",
+        "workload", "runs", "ns/run", "ns/op", "ops/s", "allocs/run", "vm allocs");
+
+    if (!baseline.empty()) {
+        fprintf(table, " %14s %9s", "baseline", "change");
+    }
+
+    fprintf(table, "\n");
+
+    for (const Workload& workload : make_workloads()) {
+        if (workload.name.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        WorkloadResult result;
+
+        if (!run_workload(workload, min_time, result)) {
+            return 1;
+        }
+
+        fprintf(table, "%-24s %8zu %14.0f %10.2f %14.0f %12.2f %12.2f",
+            result.name.c_str(), result.runs, result.ns_per_run, result.ns_per_op,
+            result.instructions_per_second, result.allocations_per_run, result.vm_allocations_per_run);
+
+        auto it = baseline.find(result.name);
+
+        if (it != baseline.end()) {
+            double change = (result.ns_per_run / it->second - 1.0) * 100.0;
+            bool slower = change > threshold;
+            regressed = regressed || slower;
+
+            fprintf(table, " %14.0f %+8.1f%%%s", it->second, change, slower ? " slower" : "");
+        }
+
+        fprintf(table, "\n");
+        results.push_back(result);
+    }
+
+    fprintf(table, "\npeak rss: %zu kb\n", get_peak_rss_kb());
+
+    if (json_path == "-") {
+        write_json(stdout, results);
+    } else if (!json_path.empty()) {
+        FILE* file = fopen(json_path.c_str(), "w");
+
+        if (!file) {
+            fprintf(stderr, "%s: can't be written\n", json_path.c_str());
+            return 1;
+        }
+
+        write_json(file, results);
+        fclose(file);
+    }
+
+    return regressed ? 1 : 0;
+}
@@ -25,6 +25,7 @@ static const std::unordered_map<BinaryOpMapIn, BinaryOpMapOut, InHash> s_valid =
     // Left         Right         Operator                                  Operation                           Result Type
     {{Type::INT,    Type::INT,    BinaryOperatorType::ADD},                 {OpType::ADD_INT,                   Type::INT}},
     {{Type::FLOAT,  Type::FLOAT,  BinaryOperatorType::ADD},                 {OpType::ADD_FLOAT,                 Type::FLOAT}},
+    {{Type::STRING, Type::STRING, BinaryOperatorType::ADD},                 {OpType::ADD_STRING,                Type::STRING}},
     {{Type::INT,    Type::INT,    BinaryOperatorType::SUBTRACT},            {OpType::SUBTRACT_INT,              Type::INT}},
     {{Type::FLOAT,  Type::FLOAT,  BinaryOperatorType::SUBTRACT},            {OpType::SUBTRACT_FLOAT,            Type::FLOAT}},
     {{Type::INT,    Type::INT,    BinaryOperatorType::MULTIPLY},            {OpType::MULTIPLY_INT,              Type::INT}},
@@ -47,6 +48,46 @@ static const std::unordered_map<BinaryOpMapIn, BinaryOpMapOut, InHash> s_valid =
     {{Type::FLOAT,  Type::FLOAT,  BinaryOperatorType::LESS_THAN_EQUAL},     {OpType::LESS_THAN_EQUALS_FLOAT,    Type::BOOL}},
     {{Type::INT,    Type::INT,    BinaryOperatorType::GREATER_THAN_EQUAL},  {OpType::GREATER_THAN_EQUALS_INT,   Type::BOOL}},
     {{Type::FLOAT,  Type::FLOAT,  BinaryOperatorType::GREATER_THAN_EQUAL},  {OpType::GREATER_THAN_EQUALS_FLOAT, Type::BOOL}},
+
+    // Vectors, scalars on the right scale every lane
+    {{Type::INT2,   Type::INT2,   BinaryOperatorType::ADD},                 {OpType::ADD_INT_VECTOR,                   Type::INT2}},
+    {{Type::INT2,   Type::INT2,   BinaryOperatorType::SUBTRACT},            {OpType::SUBTRACT_INT_VECTOR,              Type::INT2}},
+    {{Type::INT2,   Type::INT2,   BinaryOperatorType::MULTIPLY},            {OpType::MULTIPLY_INT_VECTOR,              Type::INT2}},
+    {{Type::INT2,   Type::INT2,   BinaryOperatorType::DIVIDE},              {OpType::DIVIDE_INT_VECTOR,                Type::INT2}},
+    {{Type::INT2,   Type::INT,    BinaryOperatorType::MULTIPLY},            {OpType::MULTIPLY_INT_VECTOR_SCALAR,       Type::INT2}},
+    {{Type::INT2,   Type::INT2,   BinaryOperatorType::EQUAL},               {OpType::EQUALS_INT_VECTOR,                Type::BOOL}},
+    {{Type::INT2,   Type::INT2,   BinaryOperatorType::NOT_EQUAL},           {OpType::NOT_EQUALS_INT_VECTOR,            Type::BOOL}},
+    {{Type::INT4,   Type::INT4,   BinaryOperatorType::ADD},                 {OpType::ADD_INT_VECTOR,                   Type::INT4}},
+    {{Type::INT4,   Type::INT4,   BinaryOperatorType::SUBTRACT},            {OpType::SUBTRACT_INT_VECTOR,              Type::INT4}},
+    {{Type::INT4,   Type::INT4,   BinaryOperatorType::MULTIPLY},            {OpType::MULTIPLY_INT_VECTOR,              Type::INT4}},
+    {{Type::INT4,   Type::INT4,   BinaryOperatorType::DIVIDE},              {OpType::DIVIDE_INT_VECTOR,                Type::INT4}},
+    {{Type::INT4,   Type::INT,    BinaryOperatorType::MULTIPLY},            {OpType::MULTIPLY_INT_VECTOR_SCALAR,       Type::INT4}},
+    {{Type::INT4,   Type::INT4,   BinaryOperatorType::EQUAL},               {OpType::EQUALS_INT_VECTOR,                Type::BOOL}},
+    {{Type::INT4,   Type::INT4,   BinaryOperatorType::NOT_EQUAL},           {OpType::NOT_EQUALS_INT_VECTOR,            Type::BOOL}},
+    {{Type::FLOAT2, Type::FLOAT2, BinaryOperatorType::ADD},                 {OpType::ADD_FLOAT_VECTOR,                 Type::FLOAT2}},
+    {{Type::FLOAT2, Type::FLOAT2, BinaryOperatorType::SUBTRACT},            {OpType::SUBTRACT_FLOAT_VECTOR,            Type::FLOAT2}},
+    {{Type::FLOAT2, Type::FLOAT2, BinaryOperatorType::MULTIPLY},            {OpType::MULTIPLY_FLOAT_VECTOR,            Type::FLOAT2}},
+    {{Type::FLOAT2, Type::FLOAT2, BinaryOperatorType::DIVIDE},              {OpType::DIVIDE_FLOAT_VECTOR,              Type::FLOAT2}},
+    {{Type::FLOAT2, Type::FLOAT,  BinaryOperatorType::MULTIPLY},            {OpType::MULTIPLY_FLOAT_VECTOR_SCALAR,     Type::FLOAT2}},
+    {{Type::FLOAT2, Type::FLOAT,  BinaryOperatorType::DIVIDE},              {OpType::DIVIDE_FLOAT_VECTOR_SCALAR,       Type::FLOAT2}},
+    {{Type::FLOAT2, Type::FLOAT2, BinaryOperatorType::EQUAL},               {OpType::EQUALS_FLOAT_VECTOR,              Type::BOOL}},
+    {{Type::FLOAT2, Type::FLOAT2, BinaryOperatorType::NOT_EQUAL},           {OpType::NOT_EQUALS_FLOAT_VECTOR,          Type::BOOL}},
+    {{Type::FLOAT3, Type::FLOAT3, BinaryOperatorType::ADD},                 {OpType::ADD_FLOAT_VECTOR,                 Type::FLOAT3}},
+    {{Type::FLOAT3, Type::FLOAT3, BinaryOperatorType::SUBTRACT},            {OpType::SUBTRACT_FLOAT_VECTOR,            Type::FLOAT3}},
+    {{Type::FLOAT3, Type::FLOAT3, BinaryOperatorType::MULTIPLY},            {OpType::MULTIPLY_FLOAT_VECTOR,            Type::FLOAT3}},
+    {{Type::FLOAT3, Type::FLOAT3, BinaryOperatorType::DIVIDE},              {OpType::DIVIDE_FLOAT_VECTOR,              Type::FLOAT3}},
+    {{Type::FLOAT3, Type::FLOAT,  BinaryOperatorType::MULTIPLY},            {OpType::MULTIPLY_FLOAT_VECTOR_SCALAR,     Type::FLOAT3}},
+    {{Type::FLOAT3, Type::FLOAT,  BinaryOperatorType::DIVIDE},              {OpType::DIVIDE_FLOAT_VECTOR_SCALAR,       Type::FLOAT3}},
+    {{Type::FLOAT3, Type::FLOAT3, BinaryOperatorType::EQUAL},               {OpType::EQUALS_FLOAT_VECTOR,              Type::BOOL}},
+    {{Type::FLOAT3, Type::FLOAT3, BinaryOperatorType::NOT_EQUAL},           {OpType::NOT_EQUALS_FLOAT_VECTOR,          Type::BOOL}},
+    {{Type::FLOAT4, Type::FLOAT4, BinaryOperatorType::ADD},                 {OpType::ADD_FLOAT_VECTOR,                 Type::FLOAT4}},
+    {{Type::FLOAT4, Type::FLOAT4, BinaryOperatorType::SUBTRACT},            {OpType::SUBTRACT_FLOAT_VECTOR,            Type::FLOAT4}},
+    {{Type::FLOAT4, Type::FLOAT4, BinaryOperatorType::MULTIPLY},            {OpType::MULTIPLY_FLOAT_VECTOR,            Type::FLOAT4}},
+    {{Type::FLOAT4, Type::FLOAT4, BinaryOperatorType::DIVIDE},              {OpType::DIVIDE_FLOAT_VECTOR,              Type::FLOAT4}},
+    {{Type::FLOAT4, Type::FLOAT,  BinaryOperatorType::MULTIPLY},            {OpType::MULTIPLY_FLOAT_VECTOR_SCALAR,     Type::FLOAT4}},
+    {{Type::FLOAT4, Type::FLOAT,  BinaryOperatorType::DIVIDE},              {OpType::DIVIDE_FLOAT_VECTOR_SCALAR,       Type::FLOAT4}},
+    {{Type::FLOAT4, Type::FLOAT4, BinaryOperatorType::EQUAL},               {OpType::EQUALS_FLOAT_VECTOR,              Type::BOOL}},
+    {{Type::FLOAT4, Type::FLOAT4, BinaryOperatorType::NOT_EQUAL},           {OpType::NOT_EQUALS_FLOAT_VECTOR,          Type::BOOL}},
 }; 
 
 std::optional<BinaryOpMapOut> map_binary_op(Type left_type, Type right_type, BinaryOperatorType op) {
@@ -61,6 +102,7 @@ std::optional<BinaryOpMapOut> map_binary_op(Type left_type, Type right_type, Bin
 CompilationErrorType map_binary_op_validate(Type left_type, Type right_type, BinaryOperatorType op) {
     if (   left_type == Type::STRING 
         && right_type == Type::STRING 
+        && op != BinaryOperatorType::ADD
         && op != BinaryOperatorType::EQUAL 
         && op != BinaryOperatorType::NOT_EQUAL)
     {
@@ -0,0 +1,102 @@
+#include "bump_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+BumpArena::BumpArena(std::pmr::memory_resource* memory, size_t chunk_size)
+    : m_memory     (memory)
+    , m_chunks     (memory)
+    , m_chunk_size (chunk_size)
+{}
+
+BumpArena::BumpArena(BumpArena&& other) noexcept
+    : m_memory            (other.m_memory)
+    , m_chunks            (std::move(other.m_chunks))
+    , m_chunk_size        (other.m_chunk_size)
+    , m_chunk_index       (other.m_chunk_index)
+    , m_offset            (other.m_offset)
+    , m_bytes_used_before (other.m_bytes_used_before)
+{
+    other.m_chunks.clear();
+    other.reset();
+}
+
+BumpArena::~BumpArena() {
+    release();
+}
+
+BumpArena& BumpArena::operator=(BumpArena&& other) noexcept {
+    if (this != &other) {
+        release();
+
+        m_memory = other.m_memory;
+        m_chunks = std::move(other.m_chunks);
+        m_chunk_size = other.m_chunk_size;
+        m_chunk_index = other.m_chunk_index;
+        m_offset = other.m_offset;
+        m_bytes_used_before = other.m_bytes_used_before;
+
+        other.m_chunks.clear();
+        other.reset();
+    }
+
+    return *this;
+}
+
+void* BumpArena::allocate(size_t size, size_t alignment) {
+    while (true) {
+        if (m_chunk_index == m_chunks.size()) {
+            // Big allocations get a chunk of their own size
+            size_t chunk_size = std::max(m_chunk_size, size + alignment);
+            m_chunks.push_back({ static_cast<char*>(m_memory->allocate(chunk_size)), chunk_size });
+        }
+
+        Chunk& chunk = m_chunks[m_chunk_index];
+        uintptr_t base = reinterpret_cast<uintptr_t>(chunk.data);
+        size_t offset = ((base + m_offset + alignment - 1) & ~(alignment - 1)) - base;
+
+        if (offset + size <= chunk.size) {
+            m_offset = offset + size;
+            return chunk.data + offset;
+        }
+
+        m_bytes_used_before += m_offset;
+        m_chunk_index++;
+        m_offset = 0;
+    }
+}
+
+void BumpArena::reset() {
+    m_chunk_index = 0;
+    m_offset = 0;
+    m_bytes_used_before = 0;
+}
+
+void BumpArena::release() {
+    reset();
+
+    for (const Chunk& chunk : m_chunks) {
+        m_memory->deallocate(chunk.data, chunk.size);
+    }
+
+    m_chunks.clear();
+    m_chunks.shrink_to_fit();
+}
+
+bool BumpArena::is_empty() const {
+    return m_chunk_index == 0 && m_offset == 0;
+}
+
+size_t BumpArena::get_bytes_used() const {
+    return m_bytes_used_before + m_offset;
+}
+
+size_t BumpArena::get_bytes_reserved() const {
+    size_t bytes = 0;
+
+    for (const Chunk& chunk : m_chunks) {
+        bytes += chunk.size;
+    }
+
+    return bytes;
+}
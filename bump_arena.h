@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Hands out memory by bumping an offset through chunks it keeps. Nothing is freed on
+// its own, reset() makes all of it available again at once, and the chunks are kept
+// so an arena that has warmed up never goes back to the memory its chunks came from.
+class BumpArena {
+public:
+    explicit BumpArena(std::pmr::memory_resource* memory = std::pmr::get_default_resource(), size_t chunk_size = 16 * 1024);
+
+    BumpArena(const BumpArena&) = delete;
+
+    BumpArena(BumpArena&& other) noexcept;
+
+    ~BumpArena();
+
+    BumpArena& operator=(const BumpArena&) = delete;
+
+    BumpArena& operator=(BumpArena&& other) noexcept;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    void reset();
+
+    // Frees the chunks as well
+    void release();
+
+    bool is_empty() const;
+
+    size_t get_bytes_used() const;
+
+    size_t get_bytes_reserved() const;
+
+private:
+    struct Chunk {
+        char* data;
+        size_t size;
+    };
+
+    std::pmr::memory_resource* m_memory;
+    std::pmr::vector<Chunk> m_chunks;
+    size_t m_chunk_size;
+
+    // The chunk being allocated from, and how far into it
+    size_t m_chunk_index = 0;
+    size_t m_offset = 0;
+
+    // Everything handed out from the chunks before the current one
+    size_t m_bytes_used_before = 0;
+};
@@ -6,8 +6,13 @@ enum class BuiltinType : char {
     BOOL,
     INT,
     FLOAT,
-    OBJECT,
-    OBJECT_POINTER
+    INT2,
+    INT4,
+    FLOAT2,
+    FLOAT3,
+    FLOAT4,
+    OBJECT_POINTER,
+    OBJECT   // struct types are numbered up from here, so this stays last
 };
 
 enum UnaryOperatorType : char {
@@ -40,11 +45,39 @@ enum class OpType {
 
     STORE_VARIABLE,
 
+    // Appends the value on top to a string variable, formatting numbers and bools
+    APPEND_VARIABLE,
+
+    PUSH_FIELD,
+    STORE_FIELD,
+
+    PUSH_INDEX,
+    STORE_INDEX,
+    PUSH_INDEX_UNCHECKED,
+    STORE_INDEX_UNCHECKED,
+    ARRAY_LENGTH,
+
+    // Only produced by the engine when it resolves variables to slots
+
+    PUSH_LOCAL,
+    PUSH_GLOBAL,
+
+    STORE_LOCAL,
+    STORE_GLOBAL,
+
+    APPEND_LOCAL,
+    APPEND_GLOBAL,
+
     CALL_FUNCTION,
     CALL_FUNCTION_EXTERNAL,
     
     RETURN,
 
+    YIELD,
+
+    // Only patched in by a debugger, stops the fiber before the operation it replaced
+    BREAKPOINT,
+
     JUMP,
     JUMP_IF_FALSE,
     
@@ -58,6 +91,7 @@ enum class OpType {
 
     ADD_INT,
     ADD_FLOAT,
+    ADD_STRING,
 
     SUBTRACT_INT,
     SUBTRACT_FLOAT,
@@ -88,7 +122,52 @@ enum class OpType {
     LESS_THAN_EQUALS_FLOAT,
 
     GREATER_THAN_EQUALS_INT,
-    GREATER_THAN_EQUALS_FLOAT
+    GREATER_THAN_EQUALS_FLOAT,
+
+    // Vectors, one operation covers every width with the same lane type
+
+    MAKE_VECTOR,
+    VECTOR_SWIZZLE,
+    VECTOR_INSERT,
+
+    NEGATE_INT_VECTOR,
+    NEGATE_FLOAT_VECTOR,
+
+    ADD_INT_VECTOR,
+    ADD_FLOAT_VECTOR,
+
+    SUBTRACT_INT_VECTOR,
+    SUBTRACT_FLOAT_VECTOR,
+
+    MULTIPLY_INT_VECTOR,
+    MULTIPLY_FLOAT_VECTOR,
+
+    DIVIDE_INT_VECTOR,
+    DIVIDE_FLOAT_VECTOR,
+
+    MULTIPLY_INT_VECTOR_SCALAR,
+    MULTIPLY_FLOAT_VECTOR_SCALAR,
+
+    DIVIDE_FLOAT_VECTOR_SCALAR,
+
+    EQUALS_INT_VECTOR,
+    EQUALS_FLOAT_VECTOR,
+
+    NOT_EQUALS_INT_VECTOR,
+    NOT_EQUALS_FLOAT_VECTOR,
+
+    DOT_INT_VECTOR,
+    DOT_FLOAT_VECTOR,
+
+    LENGTH_FLOAT_VECTOR
+};
+
+enum class ExecutionStatus {
+    RUNNING,
+    COMPLETED,
+    YIELDED,
+    OUT_OF_FUEL,
+    BREAKPOINT
 };
 
 enum class CompilationErrorType {
@@ -99,5 +178,6 @@ enum class CompilationErrorType {
     FUNCTION_CALLED_WITH_WRONG_NUMBER_OF_ARGS,
     IDENTIFIED_NOT_DECLARED,
     IDENTIFIED_ALREADY_DECLARED,
-    MATH_OPERATION_ON_STRING
+    MATH_OPERATION_ON_STRING,
+    TOO_MANY_TYPES
 };
\ No newline at end of file
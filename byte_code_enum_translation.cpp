@@ -1,11 +1,20 @@
 #include "byte_code_enum_translation.h"
 
+#include "byte_code_types.h"
+
 static std::string_view s_type_names[] = {
     "VOID",
     "STRING",
     "BOOL",
     "INT",
-    "FLOAT"
+    "FLOAT",
+    "INT2",
+    "INT4",
+    "FLOAT2",
+    "FLOAT3",
+    "FLOAT4",
+    "OBJECT_POINTER",
+    "OBJECT"
 };
 
 static std::string_view s_op_type_names[] = {
@@ -15,9 +24,25 @@ static std::string_view s_op_type_names[] = {
     "PUSH_VARIABLE",
     "POP",
     "STORE_VARIABLE",
+    "APPEND_VARIABLE",
+    "PUSH_FIELD",
+    "STORE_FIELD",
+    "PUSH_INDEX",
+    "STORE_INDEX",
+    "PUSH_INDEX_UNCHECKED",
+    "STORE_INDEX_UNCHECKED",
+    "ARRAY_LENGTH",
+    "PUSH_LOCAL",
+    "PUSH_GLOBAL",
+    "STORE_LOCAL",
+    "STORE_GLOBAL",
+    "APPEND_LOCAL",
+    "APPEND_GLOBAL",
     "CALL_FUNCTION",
     "CALL_FUNCTION_EXTERNAL",
     "RETURN",
+    "YIELD",
+    "BREAKPOINT",
     "JUMP",
     "JUMP_IF_FALSE",
     "NOT_BOOL",
@@ -25,6 +50,7 @@ static std::string_view s_op_type_names[] = {
     "NEGATE_FLOAT",
     "ADD_INT",
     "ADD_FLOAT",
+    "ADD_STRING",
     "SUBTRACT_INT",
     "SUBTRACT_FLOAT",
     "MULTIPLY_INT",
@@ -46,7 +72,30 @@ static std::string_view s_op_type_names[] = {
     "LESS_THAN_EQUALS_INT",
     "LESS_THAN_EQUALS_FLOAT",
     "GREATER_THAN_EQUALS_INT",
-    "GREATER_THAN_EQUALS_FLOAT"
+    "GREATER_THAN_EQUALS_FLOAT",
+    "MAKE_VECTOR",
+    "VECTOR_SWIZZLE",
+    "VECTOR_INSERT",
+    "NEGATE_INT_VECTOR",
+    "NEGATE_FLOAT_VECTOR",
+    "ADD_INT_VECTOR",
+    "ADD_FLOAT_VECTOR",
+    "SUBTRACT_INT_VECTOR",
+    "SUBTRACT_FLOAT_VECTOR",
+    "MULTIPLY_INT_VECTOR",
+    "MULTIPLY_FLOAT_VECTOR",
+    "DIVIDE_INT_VECTOR",
+    "DIVIDE_FLOAT_VECTOR",
+    "MULTIPLY_INT_VECTOR_SCALAR",
+    "MULTIPLY_FLOAT_VECTOR_SCALAR",
+    "DIVIDE_FLOAT_VECTOR_SCALAR",
+    "EQUALS_INT_VECTOR",
+    "EQUALS_FLOAT_VECTOR",
+    "NOT_EQUALS_INT_VECTOR",
+    "NOT_EQUALS_FLOAT_VECTOR",
+    "DOT_INT_VECTOR",
+    "DOT_FLOAT_VECTOR",
+    "LENGTH_FLOAT_VECTOR"
 };
 
 std::string_view s_compiler_error_type_names[] = {
@@ -57,10 +106,19 @@ std::string_view s_compiler_error_type_names[] = {
     "FUNCTION_CALLED_WITH_WRONG_NUMBER_OF_ARGS",
     "IDENTIFIED_NOT_DECLARED",
     "IDENTIFIED_ALREADY_DECLARED",
-    "MATH_OPERATION_ON_STRING"
+    "MATH_OPERATION_ON_STRING",
+    "TOO_MANY_TYPES"
 };
 
 std::string_view type_to_string(Type type) {
+    if (is_object_type(type)) {
+        return s_type_names[static_cast<int>(Type::OBJECT)];
+    }
+
+    if (is_array_type(type)) {
+        return "ARRAY";
+    }
+
     return s_type_names[static_cast<int>(type)];
 }
 
@@ -68,6 +126,20 @@ std::string_view op_type_to_string(OpType type) {
     return s_op_type_names[static_cast<int>(type)];
 }
 
+size_t op_type_count() {
+    return sizeof(s_op_type_names) / sizeof(s_op_type_names[0]);
+}
+
+std::optional<OpType> op_type_from_string(std::string_view name) {
+    for (size_t i = 0; i < op_type_count(); i++) {
+        if (s_op_type_names[i] == name) {
+            return static_cast<OpType>(i);
+        }
+    }
+
+    return std::nullopt;
+}
+
 std::string_view compilation_error_type_to_string(CompilationErrorType type) {
     return s_compiler_error_type_names[static_cast<int>(type)];
 }
@@ -93,6 +165,26 @@ Type type_from_string(std::string_view name) {
         return Type::FLOAT;
     }
 
+    if (name == "int2") {
+        return Type::INT2;
+    }
+
+    if (name == "int4") {
+        return Type::INT4;
+    }
+
+    if (name == "float2") {
+        return Type::FLOAT2;
+    }
+
+    if (name == "float3") {
+        return Type::FLOAT3;
+    }
+
+    if (name == "float4") {
+        return Type::FLOAT4;
+    }
+
     throw 0;
 }
 
@@ -2,12 +2,18 @@
 
 #include "byte_code_enum.h"
 
+#include <cstddef>
+#include <optional>
 #include <string_view>
 
 std::string_view type_to_string(Type type);
 
 std::string_view op_type_to_string(OpType type);
 
+size_t op_type_count();
+
+std::optional<OpType> op_type_from_string(std::string_view name);
+
 std::string_view compilation_error_type_to_string(CompilationErrorType type);
 
 Type type_from_string(std::string_view name);
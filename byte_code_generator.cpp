@@ -1,5 +1,7 @@
 #include "byte_code_generator.h"
 
+#include <algorithm>
+
 // Operations
 
 ByteCodeGenerator::ByteCodeGenerator() {
@@ -12,16 +14,26 @@ ByteCodeGenerator::~ByteCodeGenerator() {
 
 void ByteCodeGenerator::emit(ByteCodeOp&& operation) {
     m_operations.emplace_back(std::move(operation));
+    m_source_lines.push_back(m_source_line);
 }
 
 void ByteCodeGenerator::emit_placeholder() {
     m_operations.emplace_back(ByteCodeOp { OpType::PLACEHOLDER, {} });
+    m_source_lines.push_back(m_source_line);
 }
 
 void ByteCodeGenerator::patch(size_t code_index, ByteCodeOp&& replacement_operation) {
     m_operations.at(code_index) = std::move(replacement_operation);
 }
 
+void ByteCodeGenerator::set_source_line(size_t line) {
+    m_source_line = line;
+}
+
+size_t ByteCodeGenerator::get_source_line() const {
+    return m_source_line;
+}
+
 size_t ByteCodeGenerator::get_code_index() const {
     return m_operations.size();
 }
@@ -95,6 +107,16 @@ ScopeType ByteCodeGenerator::scope_get_current_type() const {
 }
 
 CompilationErrorType ByteCodeGenerator::variable_declare(Type type, const std::string& identifier) {
+    // Variables in sibling blocks with the same name share their slots, which only
+    // works when they take the same number of them. Slots carry their value's type.
+    if (scope_get_current_type() != ScopeType::GLOBAL) {
+        for (const Variable& var : m_functions.back().local_variables) {
+            if (var.name == identifier && type_get_slot_count(var.type) != type_get_slot_count(type)) {
+                return CompilationErrorType::IDENTIFIED_ALREADY_DECLARED;
+            }
+        }
+    }
+
     CompilationErrorType err = scope_declare_identifier(IdentifierType::VARIABLE, identifier, false);
 
     if (err != CompilationErrorType::NONE) {
@@ -120,6 +142,16 @@ CompilationErrorType ByteCodeGenerator::variable_declare(Type type, const std::s
     return CompilationErrorType::NONE;
 }
 
+bool ByteCodeGenerator::variable_is_global(const std::string& identifier) const {
+    for (const Variable& var : m_global_variables) {
+        if (var.name == identifier) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 std::optional<Type> ByteCodeGenerator::variable_get_type(const std::string& identifier) const {
     if (!scope_is_identifier_declared(identifier)) {
         return std::nullopt;
@@ -229,6 +261,95 @@ std::optional<Type> ByteCodeGenerator::function_get_current_return_type() const
     return m_functions.back().return_type;
 }
 
+CompilationErrorType ByteCodeGenerator::type_declare(const std::string& name, const std::vector<Variable>& fields) {
+    if (type_get(name).has_value()) {
+        return CompilationErrorType::IDENTIFIED_ALREADY_DECLARED;
+    }
+
+    if (m_object_types.size() >= MAX_OBJECT_TYPE_COUNT) {
+        return CompilationErrorType::TOO_MANY_TYPES;
+    }
+
+    ObjectType object{};
+    object.name = name;
+    object.fields = fields;
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        const Variable& field = fields.at(i);
+
+        for (size_t j = 0; j < i; j++) {
+            if (fields.at(j).name == field.name) {
+                return CompilationErrorType::IDENTIFIED_ALREADY_DECLARED;
+            }
+        }
+
+        if (field.type == Type::VOID) {
+            return CompilationErrorType::TYPE_MISMATCH;
+        }
+
+        object.field_offsets.push_back(object.slot_types.size());
+
+        // Nested structs are laid out inline
+        if (is_object_type(field.type)) {
+            const ObjectType& field_object = type_get_object(field.type);
+
+            for (size_t j = 0; j < field_object.slot_types.size(); j++) {
+                object.slot_types.push_back(field_object.slot_types.at(j));
+                object.slot_names.push_back(field.name + "." + field_object.slot_names.at(j));
+            }
+        }
+
+        else {
+            object.slot_types.push_back(field.type);
+            object.slot_names.push_back(field.name);
+        }
+    }
+
+    m_object_types.push_back(object);
+
+    return CompilationErrorType::NONE;
+}
+
+std::optional<Type> ByteCodeGenerator::type_get(const std::string& name) const {
+    for (size_t i = 0; i < m_object_types.size(); i++) {
+        if (m_object_types.at(i).name == name) {
+            return object_type(i);
+        }
+    }
+
+    return std::nullopt;
+}
+
+const ObjectType& ByteCodeGenerator::type_get_object(Type type) const {
+    return m_object_types.at(object_type_index(type));
+}
+
+bool ByteCodeGenerator::type_is_array_element(Type type) const {
+    if (type == Type::INT || type == Type::FLOAT) {
+        return true;
+    }
+
+    if (!is_object_type(type)) {
+        return false;
+    }
+
+    const std::vector<Type>& slot_types = type_get_object(type).slot_types;
+
+    return std::all_of(slot_types.begin(), slot_types.end(), 
+        [](Type slot_type) {
+            return slot_type == Type::INT || slot_type == Type::FLOAT;
+        }
+    );
+}
+
+size_t ByteCodeGenerator::type_get_slot_count(Type type) const {
+    if (is_object_type(type)) {
+        return type_get_object(type).slot_types.size();
+    }
+
+    return type == Type::VOID ? 0 : 1;
+}
+
 // Errors
 
 void ByteCodeGenerator::set_error(CompilationError&& error) {
@@ -246,6 +367,9 @@ Program ByteCodeGenerator::get_program() const {
     program.operations = m_operations;
     program.functions = m_functions;
     program.external_functions = m_external_functions;
+    program.object_types = m_object_types;
+    program.global_variables = m_global_variables;
+    program.source_lines = m_source_lines;
 
     std::optional<FunctionInfo> main_function = function_get_info("main");
 
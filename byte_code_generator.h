@@ -53,6 +53,11 @@ public:
 
     OpType get_last_op_type() const;
 
+    // Operations emitted from here on are marked as coming from this line
+    void set_source_line(size_t line);
+
+    size_t get_source_line() const;
+
     // Scopes, variables, and functions
 
     void scope_push(ScopeType type);
@@ -72,6 +77,8 @@ public:
     CompilationErrorType variable_declare(Type type, const std::string& identifier);
 
     std::optional<Type> variable_get_type(const std::string& identifier) const;
+
+    bool variable_is_global(const std::string& identifier) const;
     
     CompilationErrorType function_declare(Type return_type, const std::string& identifier, size_t argument_count);
 
@@ -81,6 +88,17 @@ public:
     
     std::optional<Type> function_get_current_return_type() const;
 
+    CompilationErrorType type_declare(const std::string& name, const std::vector<Variable>& fields);
+
+    std::optional<Type> type_get(const std::string& name) const;
+
+    const ObjectType& type_get_object(Type type) const;
+
+    // Arrays hold ints, floats, and structs made only of those
+    bool type_is_array_element(Type type) const;
+
+    size_t type_get_slot_count(Type type) const;
+
     // Error state
 
     void set_error(CompilationError&& error);
@@ -93,10 +111,13 @@ public:
 
 private:
     std::vector<ByteCodeOp> m_operations;
+    std::vector<size_t> m_source_lines;
+    size_t m_source_line = 0;
     std::vector<Scope> m_scopes;
     std::vector<Variable> m_global_variables;
     std::vector<Function> m_functions;
     std::vector<ExternalFunction> m_external_functions;
+    std::vector<ObjectType> m_object_types;
 
     CompilationError m_error;
 };
\ No newline at end of file
@@ -17,11 +17,38 @@ void print_byte_code(const ByteCodeOp& op) {
             printf("%s %s", type_to_string(operand.type).data(), operand.identifier.c_str());
             break;
         }
-        case OpType::STORE_VARIABLE: {
+        case OpType::STORE_VARIABLE:
+        case OpType::APPEND_VARIABLE: {
             const auto& operand = std::get<ByteCodeStoreVariableOp>(op.operand);
             printf("%s %s", type_to_string(operand.type).data(), operand.identifier.c_str());
             break;
         }
+        case OpType::PUSH_FIELD:
+        case OpType::STORE_FIELD: {
+            const auto& operand = std::get<ByteCodeFieldOp>(op.operand);
+            printf("%s %s +%zu", type_to_string(operand.type).data(), operand.identifier.c_str(), operand.offset);
+            break;
+        }
+        case OpType::PUSH_INDEX:
+        case OpType::STORE_INDEX:
+        case OpType::PUSH_INDEX_UNCHECKED:
+        case OpType::STORE_INDEX_UNCHECKED: {
+            const auto& operand = std::get<ByteCodeIndexOp>(op.operand);
+            printf("%s", type_to_string(operand.element_type).data());
+            break;
+        }
+        case OpType::MAKE_VECTOR:
+        case OpType::VECTOR_SWIZZLE:
+        case OpType::VECTOR_INSERT: {
+            const auto& operand = std::get<ByteCodeVectorOp>(op.operand);
+            printf("%s ", type_to_string(operand.type).data());
+
+            for (size_t i = 0; i < operand.lane_count; i++) {
+                printf("%c", "xyzw"[operand.lanes[i]]);
+            }
+
+            break;
+        }
         case OpType::CALL_FUNCTION: {
             const auto& operand = std::get<ByteCodeCallFunctionOp>(op.operand);
             printf("%zd", operand.code_index);
@@ -46,12 +73,17 @@ void print_byte_code(const ByteCodeOp& op) {
 }
 
 void print_type_variant(Type type, const TypeVariant& value) {
+    if (is_array_type(type)) {
+        print_array(std::get<ArrayView>(value));
+        return;
+    }
+
     switch (type) {
         case Type::VOID:
             print_void();
             break;
         case Type::STRING:
-            print_string(std::get<std::string>(value));
+            print_string(std::get<VmString>(value));
             break;
         case Type::BOOL:
             print_bool(std::get<bool>(value));
@@ -62,6 +94,15 @@ void print_type_variant(Type type, const TypeVariant& value) {
         case Type::FLOAT:
             print_float(std::get<float>(value));
             break;
+        case Type::INT2:
+        case Type::INT4:
+            print_int_vector(std::get<IntVector>(value));
+            break;
+        case Type::FLOAT2:
+        case Type::FLOAT3:
+        case Type::FLOAT4:
+            print_float_vector(std::get<FloatVector>(value));
+            break;
     }
 }
 
@@ -83,4 +124,28 @@ void print_int(int value) {
 
 void print_float(float value) {
     printf("%f", value);
+}
+
+void print_array(const ArrayView& value) {
+    printf("%s[%d]", type_to_string(value.element_type).data(), value.length);
+}
+
+void print_int_vector(const IntVector& value) {
+    printf("(");
+
+    for (size_t i = 0; i < vector_width(value.type); i++) {
+        printf(i == 0 ? "%d" : ", %d", value.lanes[i]);
+    }
+
+    printf(")");
+}
+
+void print_float_vector(const FloatVector& value) {
+    printf("(");
+
+    for (size_t i = 0; i < vector_width(value.type); i++) {
+        printf(i == 0 ? "%f" : ", %f", value.lanes[i]);
+    }
+
+    printf(")");
 }
\ No newline at end of file
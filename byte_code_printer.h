@@ -10,4 +10,7 @@ void print_void();
 void print_string(std::string_view value);
 void print_bool(bool value);
 void print_int(int value);
-void print_float(float value);
\ No newline at end of file
+void print_float(float value);
+void print_array(const ArrayView& value);
+void print_int_vector(const IntVector& value);
+void print_float_vector(const FloatVector& value);
\ No newline at end of file
@@ -1,11 +1,138 @@
 #pragma once
 
 #include "byte_code_enum.h"
+#include "vm_string.h"
 
 #include <variant>
 #include <string>
+#include <algorithm>
+#include <array>
 
-using TypeVariant = std::variant<std::string, bool, int, float>;
+// Arrays don't own their elements, they view contiguous memory owned by the host. Each
+// element is its type's slots packed back to back at 4 bytes a slot, so an int[] is an
+// int*, and a Vec2[] of struct Vec2 { float x; float y; } matches the same C struct.
+struct ArrayView {
+    Type element_type;
+    void* data;
+    int length;
+
+    bool operator==(const ArrayView& other) const {
+        return element_type == other.element_type && data == other.data && length == other.length;
+    }
+};
+
+inline ArrayView make_array_view(int* data, int length) {
+    return { Type::INT, data, length };
+}
+
+inline ArrayView make_array_view(float* data, int length) {
+    return { Type::FLOAT, data, length };
+}
+
+// Every vector width is stored in four lanes so one operation handles them all, the
+// lanes past the type's width are kept at zero
+struct IntVector {
+    Type type;
+    int lanes[4];
+
+    bool operator==(const IntVector& other) const {
+        return type == other.type && std::equal(lanes, lanes + 4, other.lanes);
+    }
+};
+
+struct FloatVector {
+    Type type;
+    float lanes[4];
+
+    bool operator==(const FloatVector& other) const {
+        return type == other.type && std::equal(lanes, lanes + 4, other.lanes);
+    }
+};
+
+using TypeVariant = std::variant<VmString, bool, int, float, ArrayView, IntVector, FloatVector>;
+
+inline bool is_int_vector_type(Type type) {
+    return type == Type::INT2 || type == Type::INT4;
+}
+
+inline bool is_float_vector_type(Type type) {
+    return type == Type::FLOAT2 || type == Type::FLOAT3 || type == Type::FLOAT4;
+}
+
+inline bool is_vector_type(Type type) {
+    return is_int_vector_type(type) || is_float_vector_type(type);
+}
+
+inline size_t vector_width(Type type) {
+    switch (type) {
+        case Type::INT2:   return 2;
+        case Type::INT4:   return 4;
+        case Type::FLOAT2: return 2;
+        case Type::FLOAT3: return 3;
+        case Type::FLOAT4: return 4;
+        default:           return 0;
+    }
+}
+
+inline Type vector_lane_type(Type type) {
+    return is_int_vector_type(type) ? Type::INT : Type::FLOAT;
+}
+
+// The vector with the given lanes, VOID if there isn't one like an int3
+inline Type vector_type(Type lane_type, size_t width) {
+    if (lane_type == Type::INT) {
+        switch (width) {
+            case 2:  return Type::INT2;
+            case 4:  return Type::INT4;
+            default: return Type::VOID;
+        }
+    }
+
+    if (lane_type == Type::FLOAT) {
+        switch (width) {
+            case 2:  return Type::FLOAT2;
+            case 3:  return Type::FLOAT3;
+            case 4:  return Type::FLOAT4;
+            default: return Type::VOID;
+        }
+    }
+
+    return Type::VOID;
+}
+
+// Struct types are numbered up from Type::OBJECT, the index is into Program::object_types.
+// Array types set the top bit over their element type, so there are no arrays of arrays.
+
+constexpr unsigned char ARRAY_TYPE_BIT = 0x80;
+
+constexpr size_t MAX_OBJECT_TYPE_COUNT = ARRAY_TYPE_BIT - static_cast<size_t>(Type::OBJECT);
+
+constexpr size_t ARRAY_SLOT_SIZE = 4;
+
+inline bool is_object_type(Type type) {
+    unsigned char value = static_cast<unsigned char>(type);
+    return value >= static_cast<unsigned char>(Type::OBJECT) && value < ARRAY_TYPE_BIT;
+}
+
+inline bool is_array_type(Type type) {
+    return (static_cast<unsigned char>(type) & ARRAY_TYPE_BIT) != 0;
+}
+
+inline Type array_type(Type element_type) {
+    return static_cast<Type>(static_cast<unsigned char>(element_type) | ARRAY_TYPE_BIT);
+}
+
+inline Type array_element_type(Type type) {
+    return static_cast<Type>(static_cast<unsigned char>(type) & ~ARRAY_TYPE_BIT);
+}
+
+inline size_t object_type_index(Type type) {
+    return static_cast<unsigned char>(type) - static_cast<unsigned char>(Type::OBJECT);
+}
+
+inline Type object_type(size_t index) {
+    return static_cast<Type>(static_cast<unsigned char>(Type::OBJECT) + index);
+}
 
 struct ByteCodePushLiteralOp {
     Type type;
@@ -34,6 +161,38 @@ struct ByteCodeStoreVariableOp {
     }
 };
 
+// A struct field, or one of its slots if the field is itself a struct
+struct ByteCodeFieldOp {
+    Type type;
+    std::string identifier;
+    size_t offset;
+
+    bool operator==(const ByteCodeFieldOp& other) const {
+        return type == other.type && identifier == other.identifier && offset == other.offset;
+    }
+};
+
+// Reading or writing one array element, every slot of it for struct elements
+struct ByteCodeIndexOp {
+    Type element_type;
+
+    bool operator==(const ByteCodeIndexOp& other) const {
+        return element_type == other.element_type;
+    }
+};
+
+// Building a vector, or moving lanes in and out of one. Lanes are listed in the order
+// they are read or written, for MAKE_VECTOR only the type is used.
+struct ByteCodeVectorOp {
+    Type type;
+    std::array<unsigned char, 4> lanes;
+    size_t lane_count;
+
+    bool operator==(const ByteCodeVectorOp& other) const {
+        return type == other.type && lanes == other.lanes && lane_count == other.lane_count;
+    }
+};
+
 struct ByteCodeCallFunctionOp {
     size_t code_index;
 
@@ -57,6 +216,9 @@ struct ByteCodeOp {
         ByteCodePushLiteralOp, 
         ByteCodePushVariableOp, 
         ByteCodeStoreVariableOp,
+        ByteCodeFieldOp,
+        ByteCodeIndexOp,
+        ByteCodeVectorOp,
         ByteCodeCallFunctionOp,
         ByteCodeJumpOp
     > operand;
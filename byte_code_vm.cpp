@@ -1,430 +1,199 @@
 #include "byte_code_vm.h"
 
-#include "byte_code_enum_translation.h"
-#include "byte_code_printer.h"
+#include "execution_trace.h"
 
-#include <unordered_map>
+// A fiber that yielded inside a call is still running the function it was started
+// with, which is what its resumed slices are counted under
+static size_t get_outermost_function_index(const Fiber& fiber) {
+    return fiber.call_stack.empty() ? fiber.function_index : fiber.call_stack.front().function_index;
+}
+
+ByteCodeVm::ByteCodeVm(const Program& program, std::pmr::memory_resource* upstream)
+    : m_owned_engine (std::make_unique<Engine>(program))
+    , m_engine       (m_owned_engine.get())
+    , m_memory       (upstream)
+    , m_fiber        (&m_memory)
+{
+    m_engine->reset(m_fiber);
+}
 
-ByteCodeVm::ByteCodeVm(const Program& program)
-    : m_program (program)
+ByteCodeVm::ByteCodeVm(const Engine& engine, std::pmr::memory_resource* upstream)
+    : m_engine (&engine)
+    , m_memory (upstream)
+    , m_fiber  (&m_memory)
 {
-    m_program_counter = program.main_code_index;
-    m_next_program_counter = m_program_counter;
+    m_engine->reset(m_fiber);
 }
 
 void ByteCodeVm::set_main_args(const std::vector<std::pair<Type, TypeVariant>>& args) {
-    for (auto arg : args) {
-        push_variant(arg.first, arg.second);
+    for (const auto& [type, arg] : args) {
+        push_variant(arg);
     }
 }
 
-void ByteCodeVm::execute() {
-    while (get_is_not_halted()) {
-        execute_op();
-    }
+void ByteCodeVm::reset() {
+    m_engine->reset(m_fiber);
 }
-void ByteCodeVm::execute_op() {
-    m_next_program_counter = m_program_counter + 1;
-    execute_op_switch();
-    m_program_counter = m_next_program_counter;
+
+ExecutionStatus ByteCodeVm::execute() {
+    HardwareCountScope scope(m_hardware_counting ? m_hardware_counters.get() : nullptr, get_outermost_function_index(m_fiber));
+    return m_engine->execute(m_fiber);
+}
+
+ExecutionStatus ByteCodeVm::resume() {
+    HardwareCountScope scope(m_hardware_counting ? m_hardware_counters.get() : nullptr, get_outermost_function_index(m_fiber));
+    return m_engine->resume(m_fiber);
+}
+
+ExecutionStatus ByteCodeVm::execute_for(size_t instruction_count) {
+    return m_engine->execute_for(m_fiber, instruction_count);
+}
+
+ExecutionStatus ByteCodeVm::execute_until(std::chrono::steady_clock::time_point deadline) {
+    return m_engine->execute_until(m_fiber, deadline);
+}
+
+ExecutionStatus ByteCodeVm::execute_op() {
+    return m_engine->execute_op(m_fiber);
 }
 
 void ByteCodeVm::halt() {
-    m_program_counter = m_program.operations.size();
-    m_next_program_counter = m_program.operations.size();
+    m_engine->halt(m_fiber);
 }
 
-void ByteCodeVm::call_function(const std::string& identifier, const const std::vector<std::pair<Type, TypeVariant>>& args) {
-    auto index = m_program.find_function(identifier);
+ExecutionStatus ByteCodeVm::call_function(const std::string& identifier, const std::vector<std::pair<Type, TypeVariant>>& args) {
+    auto function = m_engine->resolve_function(identifier);
     
-    if (!index.has_value()) {
+    if (!function.has_value()) {
+        if (m_fiber.trace_buffer) {
+            m_fiber.trace_buffer->write(TraceEventType::RUNTIME_ERROR, 0);
+        }
+
         halt();
+        return ExecutionStatus::COMPLETED;
     }
 
     for (const auto& [type, arg] : args) {
-        push_variant(type, arg);
+        push_variant(arg);
     }
 
-    switch (index.value().type) {
-        case FunctionType::SCRIPT: {
-            const Function& function = m_program.functions.at(index.value().function_index);
-            execute_op_call_function(function.code_index);
-            break;
-        }
-        case FunctionType::EXTERNAL: {
-            execute_op_call_external_function(index.value().function_index);
-            break;
-        }
-        default: {
-            halt();
-            break;
-        }
-    }
+    HardwareCountScope scope(get_hardware_count_profile(function.value()), function.value().function_index);
+    return m_engine->invoke_function(m_fiber, function.value());
 }
 
-void ByteCodeVm::print() const {
-    printf("\033[2J\033[H");
-    m_program.print(m_program_counter);
-
-    printf("\nCall Stack:\n");
-    for (size_t i = 0; i < m_call_stack.size(); ++i) {
-        printf("  [%zu] -> %zu\n", i, m_call_stack[i]);
+ExecutionStatus ByteCodeVm::call_function_span(const FunctionHandle& function, const TypeVariant* args, size_t arg_count) {
+    for (size_t i = 0; i < arg_count; i++) {
+        push_variant(args[i]);
     }
 
-    printf("\nStack:\n");
-    m_stack.print();
+    HardwareCountScope scope(get_hardware_count_profile(function), function.function_index);
+    return m_engine->invoke_function(m_fiber, function);
+}
 
-    printf("\nVariables:\n");
-    for (const auto& [name, pair] : m_variables) {
-        const Type& type = pair.first;
-        const TypeVariant& value = pair.second;
+ByteStack& ByteCodeVm::get_stack() {
+    return m_fiber.stack;
+}
 
-        printf("  %s : ", name.c_str());
-        print_type_variant(type, value);
-        printf("\n");
-    }
+void ByteCodeVm::print() const {
+    m_engine->print(m_fiber);
 }
 
 bool ByteCodeVm::get_is_not_halted() const {
-    return m_program_counter < m_program.operations.size();
+    return m_engine->get_is_not_halted(m_fiber);
 }
 
 size_t ByteCodeVm::get_program_counter() const {
-    return m_program_counter;
+    return m_fiber.program_counter;
 }
 
 const ByteCodeVmState ByteCodeVm::get_state() const {
-    return { 
-        m_stack,
-        m_variables,
-        m_call_stack,
-        m_program_counter
-    };
-}
-
-void ByteCodeVm::execute_op_switch() {
-    const ByteCodeOp& op = m_program.operations.at(m_program_counter);
-
-    switch (op.type) {
-        case OpType::PUSH_LITERAL: {
-            const ByteCodePushLiteralOp& operand = std::get<ByteCodePushLiteralOp>(op.operand);
-            push_variant(operand.type, operand.value);
-            break;
-        }
-
-        case OpType::STORE_VARIABLE: {
-            const ByteCodeStoreVariableOp& operand = std::get<ByteCodeStoreVariableOp>(op.operand);
-            m_variables[operand.identifier] = pop_variant();
-            break;
-        }
-
-        case OpType::PUSH_VARIABLE: {
-            const ByteCodePushVariableOp& operand = std::get<ByteCodePushVariableOp>(op.operand);
-            auto [type, value] = m_variables.at(operand.identifier);
-            push_variant(type, value);
-            break;
-        }
-
-        case OpType::POP: {
-            m_stack.pop();
-            break;
-        }
-
-        case OpType::CALL_FUNCTION: {
-            const ByteCodeCallFunctionOp& operand = std::get<ByteCodeCallFunctionOp>(op.operand);
-            execute_op_call_function(operand.code_index);
-            break;
-        }
+    return m_engine->get_state(m_fiber);
+}
 
-        case OpType::CALL_FUNCTION_EXTERNAL: {
-            const ByteCodeCallFunctionOp& operand = std::get<ByteCodeCallFunctionOp>(op.operand);
-            execute_op_call_external_function(operand.code_index);
-            break;
-        }
+void ByteCodeVm::checkpoint(FiberCheckpoint& checkpoint) {
+    m_fiber.checkpoint(checkpoint);
+}
 
-        case OpType::RETURN: {
-            if (m_call_stack.size() == 0) {
-                m_next_program_counter = m_program.operations.size();
-                break;
-            }
+void ByteCodeVm::restore(const FiberCheckpoint& checkpoint) {
+    m_fiber.restore(checkpoint);
+}
 
-            size_t code_index = m_call_stack.back();
-            m_call_stack.pop_back();
-            m_next_program_counter = code_index + 1;
-            break;
-        }
+std::unique_ptr<ByteCodeVm> ByteCodeVm::fork(std::pmr::memory_resource* upstream) {
+    FiberCheckpoint checkpoint;
+    m_fiber.checkpoint(checkpoint);
 
-        case OpType::JUMP: {
-            const ByteCodeJumpOp& operand = std::get<ByteCodeJumpOp>(op.operand);
-            m_next_program_counter = operand.code_index;
-            break;
-        }
+    std::unique_ptr<ByteCodeVm> vm = std::make_unique<ByteCodeVm>(*m_engine, upstream);
+    vm->restore(checkpoint);
 
-        case OpType::JUMP_IF_FALSE: {
-            bool value = m_stack.top_as_bool();
-            m_stack.pop();
-            
-            if (!value) {
-                const ByteCodeJumpOp& operand = std::get<ByteCodeJumpOp>(op.operand);
-                m_next_program_counter = operand.code_index;
-            }
+    return vm;
+}
 
-            break;
-        }
+const Engine& ByteCodeVm::get_engine() const {
+    return *m_engine;
+}
 
-        // Unary
+Fiber& ByteCodeVm::get_fiber() {
+    return m_fiber;
+}
 
-        case OpType::NOT_BOOL: {
-            bool result = !m_stack.top_as_bool();
-            m_stack.pop();
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::NEGATE_INT: {
-            int result = -m_stack.top_as_int();
-            m_stack.pop();
-            m_stack.push_int(result);
-            break;
-        }
-        case OpType::NEGATE_FLOAT: {
-            float result = -m_stack.top_as_float();
-            m_stack.pop();
-            m_stack.push_float(result);
-            break;
-        }
+VmMemoryStats ByteCodeVm::get_memory_stats() const {
+    return m_memory.get_stats();
+}
 
-        // Binary
+VmMemory& ByteCodeVm::get_memory() {
+    return m_memory;
+}
 
-        case OpType::ADD_INT: {
-            int result = m_stack.top_as_int(1) + m_stack.top_as_int(0);
-            m_stack.pop(2);
-            m_stack.push_int(result);
-            break;
-        }
-        case OpType::ADD_FLOAT: {
-            float result = m_stack.top_as_float(1) + m_stack.top_as_float(0);
-            m_stack.pop(2);
-            m_stack.push_float(result);
-            break;
-        }
-        case OpType::SUBTRACT_INT: {
-            int result = m_stack.top_as_int(1) - m_stack.top_as_int(0);
-            m_stack.pop(2);
-            m_stack.push_int(result);
-            break;
-        }
-        case OpType::SUBTRACT_FLOAT: {
-            float result = m_stack.top_as_float(1) - m_stack.top_as_float(0);
-            m_stack.pop(2);
-            m_stack.push_float(result);
-            break;
-        }
-        case OpType::MULTIPLY_INT: {
-            int result = m_stack.top_as_int(1) * m_stack.top_as_int(0);
-            m_stack.pop(2);
-            m_stack.push_int(result);
-            break;
-        }
-        case OpType::MULTIPLY_FLOAT: {
-            float result = m_stack.top_as_float(1) * m_stack.top_as_float(0);
-            m_stack.pop(2);
-            m_stack.push_float(result);
-            break;
-        }
-        case OpType::DIVIDE_INT: {
-            int result = m_stack.top_as_int(1) / m_stack.top_as_int(0);
-            m_stack.pop(2);
-            m_stack.push_int(result);
-            break;
-        }
-        case OpType::DIVIDE_FLOAT: {
-            float result = m_stack.top_as_float(1) / m_stack.top_as_float(0);
-            m_stack.pop(2);
-            m_stack.push_float(result);
-            break;
-        }
+void ByteCodeVm::set_profiling(bool enabled) {
+    if (enabled && !m_profiler) {
+        m_profiler = std::make_unique<Profiler>(*m_engine);
+    }
 
-        // Comparisons
+    if (enabled) {
+        m_fiber.op_hook = m_profiler.get();
+    }
 
-        case OpType::EQUALS_STRING: {
-            bool result = m_stack.top_as_string(1) == m_stack.top_as_string(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::EQUALS_BOOL: {
-            bool result = m_stack.top_as_bool(1) == m_stack.top_as_bool(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::EQUALS_INT: {
-            bool result = m_stack.top_as_int(1) == m_stack.top_as_int(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::EQUALS_FLOAT: {
-            bool result = m_stack.top_as_float(1) == m_stack.top_as_float(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::NOT_EQUALS_STRING: {
-            bool result = m_stack.top_as_string(1) != m_stack.top_as_string(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::NOT_EQUALS_BOOL: {
-            bool result = m_stack.top_as_bool(1) != m_stack.top_as_bool(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::NOT_EQUALS_INT: {
-            bool result = m_stack.top_as_int(1) != m_stack.top_as_int(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::NOT_EQUALS_FLOAT: {
-            bool result = m_stack.top_as_float(1) != m_stack.top_as_float(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::LESS_THAN_INT: {
-            bool result = m_stack.top_as_int(1) < m_stack.top_as_int(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::LESS_THAN_FLOAT: {
-            bool result = m_stack.top_as_float(1) < m_stack.top_as_float(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::GREATER_THAN_INT: {
-            bool result = m_stack.top_as_int(1) > m_stack.top_as_int(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::GREATER_THAN_FLOAT: {
-            bool result = m_stack.top_as_float(1) > m_stack.top_as_float(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::LESS_THAN_EQUALS_INT: {
-            bool result = m_stack.top_as_int(1) <= m_stack.top_as_int(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::LESS_THAN_EQUALS_FLOAT: {
-            bool result = m_stack.top_as_float(1) <= m_stack.top_as_float(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::GREATER_THAN_EQUALS_INT: {
-            bool result = m_stack.top_as_int(1) >= m_stack.top_as_int(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        case OpType::GREATER_THAN_EQUALS_FLOAT: {
-            bool result = m_stack.top_as_float(1) >= m_stack.top_as_float(0);
-            m_stack.pop(2);
-            m_stack.push_bool(result);
-            break;
-        }
-        default: {
-            exit(1);
-        }
+    else if (m_profiler && m_fiber.op_hook == m_profiler.get()) {
+        m_fiber.op_hook = nullptr;
     }
 }
 
-void ByteCodeVm::execute_op_call_function(size_t code_index) {
-    m_call_stack.push_back(m_program_counter);
-    m_next_program_counter = code_index;
+Profiler* ByteCodeVm::get_profiler() {
+    return m_profiler.get();
 }
 
-void ByteCodeVm::execute_op_call_external_function(size_t function_index) {
-    const ExternalFunction& function = m_program.external_functions.at(function_index);
+void ByteCodeVm::set_op_hook(OpHook* hook) {
+    m_fiber.op_hook = hook;
+}
 
-    std::vector<TypeVariant> args;
-    for (size_t i = 0; i < function.arguments.size(); i++) {
-        auto [value_type, value] = pop_variant();
-        args.push_back(value);
-    }
+bool ByteCodeVm::set_hardware_counting(bool enabled) {
+    if (enabled && !m_hardware_counters) {
+        std::unique_ptr<HardwareCounterProfile> counters = std::make_unique<HardwareCounterProfile>(*m_engine);
 
-    if (function.return_type == Type::VOID) {
-        function.proc(args);
-    }
+        if (!counters->is_any_available()) {
+            return false;
+        }
 
-    else {
-        TypeVariant result =  function.proc(args);
-        push_variant(function.return_type, result);
+        m_hardware_counters = std::move(counters);
     }
-}
 
-void ByteCodeVm::push_variant(Type type, const TypeVariant& variant) {
-    switch (type) {
-        case Type::STRING: {
-            m_stack.push_string(std::get<std::string>(variant));
-            break;
-        }
-        case Type::BOOL: {
-            m_stack.push_bool(std::get<bool>(variant));
-            break;
-        }
-        case Type::INT: {
-            m_stack.push_int(std::get<int>(variant));
-            break;
-        }
-        case Type::FLOAT: {
-            m_stack.push_float(std::get<float>(variant));
-            break;
-        }
-        default: {
-            exit(1);
-            break;
-        }
-    }
+    m_hardware_counting = enabled;
+    return true;
 }
 
-std::pair<Type, TypeVariant> ByteCodeVm::pop_variant() {
-    Type type = m_stack.top_value_type();
-    TypeVariant value = {};
+HardwareCounterProfile* ByteCodeVm::get_hardware_counters() {
+    return m_hardware_counters.get();
+}
 
-    switch (type) {
-        case Type::STRING: {
-            value = std::string(m_stack.top_as_string());
-            break;
-        }
-        case Type::BOOL: {
-            value = m_stack.top_as_bool();
-            break;
-        }
-        case Type::INT: {
-            value = m_stack.top_as_int();
-            break;
-        }
-        case Type::FLOAT: {
-            value = m_stack.top_as_float();
-            break;
-        }
-        default: {
-            exit(1);
-            break;
-        }
+HardwareCounterProfile* ByteCodeVm::get_hardware_count_profile(const FunctionHandle& function) {
+    // External functions have no script function to count under
+    if (!m_hardware_counting || function.type != FunctionType::SCRIPT) {
+        return nullptr;
     }
 
-    m_stack.pop();
+    return m_hardware_counters.get();
+}
 
-    return { type, value };
-}
\ No newline at end of file
+void ByteCodeVm::push_variant(const TypeVariant& variant) {
+    std::visit([this](const auto& value) { m_fiber.stack.push(value); }, variant);
+}
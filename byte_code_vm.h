@@ -1,31 +1,61 @@
 #pragma once
 
-#include "byte_stack.h"
-#include "byte_code_types.h"
-#include "program.h"
+#include "engine.h"
+#include "vm_memory.h"
+#include "profiler.h"
+#include "hardware_counters.h"
 
-#include <unordered_map>
-
-struct ByteCodeVmState {
-    ByteStack stack;
-    std::unordered_map<std::string, std::pair<Type, TypeVariant>> variables;
-    std::vector<size_t> call_stack;
-    size_t program_counter;
-};
+#include <memory>
 
+// Runs a single fiber on an engine. Constructing from a program decodes a private
+// engine for it, share an Engine between vms to run a program many times at once.
+// The vm's memory is taken from upstream, pass a resource to keep it within a budget
+// or on the host's own allocator.
 class ByteCodeVm {
 public:
-    ByteCodeVm(const Program& program);
+    ByteCodeVm(const Program& program, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+    ByteCodeVm(const Engine& engine, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
 
     void set_main_args(const std::vector<std::pair<Type, TypeVariant>>& args);
 
-    void execute();
+    // Puts the vm back at the start of main, keeping the memory it has already allocated
+    void reset();
+
+    template<typename... Args>
+    ExecutionStatus rerun(const Args&... args) {
+        reset();
+        (m_fiber.stack.push(args), ...);
+        return execute();
+    }
+
+    ExecutionStatus execute();
+
+    // Continues a vm that yielded
+    ExecutionStatus resume();
+
+    ExecutionStatus execute_for(size_t instruction_count);
+
+    ExecutionStatus execute_until(std::chrono::steady_clock::time_point deadline);
     
-    void execute_op();
+    ExecutionStatus execute_op();
 
     void halt();
 
-    void call_function(const std::string& identifier, const const std::vector<std::pair<Type, TypeVariant>>& args);
+    ExecutionStatus call_function(const std::string& identifier, const std::vector<std::pair<Type, TypeVariant>>& args);
+
+    // Calls a resolved function and runs it until it returns. Any return value is left
+    // on the stack for the host to read through get_stack(). A yield or breakpoint
+    // inside the call stops it early with that status, see Engine::invoke_function().
+    ExecutionStatus call_function_span(const FunctionHandle& function, const TypeVariant* args, size_t arg_count);
+
+    template<typename... Args>
+    ExecutionStatus call_function(const FunctionHandle& function, const Args&... args) {
+        HardwareCountScope scope(get_hardware_count_profile(function), function.function_index);
+        return m_engine->call_function(m_fiber, function, args...);
+    }
+
+    ByteStack& get_stack();
 
     void print() const;
 
@@ -35,23 +65,55 @@ public:
 
     const ByteCodeVmState get_state() const;
 
-private:
-    void execute_op_switch();
+    // Saves where the vm is without naming or detaching anything, for restore() or
+    // for forking other vms on the same engine. Restoring into vms that already exist
+    // is cheaper than forking new ones.
+    void checkpoint(FiberCheckpoint& checkpoint);
+
+    void restore(const FiberCheckpoint& checkpoint);
+
+    // A new vm on this one's engine in the state this one is in now. It shares the
+    // engine and strings with this vm, which has to outlive it.
+    std::unique_ptr<ByteCodeVm> fork(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+    const Engine& get_engine() const;
+
+    Fiber& get_fiber();
 
-    void execute_op_call_function(size_t code_index);
+    VmMemoryStats get_memory_stats() const;
 
-    void execute_op_call_external_function(size_t function_index);
+    // Profiles everything the vm runs from here on, adding to what was counted before.
+    // Disabling keeps the results until profiling is enabled again.
+    void set_profiling(bool enabled);
 
-    void push_variant(Type type, const TypeVariant& variant);
+    Profiler* get_profiler();
 
-    std::pair<Type, TypeVariant> pop_variant();
+    // Hooks other instrumentation into every operation the vm runs, in place of the
+    // profiler while it is set. Pass nullptr to unhook it.
+    void set_op_hook(OpHook* hook);
+
+    // Reads the cpu's counters around every execute(), resume() and call to a script
+    // function from here on, adding them up under the function that was run. A resume()
+    // counts under the function the fiber was started with, even when it yielded inside
+    // a call. Only the thread that enables it is counted. Returns false and stays off when none of the
+    // counters can be opened. Disabling keeps the results.
+    bool set_hardware_counting(bool enabled);
+
+    HardwareCounterProfile* get_hardware_counters();
+
+    VmMemory& get_memory();
 
 private:
-    ByteStack m_stack;
-    std::unordered_map<std::string, std::pair<Type, TypeVariant>> m_variables;
-    std::vector<size_t> m_call_stack;
-    size_t m_program_counter;
-    size_t m_next_program_counter;
+    void push_variant(const TypeVariant& variant);
 
-    const Program& m_program;
+    HardwareCounterProfile* get_hardware_count_profile(const FunctionHandle& function);
+
+private:
+    std::unique_ptr<Engine> m_owned_engine;
+    const Engine* m_engine;
+    VmMemory m_memory;
+    Fiber m_fiber;
+    std::unique_ptr<Profiler> m_profiler;
+    std::unique_ptr<HardwareCounterProfile> m_hardware_counters;
+    bool m_hardware_counting = false;
 };
@@ -1,7 +1,10 @@
 #include "byte_code_vm_debugger.h"
 
+#include "compiler.h"
+
 ByteCodeVmDebugger::ByteCodeVmDebugger(ByteCodeVm& vm) 
     : m_vm             (vm)
+    , m_engine         (vm.get_engine())
     , m_breakpoint_hit (false)
 {}
 
@@ -10,36 +13,341 @@ void ByteCodeVmDebugger::execute() {
 }
 
 void ByteCodeVmDebugger::breakpoint_add(size_t code_index) {
-    m_breakpoints.push_back({ code_index });
+    if (m_breakpoints.count(code_index) > 0) {
+        m_breakpoints.at(code_index).condition.reset();
+        return;
+    }
+
+    m_breakpoints[code_index] = { code_index, nullptr };
+    update_patch(code_index);
+}
+
+static const char* get_condition_type_name(Type type) {
+    switch (type) {
+        case Type::STRING: return "string";
+        case Type::BOOL: return "bool";
+        case Type::INT: return "int";
+        case Type::FLOAT: return "float";
+        default: return nullptr;
+    }
+}
+
+static TypeVariant get_default_value(Type type) {
+    switch (type) {
+        case Type::BOOL: return false;
+        case Type::INT: return 0;
+        case Type::FLOAT: return 0.0f;
+        default: return VmString();
+    }
+}
+
+bool ByteCodeVmDebugger::breakpoint_add(size_t code_index, std::string_view condition) {
+    const Program& program = m_engine.get_program();
+
+    // Functions are emitted one after another, so the one starting closest before
+    // the breakpoint holds it
+    const Function* owner = nullptr;
+
+    for (const Function& function : program.functions) {
+        if (function.code_index <= code_index && (!owner || function.code_index > owner->code_index)) {
+            owner = &function;
+        }
+    }
+
+    // Locals hide state variables with the same name
+    std::unique_ptr<BreakpointCondition> breakpoint_condition = std::make_unique<BreakpointCondition>();
+    std::vector<Variable>& arguments = breakpoint_condition->arguments;
+
+    auto add_argument = [&](const Variable& variable) {
+        if (!get_condition_type_name(variable.type)) {
+            return;
+        }
+
+        for (const Variable& argument : arguments) {
+            if (argument.name == variable.name) {
+                return;
+            }
+        }
+
+        arguments.push_back(variable);
+    };
+
+    if (owner) {
+        for (const Variable& variable : owner->local_variables) {
+            add_argument(variable);
+        }
+    }
+
+    for (const Variable& variable : program.global_variables) {
+        add_argument(variable);
+    }
+
+    std::string text = "bool breakpoint_condition(";
+
+    for (size_t i = 0; i < arguments.size(); i++) {
+        text += i > 0 ? ", " : "";
+        text += get_condition_type_name(arguments[i].type);
+        text += " ";
+        text += arguments[i].name;
+    }
+
+    text += ") {\n    return ";
+    text += condition;
+    text += ";\n}\n";
+
+    CompilationResults results = compile(text, program.external_functions, false, true);
+
+    if (results.error.type != CompilationErrorType::NONE) {
+        return false;
+    }
+
+    breakpoint_condition->program = std::move(results.program);
+    breakpoint_condition->function = breakpoint_condition->program.resolve_function("breakpoint_condition").value();
+    breakpoint_condition->vm = std::make_unique<ByteCodeVm>(breakpoint_condition->program);
+
+    breakpoint_add(code_index);
+    m_breakpoints.at(code_index).condition = std::move(breakpoint_condition);
+
+    return true;
 }
 
 void ByteCodeVmDebugger::breakpoint_remove(size_t code_index) {
-    m_breakpoints.erase(std::find_if(m_breakpoints.begin(), m_breakpoints.end(), 
-        [&](const Breakpoint& a) {
-            return a.code_index == code_index;
+    auto itr = m_breakpoints.find(code_index);
+
+    if (itr == m_breakpoints.end()) {
+        return;
+    }
+
+    m_breakpoints.erase(itr);
+    update_patch(code_index);
+}
+
+bool ByteCodeVmDebugger::watchpoint_add(const std::string& variable) {
+    return add_watchpoint(std::nullopt, variable);
+}
+
+static std::optional<size_t> find_function_index(const Program& program, const std::string& function) {
+    for (size_t i = 0; i < program.functions.size(); i++) {
+        if (program.functions[i].name == function) {
+            return i;
         }
-    ));
+    }
+
+    return std::nullopt;
+}
+
+bool ByteCodeVmDebugger::watchpoint_add(const std::string& function, const std::string& variable) {
+    std::optional<size_t> function_index = find_function_index(m_engine.get_program(), function);
+    return function_index.has_value() && add_watchpoint(function_index, variable);
+}
+
+void ByteCodeVmDebugger::watchpoint_remove(const std::string& variable) {
+    remove_watchpoint(std::nullopt, variable);
+}
+
+void ByteCodeVmDebugger::watchpoint_remove(const std::string& function, const std::string& variable) {
+    std::optional<size_t> function_index = find_function_index(m_engine.get_program(), function);
+
+    if (function_index.has_value()) {
+        remove_watchpoint(function_index, variable);
+    }
+}
+
+// "p" covers the slots of all of p's fields, "p.x" only the one
+static bool is_watched_slot(const std::string& slot_name, const std::string& variable) {
+    return slot_name.compare(0, variable.size(), variable) == 0
+        && (slot_name.size() == variable.size() || slot_name[variable.size()] == '.');
+}
+
+bool ByteCodeVmDebugger::add_watchpoint(std::optional<size_t> function_index, const std::string& variable) {
+    for (const Watchpoint& watchpoint : m_watchpoints) {
+        if (watchpoint.function_index == function_index && watchpoint.variable == variable) {
+            return true;
+        }
+    }
+
+    const Engine& engine = m_vm.get_engine();
+    const std::vector<EngineOp>& operations = engine.get_operations();
+
+    const std::vector<std::string>& slot_names = function_index.has_value()
+        ? engine.get_function(function_index.value()).slot_names
+        : engine.get_global_slot_names();
+
+    std::vector<bool> watched_slots(slot_names.size(), false);
+    bool has_watched_slot = false;
+
+    for (size_t i = 0; i < slot_names.size(); i++) {
+        watched_slots[i] = is_watched_slot(slot_names[i], variable);
+        has_watched_slot = has_watched_slot || watched_slots[i];
+    }
+
+    if (!has_watched_slot) {
+        return false;
+    }
+
+    // A local can only be stored to by its own function's code, which runs up to
+    // wherever the next function starts. A state variable by any of it.
+    size_t begin = 0;
+    size_t end = operations.size();
+    OpType store_type = OpType::STORE_GLOBAL;
+    OpType append_type = OpType::APPEND_GLOBAL;
+
+    if (function_index.has_value()) {
+        begin = engine.get_function(function_index.value()).code_index;
+        store_type = OpType::STORE_LOCAL;
+        append_type = OpType::APPEND_LOCAL;
+
+        for (size_t i = 0; i < engine.get_program().functions.size(); i++) {
+            size_t code_index = engine.get_function(i).code_index;
+
+            if (code_index > begin && code_index < end) {
+                end = code_index;
+            }
+        }
+    }
+
+    Watchpoint watchpoint = { function_index, variable, {} };
+
+    for (size_t i = begin; i < end; i++) {
+        const EngineOp& op = operations[i];
+
+        if (   (op.type == store_type || op.type == append_type) 
+            && op.operand < watched_slots.size() && watched_slots[op.operand]) 
+        {
+            watchpoint.store_code_indices.push_back(i);
+            m_watched_stores[i]++;
+            update_patch(i);
+        }
+    }
+
+    m_watchpoints.push_back(std::move(watchpoint));
+    return true;
+}
+
+void ByteCodeVmDebugger::remove_watchpoint(std::optional<size_t> function_index, const std::string& variable) {
+    for (size_t i = 0; i < m_watchpoints.size(); i++) {
+        const Watchpoint& watchpoint = m_watchpoints[i];
+
+        if (watchpoint.function_index != function_index || watchpoint.variable != variable) {
+            continue;
+        }
+
+        for (size_t code_index : watchpoint.store_code_indices) {
+            if (--m_watched_stores.at(code_index) == 0) {
+                m_watched_stores.erase(code_index);
+            }
+
+            update_patch(code_index);
+        }
+
+        m_watchpoints.erase(m_watchpoints.begin() + i);
+        return;
+    }
+}
+
+void ByteCodeVmDebugger::update_patch(size_t code_index) {
+    bool is_stopped_at = m_breakpoints.count(code_index) > 0 || m_watched_stores.count(code_index) > 0;
+    m_engine.patch_operation(code_index, is_stopped_at ? OpType::BREAKPOINT : m_vm.get_engine().get_operations().at(code_index).type);
 }
 
 void ByteCodeVmDebugger::breakpoint_step() {
+    m_breakpoint_hit = false;
+    m_watchpoint_hit.reset();
+
     if (m_vm.get_is_not_halted()) {
-        m_vm.execute_op();
+        execute_op_watched();
         m_vm.print();
     }
 }
 
 void ByteCodeVmDebugger::breakpoint_continue() {
+    Fiber& fiber = m_vm.get_fiber();
     m_breakpoint_hit = false;
-    while (m_vm.get_is_not_halted() && !m_breakpoint_hit) {
-        m_vm.execute_op();
+    m_watchpoint_hit.reset();
 
-        for (const Breakpoint& breakpoint : m_breakpoints) {
-            if (breakpoint.code_index == m_vm.get_program_counter()) {
-                m_breakpoint_hit = true;
-                break;
-            }
+    // The operation the fiber is on runs even when it has a breakpoint, which is what
+    // lets it continue from one
+    bool is_stopped = m_vm.get_is_not_halted() && execute_op_watched();
+
+    while (!is_stopped && m_vm.get_is_not_halted()) {
+        if (m_engine.execute(fiber) != ExecutionStatus::BREAKPOINT) {
+            continue;
+        }
+
+        auto itr = m_breakpoints.find(fiber.program_counter);
+
+        if (itr != m_breakpoints.end() && (!itr->second.condition || evaluate_condition(*itr->second.condition))) {
+            m_breakpoint_hit = true;
+            break;
         }
+
+        // A breakpoint whose condition is false, or a watched store
+        is_stopped = execute_op_watched();
     }
 
     m_vm.print();
-}
\ No newline at end of file
+}
+
+bool ByteCodeVmDebugger::execute_op_watched() {
+    Fiber& fiber = m_vm.get_fiber();
+    size_t code_index = fiber.program_counter;
+
+    if (m_watched_stores.count(code_index) == 0) {
+        m_vm.execute_op();
+        return false;
+    }
+
+    const Engine& engine = m_vm.get_engine();
+    const EngineOp& op = engine.get_operations().at(code_index);
+
+    bool is_local = op.type == OpType::STORE_LOCAL || op.type == OpType::APPEND_LOCAL;
+    const std::string& variable = is_local
+        ? engine.get_function(fiber.function_index).slot_names.at(op.operand)
+        : engine.get_global_slot_names().at(op.operand);
+
+    auto get_value = [&]() -> std::pair<Type, TypeVariant> {
+        ByteCodeVmState state = m_vm.get_state();
+        auto itr = state.variables.find(variable);
+
+        return itr != state.variables.end() ? itr->second : std::pair<Type, TypeVariant>(Type::VOID, TypeVariant());
+    };
+
+    std::pair<Type, TypeVariant> old_value = get_value();
+    m_vm.execute_op();
+    m_watchpoint_hit = WatchpointHit{ code_index, variable, std::move(old_value), get_value() };
+
+    return true;
+}
+
+bool ByteCodeVmDebugger::get_breakpoint_hit() const {
+    return m_breakpoint_hit;
+}
+
+const std::optional<WatchpointHit>& ByteCodeVmDebugger::get_watchpoint_hit() const {
+    return m_watchpoint_hit;
+}
+
+bool ByteCodeVmDebugger::evaluate_condition(BreakpointCondition& condition) const {
+    ByteCodeVmState state = m_vm.get_state();
+    std::vector<TypeVariant> args;
+
+    // Variables that haven't been stored to yet at the breakpoint read as zero
+    for (const Variable& argument : condition.arguments) {
+        auto itr = state.variables.find(argument.name);
+
+        if (itr != state.variables.end() && itr->second.first == argument.type) {
+            args.push_back(itr->second.second);
+        }
+
+        else {
+            args.push_back(get_default_value(argument.type));
+        }
+    }
+
+    condition.vm->call_function_span(condition.function, args.data(), args.size());
+
+    bool result = condition.vm->get_stack().top_as_bool();
+    condition.vm->get_stack().pop();
+
+    return result;
+}
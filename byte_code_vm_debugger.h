@@ -2,10 +2,51 @@
 
 #include "byte_code_vm.h"
 
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// A condition compiled into a program of its own, as a function taking the variables
+// in scope at the breakpoint
+struct BreakpointCondition {
+    Program program;
+    std::unique_ptr<ByteCodeVm> vm;
+    FunctionHandle function;
+    std::vector<Variable> arguments;
+};
+
 struct Breakpoint {
     size_t code_index;
+    std::unique_ptr<BreakpointCondition> condition;
 };
 
+// A variable, or one field of a struct as "variable.field", of a script function or
+// of the state when function_index is empty
+struct Watchpoint {
+    std::optional<size_t> function_index;
+    std::string variable;
+
+    // The stores that can write it, which are the only operations patched for it
+    std::vector<size_t> store_code_indices;
+};
+
+struct WatchpointHit {
+    size_t code_index;
+
+    // The slot written, a struct field when a whole struct is watched
+    std::string variable;
+
+    // VOID for a variable that hadn't been stored to before
+    std::pair<Type, TypeVariant> old_value;
+    std::pair<Type, TypeVariant> new_value;
+};
+
+// Runs a vm's fiber on a copy of its engine with BREAKPOINT patched over every
+// operation that has a breakpoint or is a watched store, so the fiber runs at full
+// speed and only stops when it reaches one. The operation under a breakpoint is run
+// on the vm's own engine.
 class ByteCodeVmDebugger {
 public:
     ByteCodeVmDebugger(ByteCodeVm& vm);
@@ -14,15 +55,59 @@ public:
 
     void breakpoint_add(size_t code_index);
 
+    // Only stops when the condition is true. The condition is an expression that can
+    // use the arguments, locals and state variables visible at code_index, that aren't
+    // structs or arrays, and the program's external functions. Returns false when it
+    // doesn't compile.
+    bool breakpoint_add(size_t code_index, std::string_view condition);
+
     void breakpoint_remove(size_t code_index);
 
+    // Stops right after any store to a state variable, with the fiber on the
+    // operation after the store. Watching a struct watches each of its fields. Stores
+    // through an array element aren't seen. Returns false when there's no such variable.
+    bool watchpoint_add(const std::string& variable);
+
+    // The same for an argument or local of a script function, in any of its frames
+    bool watchpoint_add(const std::string& function, const std::string& variable);
+
+    void watchpoint_remove(const std::string& variable);
+
+    void watchpoint_remove(const std::string& function, const std::string& variable);
+
     void breakpoint_step();
 
     void breakpoint_continue();
 
+    bool get_breakpoint_hit() const;
+
+    // The store the last step or continue stopped at, if it stopped at one
+    const std::optional<WatchpointHit>& get_watchpoint_hit() const;
+
+private:
+    bool evaluate_condition(BreakpointCondition& condition) const;
+
+    bool add_watchpoint(std::optional<size_t> function_index, const std::string& variable);
+
+    void remove_watchpoint(std::optional<size_t> function_index, const std::string& variable);
+
+    // Patches BREAKPOINT over the operation while anything stops there, and puts the
+    // vm's operation back once nothing does
+    void update_patch(size_t code_index);
+
+    // Runs the operation the fiber is on, and returns true when it was a watched store
+    bool execute_op_watched();
+
 private:
     ByteCodeVm& m_vm;
+    Engine m_engine;
 
-    std::vector<Breakpoint> m_breakpoints;
+    std::unordered_map<size_t, Breakpoint> m_breakpoints;
     bool m_breakpoint_hit;
+
+    std::vector<Watchpoint> m_watchpoints;
+
+    // How many watchpoints each patched store is watched by
+    std::unordered_map<size_t, size_t> m_watched_stores;
+    std::optional<WatchpointHit> m_watchpoint_hit;
 };
@@ -4,9 +4,89 @@
 #include "byte_code_printer.h"
 
 #include <string>
+#include <cstring>
+
+static size_t get_value_size(Type type) {
+    if (is_array_type(type)) {
+        return sizeof(ArrayView);
+    }
+
+    switch (type) {
+        case Type::STRING:  return sizeof(VmStringBuffer*);
+        case Type::BOOL:    return sizeof(bool);
+        case Type::INT:     return sizeof(int);
+        case Type::FLOAT:   return sizeof(float);
+        case Type::INT2:
+        case Type::INT4:    return sizeof(IntVector);
+        case Type::FLOAT2:
+        case Type::FLOAT3:
+        case Type::FLOAT4:  return sizeof(FloatVector);
+        default:            return 0;
+    }
+}
+
+ByteStack::ByteStack(std::pmr::memory_resource* memory)
+    : m_buffer (memory)
+{}
+
+ByteStack::ByteStack(const ByteStack& other)
+    : m_buffer (other.m_buffer)
+    , m_string_count (other.m_string_count)
+{
+    retain_strings(0);
+}
+
+ByteStack::ByteStack(ByteStack&& other) noexcept
+    : m_buffer (std::move(other.m_buffer))
+    , m_string_count (other.m_string_count)
+{
+    other.m_buffer.clear();
+    other.m_string_count = 0;
+}
+
+ByteStack::~ByteStack() {
+    release_strings(0);
+}
+
+ByteStack& ByteStack::operator=(const ByteStack& other) {
+    if (this != &other) {
+        other.retain_strings(0);
+        release_strings(0);
+
+        m_buffer = other.m_buffer;
+        m_string_count = other.m_string_count;
+    }
+
+    return *this;
+}
+
+ByteStack& ByteStack::operator=(ByteStack&& other) noexcept {
+    if (this != &other) {
+        release_strings(0);
+
+        m_buffer = std::move(other.m_buffer);
+        m_string_count = other.m_string_count;
+
+        other.m_buffer.clear();
+        other.m_string_count = 0;
+    }
+
+    return *this;
+}
 
 void ByteStack::push_string(std::string_view val) {
-    write_string(val);
+    write_string(vm_string_allocate(val, get_memory()));
+    write_type(Type::STRING);
+}
+
+void ByteStack::push_vm_string(const VmString& val) {
+    vm_string_retain(val.get_buffer());
+    write_string(val.get_buffer());
+    write_type(Type::STRING);
+}
+
+void ByteStack::push_vm_string(VmString&& val) {
+    write_string(val.release_buffer());
     write_type(Type::STRING);
 }
 
@@ -25,19 +105,74 @@ void ByteStack::push_float(const float& val) {
     write_type(Type::FLOAT);
 }
 
+void ByteStack::push_array(const ArrayView& val) {
+    write(val);
+    write_type(array_type(val.element_type));
+}
+
+void ByteStack::push_int_vector(const IntVector& val) {
+    write(val);
+    write_type(val.type);
+}
+
+void ByteStack::push_float_vector(const FloatVector& val) {
+    write(val);
+    write_type(val.type);
+}
+
+void ByteStack::push(std::string_view val) {
+    push_string(val);
+}
+
+void ByteStack::push(const char* val) {
+    push_string(val);
+}
+
+void ByteStack::push(const std::string& val) {
+    push_string(val);
+}
+
+void ByteStack::push(const VmString& val) {
+    push_vm_string(val);
+}
+
+void ByteStack::push(bool val) {
+    push_bool(val);
+}
+
+void ByteStack::push(int val) {
+    push_int(val);
+}
+
+void ByteStack::push(float val) {
+    push_float(val);
+}
+
+void ByteStack::push(const ArrayView& val) {
+    push_array(val);
+}
+
+void ByteStack::push(const IntVector& val) {
+    push_int_vector(val);
+}
+
+void ByteStack::push(const FloatVector& val) {
+    push_float_vector(val);
+}
+
 const Type& ByteStack::top_value_type(size_t item_index) const {
     size_t head = get_item_offset(item_index);
     return read<Type>(head);
 }
 
 std::string_view ByteStack::top_as_string(size_t item) const {
-    size_t head = get_value_offset(item); // this could wrap, but get_item_offset adds 1 so it's fine
-
-    const size_t& string_len = read<size_t>(head);
-    head -= sizeof(size_t);
-    head -= string_len;
+    size_t head = get_value_offset(item);
+    return vm_string_view(read<VmStringBuffer*>(head));
+}
 
-    return std::string_view(m_buffer.data() + head, string_len);
+VmString ByteStack::top_as_vm_string(size_t item) const {
+    size_t head = get_value_offset(item);
+    return VmString::share(read<VmStringBuffer*>(head));
 }
 
 const bool& ByteStack::top_as_bool(size_t item) const {
@@ -55,26 +190,193 @@ const float& ByteStack::top_as_float(size_t item) const{
     return read<float>(head);
 }
 
+const ArrayView& ByteStack::top_as_array(size_t item) const {
+    size_t head = get_value_offset(item);
+    return read<ArrayView>(head);
+}
+
+const IntVector& ByteStack::top_as_int_vector(size_t item) const {
+    size_t head = get_value_offset(item);
+    return read<IntVector>(head);
+}
+
+const FloatVector& ByteStack::top_as_float_vector(size_t item) const {
+    size_t head = get_value_offset(item);
+    return read<FloatVector>(head);
+}
+
 void ByteStack::pop(size_t item_count) {
     size_t head = get_item_offset(item_count);
+
+    if (m_string_count > 0) {
+        release_strings(head);
+    }
+
     m_buffer.erase(m_buffer.begin() + head, m_buffer.end());
 }
 
+void ByteStack::pop_under(size_t item_count) {
+    size_t tail = get_item_offset(1);
+    size_t head = get_item_offset(item_count + 1);
+
+    if (m_string_count > 0) {
+        release_strings(head, tail);
+    }
+
+    m_buffer.erase(m_buffer.begin() + head, m_buffer.begin() + tail);
+}
+
+VmString ByteStack::pop_vm_string() {
+    size_t head = get_value_offset(0);
+    VmString value = VmString::adopt(read<VmStringBuffer*>(head));
+
+    m_buffer.erase(m_buffer.begin() + head - sizeof(VmStringBuffer*), m_buffer.end());
+    m_string_count--;
+
+    return value;
+}
+
+void ByteStack::clear() {
+    release_strings(0);
+    m_buffer.clear();
+}
+
+void ByteStack::shrink_to_fit() {
+    m_buffer.shrink_to_fit();
+}
+
+void ByteStack::detach_arena_strings() {
+    detach_strings(true);
+}
+
+void ByteStack::detach_strings() {
+    detach_strings(false);
+}
+
+std::pmr::memory_resource* ByteStack::get_memory() const {
+    return m_buffer.get_allocator().resource();
+}
+
+void ByteStack::detach_strings(bool arena_only) {
+    if (m_string_count == 0) {
+        return;
+    }
+
+    size_t head = m_buffer.size();
+
+    while (head >= sizeof(Type)) {
+        Type type = read<Type>(head);
+        head -= sizeof(Type);
+
+        if (type == Type::STRING) {
+            VmStringBuffer*& buffer = *reinterpret_cast<VmStringBuffer**>(m_buffer.data() + head - sizeof(VmStringBuffer*));
+            VmString value = VmString::adopt(buffer);
+
+            value = arena_only ? vm_string_detach_from_arena(value, get_memory()) : vm_string_detach(value);
+            buffer = value.release_buffer();
+        }
+
+        head -= get_value_size(type);
+    }
+}
+
 size_t ByteStack::size() const {
     return m_buffer.size();
 }
 
+size_t ByteStack::item_count() const {
+    size_t head = m_buffer.size();
+    size_t count = 0;
+
+    while (head >= sizeof(Type)) {
+        const Type& type = read<Type>(head);
+        head -= sizeof(Type);
+        head -= get_value_size(type);
+        count++;
+    }
+
+    return count;
+}
+
 bool ByteStack::equals(const ByteStack& other) const {
-    return m_buffer == other.m_buffer;
+    if (m_buffer.size() != other.m_buffer.size()) {
+        return false;
+    }
+
+    // Equal strings can sit in different buffers, so they are compared by their characters
+    size_t head = m_buffer.size();
+
+    while (head >= sizeof(Type)) {
+        Type type = read<Type>(head);
+
+        if (type != other.read<Type>(head)) {
+            return false;
+        }
+
+        head -= sizeof(Type);
+
+        size_t value_size = get_value_size(type);
+
+        if (type == Type::STRING) {
+            if (vm_string_view(read<VmStringBuffer*>(head)) != vm_string_view(other.read<VmStringBuffer*>(head))) {
+                return false;
+            }
+        }
+
+        else if (std::memcmp(m_buffer.data() + head - value_size, other.m_buffer.data() + head - value_size, value_size) != 0) {
+            return false;
+        }
+
+        head -= value_size;
+    }
+
+    return true;
 }
 
 void ByteStack::write_type(Type type) {
     write<char>(static_cast<char>(type));
 }
 
-void ByteStack::write_string(const std::string_view& value) {
-    m_buffer.insert(m_buffer.end(), value.begin(), value.end());
-    write<size_t>(value.size());
+void ByteStack::write_string(VmStringBuffer* buffer) {
+    write(buffer);
+    m_string_count++;
+}
+
+void ByteStack::retain_strings(size_t head) const {
+    size_t item_head = m_buffer.size();
+    size_t string_count = m_string_count;
+
+    while (string_count > 0 && item_head > head) {
+        Type type = read<Type>(item_head);
+        item_head -= sizeof(Type);
+
+        if (type == Type::STRING) {
+            vm_string_retain(read<VmStringBuffer*>(item_head));
+            string_count--;
+        }
+
+        item_head -= get_value_size(type);
+    }
+}
+
+void ByteStack::release_strings(size_t head) {
+    release_strings(head, m_buffer.size());
+}
+
+void ByteStack::release_strings(size_t head, size_t tail) {
+    size_t item_head = tail;
+
+    while (m_string_count > 0 && item_head > head) {
+        Type type = read<Type>(item_head);
+        item_head -= sizeof(Type);
+
+        if (type == Type::STRING) {
+            vm_string_release(read<VmStringBuffer*>(item_head));
+            m_string_count--;
+        }
+
+        item_head -= get_value_size(type);
+    }
 }
 
 size_t ByteStack::get_item_offset(size_t item_index) const {
@@ -87,27 +389,7 @@ size_t ByteStack::get_item_offset(size_t item_index) const {
 
         const Type& type = read<Type>(head);
         head -= sizeof(Type);
-
-        switch (type) {
-            case Type::STRING: { 
-                const size_t& string_len = read<size_t>(head);
-                head -= sizeof(size_t);
-                head -= string_len;
-                break;
-            }
-            case Type::BOOL: {
-                head -= sizeof(bool);
-                break;
-            }
-            case Type::INT: {
-                head -= sizeof(int);
-                break;
-            }
-            case Type::FLOAT: { 
-                head -= sizeof(float);
-                break;
-            }
-        }
+        head -= get_value_size(type);
     }
 
     return head;
@@ -132,15 +414,17 @@ void ByteStack::print() const {
 
         printf("%s ", type_to_string(type).data());
 
+        if (is_array_type(type)) {
+            print_array(read<ArrayView>(head));
+            head -= sizeof(ArrayView);
+            printf("\n");
+            continue;
+        }
+
         switch (type) {
             case Type::STRING: { 
-                const size_t& string_len = read<size_t>(head);
-                head -= sizeof(size_t);
-                head -= string_len;
-
-                std::string_view value(m_buffer.data() + head, string_len);
-                print_string(value);
-
+                print_string(vm_string_view(read<VmStringBuffer*>(head)));
+                head -= sizeof(VmStringBuffer*);
                 break;
             }
             case Type::BOOL: {
@@ -161,6 +445,19 @@ void ByteStack::print() const {
                 head -= sizeof(float);
                 break;
             }
+            case Type::INT2:
+            case Type::INT4: {
+                print_int_vector(read<IntVector>(head));
+                head -= sizeof(IntVector);
+                break;
+            }
+            case Type::FLOAT2:
+            case Type::FLOAT3:
+            case Type::FLOAT4: {
+                print_float_vector(read<FloatVector>(head));
+                head -= sizeof(FloatVector);
+                break;
+            }
         }
 
         printf("\n");
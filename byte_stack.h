@@ -1,36 +1,114 @@
 #pragma once
 
+#include <memory_resource>
 #include <vector>
+#include <string>
 #include <string_view>
 
-#include "byte_code_enum.h"
+#include "byte_code_types.h"
 
+// Strings are kept on the stack as a reference to their shared buffer, so pushing a
+// string that already exists and popping one only count references
 class ByteStack {
 public:
+    ByteStack() = default;
+
+    // Strings pushed from the host are allocated from memory as well
+    explicit ByteStack(std::pmr::memory_resource* memory);
+
+    ByteStack(const ByteStack& other);
+
+    ByteStack(ByteStack&& other) noexcept;
+
+    ~ByteStack();
+
+    ByteStack& operator=(const ByteStack& other);
+
+    ByteStack& operator=(ByteStack&& other) noexcept;
+
     void push_string(std::string_view val);
+    void push_vm_string(const VmString& val);
+    void push_vm_string(VmString&& val);
     void push_bool(bool val);
     void push_int(int val);
     void push_float(const float& val);
+    void push_array(const ArrayView& val);
+    void push_int_vector(const IntVector& val);
+    void push_float_vector(const FloatVector& val);
+
+    // Overloads for pushing host values without naming their type
+    void push(std::string_view val);
+    void push(const char* val);
+    void push(const std::string& val);
+    void push(const VmString& val);
+    void push(bool val);
+    void push(int val);
+    void push(float val);
+    void push(const ArrayView& val);
+    void push(const IntVector& val);
+    void push(const FloatVector& val);
+    void push(const void* val) = delete;
 
     const Type& top_value_type(size_t item_index = 0) const;
 
     std::string_view top_as_string(size_t item_index = 0) const;
+
+    // Shares the buffer, use vm_string_detach() to keep it longer than the vm
+    VmString top_as_vm_string(size_t item_index = 0) const;
     const bool& top_as_bool(size_t item_index = 0) const;
     const int& top_as_int(size_t item_index = 0) const;
     const float& top_as_float(size_t item_index = 0) const;
+    const ArrayView& top_as_array(size_t item_index = 0) const;
+    const IntVector& top_as_int_vector(size_t item_index = 0) const;
+    const FloatVector& top_as_float_vector(size_t item_index = 0) const;
 
     void pop(size_t item_count = 1);
 
+    // Pops item_count items from under the one on top, which moves down in their place
+    void pop_under(size_t item_count);
+
+    // Pops the string on top, handing its reference over without counting it
+    VmString pop_vm_string();
+
+    // Drops every item but keeps the buffer's capacity
+    void clear();
+
+    void shrink_to_fit();
+
+    // Swaps every arena string for a copy in the stack's memory
+    void detach_arena_strings();
+
+    // Swaps every string that isn't on the default heap for a copy there, for stacks
+    // handed to the host
+    void detach_strings();
+
+    std::pmr::memory_resource* get_memory() const;
+
+    // In bytes
     size_t size() const;
 
+    // Walks the whole stack to count its items
+    size_t item_count() const;
+
     bool equals(const ByteStack& other) const;
 
     void print() const;
 
 private:
     void write_type(Type type);
-    
-    void write_string(const std::string_view& value);
+
+    // Takes over one reference to the buffer
+    void write_string(VmStringBuffer* buffer);
+
+    // Counts another reference to, or drops one from, every string above the head
+    void retain_strings(size_t head) const;
+
+    void release_strings(size_t head);
+
+    // Only the strings between the head and the tail
+    void release_strings(size_t head, size_t tail);
+
+    void detach_strings(bool arena_only);
 
     template<typename T>
     void write(const T& value) {
@@ -48,5 +126,8 @@ private:
     size_t get_value_offset(size_t item_index) const;
 
 private:
-    std::vector<char> m_buffer;
+    std::pmr::vector<char> m_buffer;
+
+    // Most stacks never hold a string, popping only looks for them when there are some
+    size_t m_string_count = 0;
 };
\ No newline at end of file
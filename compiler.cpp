@@ -6,25 +6,83 @@
 #include "SimpleLangLexer.h"
 #include "SimpleLangParser.h"
 
-CompilationResults compile(std::string_view text, const std::vector<ExternalFunction>& external_functions) {
+static size_t(*s_allocation_counter)() = nullptr;
+
+static size_t get_allocation_count() {
+    return s_allocation_counter ? s_allocation_counter() : 0;
+}
+
+static size_t count_parse_tree_nodes(antlr4::tree::ParseTree* tree) {
+    size_t count = 1;
+
+    for (antlr4::tree::ParseTree* child : tree->children) {
+        count += count_parse_tree_nodes(child);
+    }
+
+    return count;
+}
+
+CompilationResults compile(std::string_view text, const std::vector<ExternalFunction>& external_functions, bool collect_stats, bool quiet) {
+    CompilationStats stats;
+    CompilationStats* phase_stats = collect_stats ? &stats : nullptr;
+
     antlr4::ANTLRInputStream input(text);
     SimpleLangLexer lexer(&input);
     antlr4::CommonTokenStream tokens(&lexer);
     SimpleLangParser parser(&tokens);
 
-    antlr4::tree::ParseTree* tree = parser.program();
+    // Lexes everything up front, the parser would otherwise pull tokens as it goes
+    {
+        CompilationPhaseTimer timer(phase_stats ? &stats.lexing : nullptr);
+        tokens.fill();
+    }
+
+    antlr4::tree::ParseTree* tree;
+    {
+        CompilationPhaseTimer timer(phase_stats ? &stats.parsing : nullptr);
+        tree = parser.program();
+    }
+
+    if (collect_stats) {
+        stats.token_count = tokens.size();
+        stats.parse_tree_node_count = count_parse_tree_nodes(tree);
+    }
 
     if (parser.getNumberOfSyntaxErrors() > 0) {
         printf("Parsing failed: syntax errors encountered\n");
-        return {{}, { CompilationErrorType::PARSE_ERROR }};
+
+        CompilationResults result = {{}, { CompilationErrorType::PARSE_ERROR }};
+
+        if (collect_stats) {
+            result.stats = stats;
+        }
+
+        return result;
     }
     
-    printf("\nAST:\n");
-    std::cout << tree->toStringTree(&parser) << std::endl;
+    // The trace would be timed as part of visiting
+    bool trace = !quiet && !collect_stats;
 
-    printf("\nVisitor Trace:\n");
+    if (trace) {
+        printf("\nAST:\n");
+        std::cout << tree->toStringTree(&parser) << std::endl;
 
-    CompilationResults result = generate_byte_code(tree, external_functions);
+        printf("\nVisitor Trace:\n");
+    }
+
+    CompilationResults result;
+    {
+        CompilationPhaseTimer timer(phase_stats ? &stats.visiting : nullptr);
+        result = generate_byte_code(tree, external_functions, phase_stats, trace);
+    }
+
+    if (collect_stats) {
+        // Code generation ran inside the visit, so it's taken back out
+        stats.visiting.milliseconds -= stats.code_generation.milliseconds;
+        stats.visiting.allocation_count -= stats.code_generation.allocation_count;
+        stats.instruction_count = result.program.operations.size();
+        result.stats = stats;
+    }
     
     if (result.error.type != CompilationErrorType::NONE) {
         CompilationError error = result.error;
@@ -41,4 +99,43 @@ CompilationResults compile(std::string_view text, const std::vector<ExternalFunc
     }
 
     return result;
-}
\ No newline at end of file
+}
+
+void print_compilation_stats(const CompilationStats& stats) {
+    const std::pair<const char*, const CompilationPhase*> phases[] = {
+        { "lexing", &stats.lexing },
+        { "parsing", &stats.parsing },
+        { "visiting", &stats.visiting },
+        { "code generation", &stats.code_generation },
+    };
+
+    printf("\n%-16s %12s %12s\n", "phase", "ms", "allocations");
+
+    for (const auto& [name, phase] : phases) {
+        printf("%-16s %12.3f %12zu\n", name, phase->milliseconds, phase->allocation_count);
+    }
+
+    printf("\ntokens: %zu\n", stats.token_count);
+    printf("parse tree nodes: %zu\n", stats.parse_tree_node_count);
+    printf("instructions: %zu\n", stats.instruction_count);
+}
+
+void set_compilation_allocation_counter(size_t(*counter)()) {
+    s_allocation_counter = counter;
+}
+
+CompilationPhaseTimer::CompilationPhaseTimer(CompilationPhase* phase)
+    : m_phase (phase)
+{
+    if (m_phase) {
+        m_start = std::chrono::steady_clock::now();
+        m_allocation_start = get_allocation_count();
+    }
+}
+
+CompilationPhaseTimer::~CompilationPhaseTimer() {
+    if (m_phase) {
+        m_phase->milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+        m_phase->allocation_count += get_allocation_count() - m_allocation_start;
+    }
+}
@@ -2,6 +2,30 @@
 
 #include "compiler_result.h"
 
+#include <chrono>
 #include <string_view>
 
-CompilationResults compile(std::string_view text, const std::vector<ExternalFunction>& external_functions);
\ No newline at end of file
+// Quiet skips printing the parse tree and the visitor's trace, as does collecting stats.
+// Errors are still printed.
+CompilationResults compile(std::string_view text, const std::vector<ExternalFunction>& external_functions, bool collect_stats = false, bool quiet = false);
+
+void print_compilation_stats(const CompilationStats& stats);
+
+// Lets the stats count allocations for each phase. The counter returns how many
+// allocations the process has made so far, hosts usually count them in a replaced
+// operator new. Set it once before compiling.
+void set_compilation_allocation_counter(size_t(*counter)());
+
+// Adds the time and allocations from its construction to its destruction to a phase,
+// or does nothing for a null phase
+class CompilationPhaseTimer {
+public:
+    explicit CompilationPhaseTimer(CompilationPhase* phase);
+
+    ~CompilationPhaseTimer();
+
+private:
+    CompilationPhase* m_phase;
+    std::chrono::steady_clock::time_point m_start;
+    size_t m_allocation_start = 0;
+};
@@ -2,6 +2,7 @@
 
 #include "program.h"
 
+#include <optional>
 #include <vector>
 #include <variant>
 
@@ -21,7 +22,28 @@ struct CompilationError {
     CompilationErrorVariant info;
 };
 
+struct CompilationPhase {
+    double milliseconds = 0;
+
+    // Only counted when the host has set an allocation counter
+    size_t allocation_count = 0;
+};
+
+struct CompilationStats {
+    CompilationPhase lexing;
+    CompilationPhase parsing;
+    CompilationPhase visiting;
+    CompilationPhase code_generation;
+
+    size_t token_count = 0;
+    size_t parse_tree_node_count = 0;
+    size_t instruction_count = 0;
+};
+
 struct CompilationResults {
     Program program;
     CompilationError error;
+
+    // Set when compile() was asked to collect stats, as far as it got on an error
+    std::optional<CompilationStats> stats;
 };
\ No newline at end of file
@@ -1,7 +1,10 @@
 #include "compiler_visitor.h"
 
+#include <algorithm>
+
 #include "byte_code_enum_translation.h"
 #include "byte_code_generator.h"
+#include "compiler.h"
 #include "byte_code_vm.h"
 #include "binary_ops.h" 
 #include "unary_ops.h" 
@@ -14,6 +17,10 @@ class BytecodeEmitter : public SimpleLangVisitor {
 public:
     ByteCodeGenerator gen;
     StackLogger logger;
+    CompilationStats* stats = nullptr;
+
+    // Array accesses proven to be in bounds by an enclosing loop, as (array, index) names
+    std::vector<std::pair<std::string, std::string>> in_bounds_indices;
 
     void panic(const antlr4::ParserRuleContext* context, CompilationErrorType type, CompilationErrorVariant info) {
         gen.set_error({
@@ -30,6 +37,13 @@ public:
         throw std::runtime_error("panic");
     }
 
+    // Only builds the node's text when the trace is printed
+    void log_node(const char* format, antlr4::tree::ParseTree* context) {
+        if (logger.is_enabled()) {
+            logger(format, context->getText().c_str());
+        }
+    }
+
     Program visit_program(antlr4::tree::ParseTree* tree) {
         return std::any_cast<Program>(visit(tree));
     }
@@ -42,6 +56,30 @@ public:
         return std::any_cast<Type>(visit(context));
     }
 
+    Type visit_expression(SimpleLangParser::ExpressionTypeVariableAccessContext* context) {
+        return std::any_cast<Type>(visit(context));
+    }
+
+    Type visit_expression(SimpleLangParser::ExpressionTypeInitializerListContext* context) {
+        return std::any_cast<Type>(visit(context));
+    }
+
+    Type visit_expression(SimpleLangParser::ExpressionArrayIndexContext* context) {
+        return std::any_cast<Type>(visit(context));
+    }
+
+    Type visit_expression(SimpleLangParser::ExpressionArrayLengthContext* context) {
+        return std::any_cast<Type>(visit(context));
+    }
+
+    Type visit_expression(SimpleLangParser::ExpressionVectorConstructorContext* context) {
+        return std::any_cast<Type>(visit(context));
+    }
+
+    Type visit_expression(SimpleLangParser::ExpressionVectorBuiltinContext* context) {
+        return std::any_cast<Type>(visit(context));
+    }
+
     std::vector<Type> visit_expression_list(SimpleLangParser::ExpressionListContext* context) {
         if (!context) {
             return {};
@@ -58,6 +96,10 @@ public:
         return std::any_cast<Type>(visit(context));
     }
 
+    Variable visit_type_variable(SimpleLangParser::TypeVariableDeclarationContext* context) {
+        return std::any_cast<Variable>(visit(context));
+    }
+
     Variable visit_argument(SimpleLangParser::ArgumentContext* context) {
         return std::any_cast<Variable>(visit(context));
     }
@@ -78,6 +120,323 @@ public:
         gen.emit(std::move(op));
     }
 
+    // Structs are pushed one slot at a time, so they are stored in reverse
+    // with the last slot coming off the top of the stack first
+
+    void emit_push_field(const std::string& identifier, const ObjectType& object, size_t offset, size_t slot_count) {
+        for (size_t i = offset; i < offset + slot_count; i++) {
+            emit({
+                OpType::PUSH_FIELD,
+                ByteCodeFieldOp {
+                    object.slot_types.at(i),
+                    identifier,
+                    i
+                }
+            });
+        }
+    }
+
+    void emit_store_field(const std::string& identifier, const ObjectType& object, size_t offset, size_t slot_count) {
+        for (size_t i = offset + slot_count; i > offset; i--) {
+            emit({
+                OpType::STORE_FIELD,
+                ByteCodeFieldOp {
+                    object.slot_types.at(i - 1),
+                    identifier,
+                    i - 1
+                }
+            });
+        }
+    }
+
+    void emit_push_variable(Type type, const std::string& identifier) {
+        if (is_object_type(type)) {
+            const ObjectType& object = gen.type_get_object(type);
+            emit_push_field(identifier, object, 0, object.slot_types.size());
+            return;
+        }
+
+        emit({
+            OpType::PUSH_VARIABLE,
+            ByteCodePushVariableOp {
+                type,
+                identifier
+            }
+        });
+    }
+
+    void emit_store_variable(Type type, const std::string& identifier) {
+        if (is_object_type(type)) {
+            const ObjectType& object = gen.type_get_object(type);
+            emit_store_field(identifier, object, 0, object.slot_types.size());
+            return;
+        }
+
+        emit({
+            OpType::STORE_VARIABLE,
+            ByteCodeStoreVariableOp {
+                type,
+                identifier
+            }
+        });
+    }
+
+    void emit_default_value(Type type) {
+        if (is_object_type(type)) {
+            for (Type slot_type : gen.type_get_object(type).slot_types) {
+                emit_default_value(slot_type);
+            }
+
+            return;
+        }
+
+        ByteCodePushLiteralOp literal;
+
+        if (is_array_type(type)) {
+            emit({
+                OpType::PUSH_LITERAL,
+                ByteCodePushLiteralOp { type, ArrayView { array_element_type(type), nullptr, 0 } }
+            });
+
+            return;
+        }
+
+        if (is_int_vector_type(type)) {
+            emit({
+                OpType::PUSH_LITERAL,
+                ByteCodePushLiteralOp { type, IntVector { type, {} } }
+            });
+
+            return;
+        }
+
+        if (is_float_vector_type(type)) {
+            emit({
+                OpType::PUSH_LITERAL,
+                ByteCodePushLiteralOp { type, FloatVector { type, {} } }
+            });
+
+            return;
+        }
+
+        switch (type) {
+            case Type::STRING: literal = { Type::STRING, std::string() }; break;
+            case Type::BOOL:   literal = { Type::BOOL, false }; break;
+            case Type::INT:    literal = { Type::INT, 0 }; break;
+            case Type::FLOAT:  literal = { Type::FLOAT, 0.0f }; break;
+            default:           return;
+        }
+
+        emit({
+            OpType::PUSH_LITERAL,
+            literal
+        });
+    }
+
+    struct FieldAccess {
+        const ObjectType* object;
+        Type type;
+        size_t offset;
+        size_t slot_count;
+    };
+
+    FieldAccess resolve_field(const antlr4::ParserRuleContext* context, const std::string& identifier, const std::string& field_name) {
+        std::optional<Type> variable_type = gen.variable_get_type(identifier);
+
+        if (!variable_type.has_value()) {
+            panic(context, CompilationErrorType::IDENTIFIED_NOT_DECLARED, {});
+        }
+
+        if (!is_object_type(variable_type.value())) {
+            panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+        }
+
+        const ObjectType& object = gen.type_get_object(variable_type.value());
+
+        for (size_t i = 0; i < object.fields.size(); i++) {
+            const Variable& field = object.fields.at(i);
+
+            if (field.name == field_name) {
+                return { &object, field.type, object.field_offsets.at(i), gen.type_get_slot_count(field.type) };
+            }
+        }
+
+        panic(context, CompilationErrorType::IDENTIFIED_NOT_DECLARED, {});
+        return {};
+    }
+
+    // Swizzles like v.x or v.zyx, the op's type is what reading the lanes gives
+    ByteCodeVectorOp parse_swizzle(const antlr4::ParserRuleContext* context, Type vector, const std::string& swizzle) {
+        static const std::string lane_names = "xyzw";
+
+        if (swizzle.empty() || swizzle.size() > 4) {
+            panic(context, CompilationErrorType::IDENTIFIED_NOT_DECLARED, {});
+        }
+
+        ByteCodeVectorOp op{};
+        op.lane_count = swizzle.size();
+
+        for (size_t i = 0; i < swizzle.size(); i++) {
+            size_t lane = lane_names.find(swizzle[i]);
+
+            if (lane == std::string::npos || lane >= vector_width(vector)) {
+                panic(context, CompilationErrorType::IDENTIFIED_NOT_DECLARED, {});
+            }
+
+            op.lanes[i] = static_cast<unsigned char>(lane);
+        }
+
+        op.type = op.lane_count == 1 ? vector_lane_type(vector) : vector_type(vector_lane_type(vector), op.lane_count);
+
+        if (op.type == Type::VOID) {
+            panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+        }
+
+        return op;
+    }
+
+    Type emit_push_array(const antlr4::ParserRuleContext* context, const std::string& identifier) {
+        std::optional<Type> type = gen.variable_get_type(identifier);
+
+        if (!type.has_value()) {
+            panic(context, CompilationErrorType::IDENTIFIED_NOT_DECLARED, {});
+        }
+
+        if (!is_array_type(type.value())) {
+            panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+        }
+
+        emit_push_variable(type.value(), identifier);
+
+        return type.value();
+    }
+
+    bool is_in_bounds(const std::string& array, SimpleLangParser::ExpressionContext* index) const {
+        if (!index->ID()) {
+            return false;
+        }
+
+        std::pair<std::string, std::string> access = { array, index->ID()->getText() };
+
+        return std::find(in_bounds_indices.begin(), in_bounds_indices.end(), access) != in_bounds_indices.end();
+    }
+
+    static bool is_assigned(antlr4::tree::ParseTree* tree, const std::string& identifier, antlr4::tree::ParseTree* ignored) {
+        if (tree == ignored) {
+            return false;
+        }
+
+        if (auto assignment = dynamic_cast<SimpleLangParser::StatementVariableAssignmentContext*>(tree)) {
+            if (assignment->ID()->getText() == identifier) {
+                return true;
+            }
+        }
+
+        for (antlr4::tree::ParseTree* child : tree->children) {
+            if (is_assigned(child, identifier, ignored)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static bool is_int_literal(SimpleLangParser::ExpressionContext* context) {
+        return context->literal() && context->literal()->INT();
+    }
+
+    // Whether the statement before the loop sets the index to a literal, which can't be negative
+    static bool is_set_to_int_literal_before(SimpleLangParser::StatementWhileContext* context, const std::string& identifier) {
+        auto statement = dynamic_cast<SimpleLangParser::StatementContext*>(context->parent);
+        auto block = statement ? dynamic_cast<SimpleLangParser::BlockContext*>(statement->parent) : nullptr;
+
+        if (!block) {
+            return false;
+        }
+
+        std::vector<SimpleLangParser::StatementContext*> statements = block->statement();
+        auto itr = std::find(statements.begin(), statements.end(), statement);
+
+        if (itr == statements.begin() || itr == statements.end()) {
+            return false;
+        }
+
+        SimpleLangParser::StatementContext* previous = *(itr - 1);
+
+        if (auto declaration = previous->statementVariableDeclaration()) {
+            return declaration->ID()->getText() == identifier && is_int_literal(declaration->expression());
+        }
+
+        if (auto assignment = previous->statementVariableAssignment()) {
+            return assignment->ID()->getText() == identifier && is_int_literal(assignment->expression());
+        }
+
+        return false;
+    }
+
+    // Finds loops shaped like
+    //
+    //     int i = 0;
+    //     while (i < len(a)) {
+    //         ...
+    //         i = i + 1;
+    //     }
+    //
+    // where i and a are locals, a isn't assigned in the body, and i only by the increment
+    // at the end. i then stays in [0, len(a)) for the whole body, so a[i] needs no check.
+    // Globals are left out since a function called from the body could change them.
+    std::optional<std::pair<std::string, std::string>> find_in_bounds_index(SimpleLangParser::StatementWhileContext* context) const {
+        SimpleLangParser::ExpressionContext* condition = context->expression();
+
+        if (!condition->op || condition->op->getText() != "<" || condition->expression().size() != 2) {
+            return std::nullopt;
+        }
+
+        SimpleLangParser::ExpressionContext* index = condition->expression(0);
+        SimpleLangParser::ExpressionArrayLengthContext* length = condition->expression(1)->expressionArrayLength();
+
+        if (!index->ID() || !length || !length->expression()->ID()) {
+            return std::nullopt;
+        }
+
+        std::string index_name = index->ID()->getText();
+        std::string array_name = length->expression()->ID()->getText();
+
+        if (gen.variable_is_global(index_name) || gen.variable_is_global(array_name)) {
+            return std::nullopt;
+        }
+
+        if (!is_set_to_int_literal_before(context, index_name)) {
+            return std::nullopt;
+        }
+
+        std::vector<SimpleLangParser::StatementContext*> statements = context->block()->statement();
+
+        if (statements.empty() || !statements.back()->statementVariableAssignment()) {
+            return std::nullopt;
+        }
+
+        // The increment is exactly i = i + 1, so i can't step past len(a) or overflow
+        SimpleLangParser::StatementVariableAssignmentContext* increment = statements.back()->statementVariableAssignment();
+        SimpleLangParser::ExpressionContext* step = increment->expression();
+
+        bool is_increment = 
+               increment->ID()->getText() == index_name
+            && step->op && step->op->getText() == "+" && step->expression().size() == 2
+            && step->expression(0)->ID() && step->expression(0)->ID()->getText() == index_name
+            && is_int_literal(step->expression(1)) && step->expression(1)->getText() == "1";
+
+        if (!is_increment) {
+            return std::nullopt;
+        }
+
+        if (is_assigned(context->block(), index_name, increment) || is_assigned(context->block(), array_name, nullptr)) {
+            return std::nullopt;
+        }
+
+        return std::make_pair(array_name, index_name);
+    }
+
     Type emit_unary_op(const antlr4::ParserRuleContext* context, Type right_type, UnaryOperatorType op) {
         CompilationErrorType err = map_unary_op_validate(right_type, op);
         if (err != CompilationErrorType::NONE) {
@@ -119,11 +478,17 @@ public:
     // Top level program
 
     std::any visitProgram(SimpleLangParser::ProgramContext* context) {
-        logger("program %s", context->getText().c_str());
+        log_node("program %s", context);
         logger.push();
         // gen.scope_push(ScopeType::GLOBAL);
         visitChildren(context);
-        Program program = gen.get_program();
+
+        Program program;
+        {
+            CompilationPhaseTimer timer(stats ? &stats->code_generation : nullptr);
+            program = gen.get_program();
+        }
+
         // gen.scope_pop();
         logger.pop();
         return program;
@@ -132,10 +497,11 @@ public:
     // State
 
     std::any visitStateBlock(SimpleLangParser::StateBlockContext* context) {
-        logger("state block %s", context->getText().c_str());
+        log_node("state block %s", context);
         logger.push();
         
         for (auto decl : context->statementVariableDeclaration()) {
+            gen.set_source_line(decl->start->getLine());
             visit(decl);
         }
 
@@ -147,29 +513,314 @@ public:
     // Types
 
     std::any visitTypeDeclaration(SimpleLangParser::TypeDeclarationContext* context) {
+        log_node("declaration type %s", context);
+        logger.push();
+
+        std::string name = context->TYPE_ID()->getText();
+        std::vector<Variable> fields;
+
+        for (auto declaration : context->typeVariableDeclaration()) {
+            fields.push_back(visit_type_variable(declaration));
+        }
+
+        CompilationErrorType err = gen.type_declare(name, fields);
+
+        if (err != CompilationErrorType::NONE) {
+            panic(context, err, {});
+        }
+
+        logger.pop();
 
+        return nullptr;
     }
 
-    std::any SimpleLangVisitor::visitTypeVariableDeclaration(SimpleLangParser::TypeVariableDeclarationContext* context) {
+    std::any visitTypeVariableDeclaration(SimpleLangParser::TypeVariableDeclarationContext* context) {
+        log_node("type variable declaration %s", context);
+        logger.push();
+
+        Type type = visit_type(context->type());
+        std::string identifier = context->ID()->getText();
+
+        logger.pop();
 
+        return Variable { type, identifier };
     }
 
-    std::any SimpleLangVisitor::visitStatementTypeVariableAssignment(SimpleLangParser::StatementTypeVariableAssignmentContext* context) {
+    std::any visitStatementTypeVariableAssignment(SimpleLangParser::StatementTypeVariableAssignmentContext* context) {
+        log_node("statement type variable assignment %s", context);
+        logger.push();
+
+        std::string identifier = context->ID(0)->getText();
+        std::optional<Type> variable_type = gen.variable_get_type(identifier);
+
+        // Writing vector lanes is a read, modify, write of the whole vector
+        if (variable_type.has_value() && is_vector_type(variable_type.value())) {
+            ByteCodeVectorOp lanes = parse_swizzle(context, variable_type.value(), context->ID(1)->getText());
+
+            for (size_t i = 0; i < lanes.lane_count; i++) {
+                if (std::count(lanes.lanes.begin(), lanes.lanes.begin() + lanes.lane_count, lanes.lanes[i]) > 1) {
+                    panic(context, CompilationErrorType::IDENTIFIED_ALREADY_DECLARED, {});
+                }
+            }
+
+            emit_push_variable(variable_type.value(), identifier);
+
+            if (visit_expression(context->expression()) != lanes.type) {
+                panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+            }
+
+            lanes.type = variable_type.value();
+
+            emit({
+                OpType::VECTOR_INSERT,
+                lanes
+            });
+
+            emit_store_variable(variable_type.value(), identifier);
+
+            logger.pop();
 
+            return nullptr;
+        }
+
+        FieldAccess field = resolve_field(context, identifier, context->ID(1)->getText());
+
+        Type type = visit_expression(context->expression());
+
+        if (type != field.type) {
+            panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+        }
+
+        emit_store_field(identifier, *field.object, field.offset, field.slot_count);
+
+        logger.pop();
+
+        return nullptr;
     }
 
-    std::any SimpleLangVisitor::visitExpressionTypeVariableAccess(SimpleLangParser::ExpressionTypeVariableAccessContext* context) {
+    std::any visitExpressionTypeVariableAccess(SimpleLangParser::ExpressionTypeVariableAccessContext* context) {
+        log_node("expression type variable access %s", context);
+        logger.push();
+
+        std::string identifier = context->ID(0)->getText();
+        std::optional<Type> variable_type = gen.variable_get_type(identifier);
 
+        if (variable_type.has_value() && is_vector_type(variable_type.value())) {
+            ByteCodeVectorOp swizzle = parse_swizzle(context, variable_type.value(), context->ID(1)->getText());
+
+            emit_push_variable(variable_type.value(), identifier);
+
+            emit({
+                OpType::VECTOR_SWIZZLE,
+                swizzle
+            });
+
+            logger.pop();
+
+            return swizzle.type;
+        }
+
+        FieldAccess field = resolve_field(context, identifier, context->ID(1)->getText());
+
+        emit_push_field(identifier, *field.object, field.offset, field.slot_count);
+
+        logger.pop();
+
+        return field.type;
     }
 
-    std::any SimpleLangVisitor::visitExpressionTypeInitializerList(SimpleLangParser::ExpressionTypeInitializerListContext* context) {
+    std::any visitStatementArrayAssignment(SimpleLangParser::StatementArrayAssignmentContext* context) {
+        log_node("statement array assignment %s", context);
+        logger.push();
+
+        std::string identifier = context->ID()->getText();
+
+        // The value goes first so the array and index end up on top of it
+        Type value_type = visit_expression(context->expression(1));
+        Type type = emit_push_array(context, identifier);
+
+        if (value_type != array_element_type(type)) {
+            panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+        }
+
+        if (visit_expression(context->expression(0)) != Type::INT) {
+            panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+        }
+
+        emit({
+            is_in_bounds(identifier, context->expression(0)) ? OpType::STORE_INDEX_UNCHECKED : OpType::STORE_INDEX,
+            ByteCodeIndexOp { array_element_type(type) }
+        });
+
+        logger.pop();
+
+        return nullptr;
+    }
+
+    std::any visitExpressionArrayIndex(SimpleLangParser::ExpressionArrayIndexContext* context) {
+        log_node("expression array index %s", context);
+        logger.push();
+
+        std::string identifier = context->ID()->getText();
+        Type type = emit_push_array(context, identifier);
+
+        if (visit_expression(context->expression()) != Type::INT) {
+            panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+        }
+
+        emit({
+            is_in_bounds(identifier, context->expression()) ? OpType::PUSH_INDEX_UNCHECKED : OpType::PUSH_INDEX,
+            ByteCodeIndexOp { array_element_type(type) }
+        });
+
+        logger.pop();
+
+        return array_element_type(type);
+    }
+
+    std::any visitExpressionArrayLength(SimpleLangParser::ExpressionArrayLengthContext* context) {
+        log_node("expression array length %s", context);
+        logger.push();
+
+        if (!is_array_type(visit_expression(context->expression()))) {
+            panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+        }
+
+        emit(OpType::ARRAY_LENGTH);
+
+        logger.pop();
+
+        return Type::INT;
+    }
+
+    std::any visitExpressionVectorConstructor(SimpleLangParser::ExpressionVectorConstructorContext* context) {
+        log_node("expression vector constructor %s", context);
+        logger.push();
+
+        Type type = type_from_string(context->op->getText());
+        std::vector<Type> lane_types = visit_expression_list(context->expressionList());
+
+        if (lane_types.size() != vector_width(type)) {
+            panic(context, CompilationErrorType::FUNCTION_CALLED_WITH_WRONG_NUMBER_OF_ARGS, {});
+        }
+
+        for (Type lane_type : lane_types) {
+            if (lane_type != vector_lane_type(type)) {
+                panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+            }
+        }
+
+        emit({
+            OpType::MAKE_VECTOR,
+            ByteCodeVectorOp { type, {}, 0 }
+        });
+
+        logger.pop();
+
+        return type;
+    }
+
+    std::any visitExpressionVectorBuiltin(SimpleLangParser::ExpressionVectorBuiltinContext* context) {
+        log_node("expression vector builtin %s", context);
+        logger.push();
+
+        std::string name = context->op->getText();
+        std::vector<Type> argument_types = visit_expression_list(context->expressionList());
+        Type result_type = Type::VOID;
+
+        if (name == "dot") {
+            if (argument_types.size() != 2) {
+                panic(context, CompilationErrorType::FUNCTION_CALLED_WITH_WRONG_NUMBER_OF_ARGS, {});
+            }
+
+            if (!is_vector_type(argument_types.at(0)) || argument_types.at(0) != argument_types.at(1)) {
+                panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+            }
+
+            result_type = vector_lane_type(argument_types.at(0));
+            emit(is_int_vector_type(argument_types.at(0)) ? OpType::DOT_INT_VECTOR : OpType::DOT_FLOAT_VECTOR);
+        }
+
+        else {
+            if (argument_types.size() != 1) {
+                panic(context, CompilationErrorType::FUNCTION_CALLED_WITH_WRONG_NUMBER_OF_ARGS, {});
+            }
+
+            if (!is_float_vector_type(argument_types.at(0))) {
+                panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+            }
+
+            result_type = Type::FLOAT;
+            emit(OpType::LENGTH_FLOAT_VECTOR);
+        }
+
+        logger.pop();
+
+        return result_type;
+    }
+
+    std::any visitExpressionTypeInitializerList(SimpleLangParser::ExpressionTypeInitializerListContext* context) {
+        log_node("expression type initializer list %s", context);
+        logger.push();
+
+        std::optional<Type> type = gen.type_get(context->TYPE_ID()->getText());
+
+        if (!type.has_value()) {
+            panic(context, CompilationErrorType::IDENTIFIED_NOT_DECLARED, {});
+        }
+
+        const ObjectType& object = gen.type_get_object(type.value());
+        std::vector<SimpleLangParser::StatementVariableAssignmentContext*> assignments = context->statementVariableAssignment();
+
+        for (size_t i = 0; i < assignments.size(); i++) {
+            std::string field_name = assignments.at(i)->ID()->getText();
+
+            bool is_field = std::any_of(object.fields.begin(), object.fields.end(), 
+                [&](const Variable& field) {
+                    return field.name == field_name;
+                }
+            );
+
+            if (!is_field) {
+                panic(assignments.at(i), CompilationErrorType::IDENTIFIED_NOT_DECLARED, {});
+            }
+
+            for (size_t j = 0; j < i; j++) {
+                if (assignments.at(j)->ID()->getText() == field_name) {
+                    panic(assignments.at(i), CompilationErrorType::IDENTIFIED_ALREADY_DECLARED, {});
+                }
+            }
+        }
+
+        // Values are pushed in field order, fields left out get their default value
+        for (const Variable& field : object.fields) {
+            auto assignment = std::find_if(assignments.begin(), assignments.end(), 
+                [&](SimpleLangParser::StatementVariableAssignmentContext* a) {
+                    return a->ID()->getText() == field.name;
+                }
+            );
 
+            if (assignment == assignments.end()) {
+                emit_default_value(field.type);
+                continue;
+            }
+
+            Type field_type = visit_expression((*assignment)->expression());
+
+            if (field_type != field.type) {
+                panic(*assignment, CompilationErrorType::TYPE_MISMATCH, {});
+            }
+        }
+
+        logger.pop();
+
+        return type.value();
     }
 
     // Functions
 
     std::any visitFunctionDeclaration(SimpleLangParser::FunctionDeclarationContext* context) {
-        logger("declaration function %s", context->getText().c_str());
+        log_node("declaration function %s", context);
         logger.push();
 
         Type return_type = visit_type(context->type());
@@ -190,14 +841,13 @@ public:
             if (err != CompilationErrorType::NONE) {
                 panic(context, err, {});
             }
+        }
 
-            emit({
-                OpType::STORE_VARIABLE,
-                ByteCodeStoreVariableOp {
-                    variable.type,
-                    variable.name
-                }
-            });
+        gen.set_source_line(context->start->getLine());
+
+        // The last argument is on top of the stack
+        for (auto variable = arguments.rbegin(); variable != arguments.rend(); variable++) {
+            emit_store_variable(variable->type, variable->name);
         }
 
         if (err != CompilationErrorType::NONE) {
@@ -210,6 +860,7 @@ public:
             || gen.get_last_op_type() != OpType::RETURN) 
         {
             if (return_type == Type::VOID) {
+                gen.set_source_line(context->stop->getLine());
                 emit(OpType::RETURN);
             }
 
@@ -226,7 +877,7 @@ public:
     }
 
     std::any visitArgumentList(SimpleLangParser::ArgumentListContext* context) {
-        logger("argument list %s", context->getText().c_str());
+        log_node("argument list %s", context);
         logger.push();
 
         std::vector<Variable> arguments;
@@ -244,7 +895,7 @@ public:
     }
 
     std::any visitArgument(SimpleLangParser::ArgumentContext* context) {
-        logger("argument %s", context->getText().c_str());
+        log_node("argument %s", context);
         logger.push();
 
         Type type = visit_type(context->type());
@@ -256,7 +907,7 @@ public:
     }
 
     std::any visitBlock(SimpleLangParser::BlockContext* context) {
-        logger("block %s", context->getText().c_str());
+        log_node("block %s", context);
         logger.push();
         
         gen.scope_push(ScopeType::BLOCK);
@@ -271,20 +922,32 @@ public:
     // Statement
 
     std::any visitStatement(SimpleLangParser::StatementContext* context) {
-        logger("statement %s", context->getText().c_str());
+        log_node("statement %s", context);
         logger.push();
+
+        // Whatever an enclosing statement emits after this one, like a loop's jump
+        // back, belongs to the enclosing statement's line
+        size_t enclosing_line = gen.get_source_line();
+        gen.set_source_line(context->start->getLine());
+
         std::any out = visitChildren(context); 
+
+        gen.set_source_line(enclosing_line);
+
         logger.pop();
         return out;
     }
 
     std::any visitStatementExpression(SimpleLangParser::StatementExpressionContext* context) {
-        logger("statement expression %s", context->getText().c_str());
+        log_node("statement expression %s", context);
         logger.push();
 
-        visitChildren(context);
+        Type type = visit_expression(context->expressionCallFunction());
 
-        emit({ OpType::POP, {}});
+        // Drop whatever the call returned
+        for (size_t i = 0; i < gen.type_get_slot_count(type); i++) {
+            emit({ OpType::POP, {}});
+        }
 
         logger.pop();
 
@@ -292,7 +955,7 @@ public:
     }
 
     std::any visitStatementVariableDeclaration(SimpleLangParser::StatementVariableDeclarationContext* context) {
-        logger("statement variable declaration %s", context->getText().c_str());
+        log_node("statement variable declaration %s", context);
         logger.push();
 
         Type expression_type = visit_expression(context->expression());
@@ -311,13 +974,7 @@ public:
             panic(context, err, {});
         }
 
-        emit({
-            OpType::STORE_VARIABLE,
-            ByteCodeStoreVariableOp{
-                type,
-                identifier
-            }
-        });
+        emit_store_variable(type, identifier);
 
         logger.pop();
 
@@ -325,7 +982,7 @@ public:
     }
 
     std::any visitStatementVariableAssignment(SimpleLangParser::StatementVariableAssignmentContext* context) {
-        logger("expression variable assignment %s", context->getText().c_str());
+        log_node("expression variable assignment %s", context);
         logger.push();
 
         std::string identifier = context->ID()->getText();
@@ -336,8 +993,42 @@ public:
         
         Type type = visit_expression(context->expression());
 
+        std::optional<Type> variable_type = gen.variable_get_type(identifier);
+
+        if (variable_type.has_value() && variable_type.value() != type) {
+            panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+        }
+
+        emit_store_variable(type, identifier);
+
+        logger.pop();
+
+        return nullptr;
+    }
+
+    std::any visitStatementAppend(SimpleLangParser::StatementAppendContext* context) {
+        log_node("statement append %s", context);
+        logger.push();
+
+        std::string identifier = context->ID()->getText();
+
+        if (!gen.scope_is_identifier_declared(identifier)) {
+            panic(context, CompilationErrorType::IDENTIFIED_NOT_DECLARED, {});
+        }
+
+        if (gen.variable_get_type(identifier) != Type::STRING) {
+            panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+        }
+
+        // Numbers and bools are formatted as they are appended
+        Type type = visit_expression(context->expression());
+
+        if (type != Type::STRING && type != Type::BOOL && type != Type::INT && type != Type::FLOAT) {
+            panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+        }
+
         emit({
-            OpType::STORE_VARIABLE,
+            OpType::APPEND_VARIABLE,
             ByteCodeStoreVariableOp {
                 type,
                 identifier
@@ -350,7 +1041,7 @@ public:
     }
 
     std::any visitStatementReturn(SimpleLangParser::StatementReturnContext* context) {
-        logger("statement return %s", context->getText().c_str());
+        log_node("statement return %s", context);
         logger.push();
         
         Type type = Type::VOID;
@@ -377,7 +1068,7 @@ public:
     }
 
     std::any visitStatementIf(SimpleLangParser::StatementIfContext* context) {
-        logger("statement if %s", context->getText().c_str());
+        log_node("statement if %s", context);
         logger.push();
         
         Type type = visit_expression(context->expression());
@@ -405,7 +1096,7 @@ public:
     }
 
     std::any visitStatementWhile(SimpleLangParser::StatementWhileContext* context) {
-        logger("statement while %s", context->getText().c_str());
+        log_node("statement while %s", context);
         logger.push();
 
         size_t before_condition_code_index = gen.get_code_index();
@@ -420,8 +1111,18 @@ public:
 
         gen.emit_placeholder();
 
+        std::optional<std::pair<std::string, std::string>> in_bounds_index = find_in_bounds_index(context);
+
+        if (in_bounds_index.has_value()) {
+            in_bounds_indices.push_back(in_bounds_index.value());
+        }
+
         visit(context->block());
 
+        if (in_bounds_index.has_value()) {
+            in_bounds_indices.pop_back();
+        }
+
         gen.emit({
             OpType::JUMP,
             ByteCodeJumpOp { before_condition_code_index }
@@ -439,10 +1140,21 @@ public:
         return nullptr;
     }
     
+    std::any visitStatementYield(SimpleLangParser::StatementYieldContext* context) {
+        log_node("statement yield %s", context);
+        logger.push();
+
+        emit(OpType::YIELD);
+
+        logger.pop();
+
+        return nullptr;
+    }
+    
     // Expression
 
     std::any visitExpressionList(SimpleLangParser::ExpressionListContext* context) {
-        logger("expression list %s", context->getText().c_str());
+        log_node("expression list %s", context);
         logger.push();
 
         std::vector<Type> types;
@@ -457,7 +1169,7 @@ public:
     }
 
     std::any visitExpression(SimpleLangParser::ExpressionContext* context) {
-        logger("expression %s", context->getText().c_str());
+        log_node("expression %s", context);
         logger.push();
 
         Type out_expression_type = Type::VOID;
@@ -499,6 +1211,36 @@ public:
         else if (context->expressionCallFunction()) {
             out_expression_type = visit_expression(context->expressionCallFunction());
         }
+
+        // Struct field lookup
+        else if (context->expressionTypeVariableAccess()) {
+            out_expression_type = visit_expression(context->expressionTypeVariableAccess());
+        }
+
+        // Struct value
+        else if (context->expressionTypeInitializerList()) {
+            out_expression_type = visit_expression(context->expressionTypeInitializerList());
+        }
+
+        // Array element
+        else if (context->expressionArrayIndex()) {
+            out_expression_type = visit_expression(context->expressionArrayIndex());
+        }
+
+        // Array length
+        else if (context->expressionArrayLength()) {
+            out_expression_type = visit_expression(context->expressionArrayLength());
+        }
+
+        // Vector value
+        else if (context->expressionVectorConstructor()) {
+            out_expression_type = visit_expression(context->expressionVectorConstructor());
+        }
+
+        // Vector math
+        else if (context->expressionVectorBuiltin()) {
+            out_expression_type = visit_expression(context->expressionVectorBuiltin());
+        }
         
         // Function variable lookup
         else if (context->ID()) {
@@ -509,13 +1251,7 @@ public:
                 panic(context, CompilationErrorType::IDENTIFIED_NOT_DECLARED, {});
             }
 
-            emit({
-                OpType::PUSH_VARIABLE,
-                ByteCodePushVariableOp {
-                    variable_type.value(),
-                    identifier
-                }
-            });
+            emit_push_variable(variable_type.value(), identifier);
 
             out_expression_type = variable_type.value();
         }
@@ -535,7 +1271,7 @@ public:
     }
 
     std::any visitExpressionCallFunction(SimpleLangParser::ExpressionCallFunctionContext* context) {
-        logger("expression call function %s", context->getText().c_str());
+        log_node("expression call function %s", context);
         logger.push();
 
         std::string identifier = context->ID()->getText();
@@ -617,11 +1353,35 @@ public:
     }
 
     std::any visitType(SimpleLangParser::TypeContext* context) {
-        logger("type %s", context->getText().c_str());
+        log_node("type %s", context);
         logger.push();
 
         std::string typeString = context->getText();
-        Type type = type_from_string(typeString);
+        Type type = Type::VOID;
+
+        if (context->type()) {
+            Type element_type = visit_type(context->type());
+
+            if (!gen.type_is_array_element(element_type)) {
+                panic(context, CompilationErrorType::TYPE_MISMATCH, {});
+            }
+
+            type = array_type(element_type);
+        }
+
+        else if (context->TYPE_ID()) {
+            std::optional<Type> object_type = gen.type_get(typeString);
+
+            if (!object_type.has_value()) {
+                panic(context, CompilationErrorType::IDENTIFIED_NOT_DECLARED, {});
+            }
+
+            type = object_type.value();
+        }
+
+        else {
+            type = type_from_string(typeString);
+        }
 
         logger.pop();
 
@@ -629,8 +1389,10 @@ public:
     }
 };
 
-CompilationResults generate_byte_code(antlr4::tree::ParseTree* tree, const std::vector<ExternalFunction>& external_functions) {
+CompilationResults generate_byte_code(antlr4::tree::ParseTree* tree, const std::vector<ExternalFunction>& external_functions, CompilationStats* stats, bool trace) {
     BytecodeEmitter emitter;
+    emitter.stats = stats;
+    emitter.logger.set_enabled(trace);
 
     for (const ExternalFunction& external_function : external_functions) {
         CompilationErrorType err = emitter.gen.function_declare_external(external_function);
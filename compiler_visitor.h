@@ -4,4 +4,5 @@
 
 #include "antlr4-runtime.h"
 
-CompilationResults generate_byte_code(antlr4::tree::ParseTree* tree, const std::vector<ExternalFunction>& external_functions);
\ No newline at end of file
+// Trace prints every node the visitor goes through
+CompilationResults generate_byte_code(antlr4::tree::ParseTree* tree, const std::vector<ExternalFunction>& external_functions, CompilationStats* stats = nullptr, bool trace = true);
\ No newline at end of file
@@ -0,0 +1,1553 @@
+#include "engine.h"
+
+#include "byte_code_printer.h"
+#include "sampling_profiler.h"
+#include "execution_trace.h"
+#include "execution_log.h"
+#include "vector_math.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+static void push_variant(ByteStack& stack, Type type, const TypeVariant& variant) {
+    if (is_array_type(type)) {
+        stack.push_array(std::get<ArrayView>(variant));
+        return;
+    }
+
+    switch (type) {
+        case Type::STRING: {
+            stack.push_vm_string(std::get<VmString>(variant));
+            break;
+        }
+        case Type::BOOL: {
+            stack.push_bool(std::get<bool>(variant));
+            break;
+        }
+        case Type::INT: {
+            stack.push_int(std::get<int>(variant));
+            break;
+        }
+        case Type::FLOAT: {
+            stack.push_float(std::get<float>(variant));
+            break;
+        }
+        case Type::INT2:
+        case Type::INT4: {
+            stack.push_int_vector(std::get<IntVector>(variant));
+            break;
+        }
+        case Type::FLOAT2:
+        case Type::FLOAT3:
+        case Type::FLOAT4: {
+            stack.push_float_vector(std::get<FloatVector>(variant));
+            break;
+        }
+        default: {
+            exit(1);
+            break;
+        }
+    }
+}
+
+static std::pair<Type, TypeVariant> pop_variant(ByteStack& stack) {
+    Type type = stack.top_value_type();
+    TypeVariant value = {};
+
+    if (is_array_type(type)) {
+        value = stack.top_as_array();
+        stack.pop();
+        return { type, value };
+    }
+
+    switch (type) {
+        case Type::STRING: {
+            // External functions may keep their arguments past the fiber's arena
+            return { type, vm_string_detach(stack.pop_vm_string()) };
+        }
+        case Type::BOOL: {
+            value = stack.top_as_bool();
+            break;
+        }
+        case Type::INT: {
+            value = stack.top_as_int();
+            break;
+        }
+        case Type::FLOAT: {
+            value = stack.top_as_float();
+            break;
+        }
+        case Type::INT2:
+        case Type::INT4: {
+            value = stack.top_as_int_vector();
+            break;
+        }
+        case Type::FLOAT2:
+        case Type::FLOAT3:
+        case Type::FLOAT4: {
+            value = stack.top_as_float_vector();
+            break;
+        }
+        default: {
+            exit(1);
+            break;
+        }
+    }
+
+    stack.pop();
+
+    return { type, value };
+}
+
+// Values handed to the host may outlive the fiber's arena and memory
+static TypeVariant detach_variant(const TypeVariant& value) {
+    if (const VmString* string = std::get_if<VmString>(&value)) {
+        return vm_string_detach(*string);
+    }
+
+    return value;
+}
+
+static void store_slot(ByteStack& stack, VariableSlot& slot) {
+    Type type = stack.top_value_type();
+
+    if (is_array_type(type)) {
+        slot.value = stack.top_as_array();
+        slot.type = type;
+        stack.pop();
+        return;
+    }
+
+    switch (type) {
+        case Type::STRING: {
+            // The slot takes over the stack's reference to the buffer
+            slot.value = stack.pop_vm_string();
+            slot.type = type;
+            return;
+        }
+        case Type::BOOL: {
+            slot.value = stack.top_as_bool();
+            break;
+        }
+        case Type::INT: {
+            slot.value = stack.top_as_int();
+            break;
+        }
+        case Type::FLOAT: {
+            slot.value = stack.top_as_float();
+            break;
+        }
+        case Type::INT2:
+        case Type::INT4: {
+            slot.value = stack.top_as_int_vector();
+            break;
+        }
+        case Type::FLOAT2:
+        case Type::FLOAT3:
+        case Type::FLOAT4: {
+            slot.value = stack.top_as_float_vector();
+            break;
+        }
+        default: {
+            exit(1);
+            break;
+        }
+    }
+
+    slot.type = type;
+    stack.pop();
+}
+
+// Concatenations are built in the fiber's arena, they only go to the heap if they
+// are still held when the arena is released
+static void add_strings(ByteStack& stack, BumpArena& arena) {
+    std::string_view left = stack.top_as_string(1);
+    std::string_view right = stack.top_as_string(0);
+
+    VmString result;
+
+    if (left.size() + right.size() > 0) {
+        VmStringBuffer* buffer = vm_string_allocate(arena, left.size() + right.size());
+        vm_string_append(buffer, left);
+        vm_string_append(buffer, right);
+        result = VmString::adopt(buffer);
+    }
+
+    stack.pop(2);
+    stack.push_vm_string(std::move(result));
+}
+
+// Strings go in as they are, everything else is formatted into the scratch space
+static std::string_view format_appended_value(const ByteStack& stack, char (&scratch)[32]) {
+    switch (stack.top_value_type()) {
+        case Type::STRING: {
+            return stack.top_as_string();
+        }
+        case Type::BOOL: {
+            return stack.top_as_bool() ? "true" : "false";
+        }
+        case Type::INT: {
+            std::to_chars_result result = std::to_chars(scratch, scratch + sizeof(scratch), stack.top_as_int());
+            return std::string_view(scratch, result.ptr - scratch);
+        }
+        case Type::FLOAT: {
+            std::to_chars_result result = std::to_chars(scratch, scratch + sizeof(scratch), stack.top_as_float());
+            return std::string_view(scratch, result.ptr - scratch);
+        }
+        default: {
+            exit(1);
+        }
+    }
+}
+
+// A string variable that is the only holder of an arena string is appended to in
+// place, and grows to twice its size when it runs out of room, so building a string
+// one piece at a time costs a copy of each piece
+static void append_slot(ByteStack& stack, BumpArena& arena, VariableSlot& slot) {
+    char scratch[32];
+    std::string_view value = format_appended_value(stack, scratch);
+
+    VmString& target = std::get<VmString>(slot.value);
+    VmStringBuffer* buffer = target.get_buffer();
+    size_t length = target.size() + value.size();
+
+    bool in_place = target.is_in_arena() && target.use_count() == 1 && buffer->capacity >= length;
+
+    if (!in_place) {
+        buffer = vm_string_allocate(arena, std::max<size_t>(2 * length, 32));
+        vm_string_append(buffer, target.view());
+        target = VmString::adopt(buffer);
+    }
+
+    vm_string_append(buffer, value);
+    stack.pop();
+}
+
+// Vector operands pack the type, the lane count, then two bits for each lane
+static size_t pack_vector_operand(const ByteCodeVectorOp& op) {
+    size_t operand = static_cast<unsigned char>(op.type) | (op.lane_count << 8);
+
+    for (size_t i = 0; i < op.lane_count; i++) {
+        operand |= static_cast<size_t>(op.lanes[i]) << (16 + 2 * i);
+    }
+
+    return operand;
+}
+
+static Type get_vector_operand_type(size_t operand) {
+    return static_cast<Type>(operand & 0xFF);
+}
+
+static size_t get_vector_operand_lane_count(size_t operand) {
+    return (operand >> 8) & 0xFF;
+}
+
+static size_t get_vector_operand_lane(size_t operand, size_t index) {
+    return (operand >> (16 + 2 * index)) & 0x3;
+}
+
+// The lanes are pushed first to last, so the last one is on top
+static void make_vector(ByteStack& stack, size_t operand) {
+    Type type = get_vector_operand_type(operand);
+    size_t width = vector_width(type);
+
+    if (is_int_vector_type(type)) {
+        IntVector result{};
+        result.type = type;
+
+        for (size_t i = 0; i < width; i++) {
+            result.lanes[i] = stack.top_as_int(width - 1 - i);
+        }
+
+        stack.pop(width);
+        stack.push_int_vector(result);
+        return;
+    }
+
+    FloatVector result{};
+    result.type = type;
+
+    for (size_t i = 0; i < width; i++) {
+        result.lanes[i] = stack.top_as_float(width - 1 - i);
+    }
+
+    stack.pop(width);
+    stack.push_float_vector(result);
+}
+
+// Reads lanes into a new vector, or a scalar when there is only one
+template<typename Vector, typename Lane>
+static void swizzle_vector(ByteStack& stack, const Vector& source, size_t operand) {
+    size_t lane_count = get_vector_operand_lane_count(operand);
+
+    if (lane_count == 1) {
+        Lane lane = source.lanes[get_vector_operand_lane(operand, 0)];
+        stack.pop();
+        stack.push(lane);
+        return;
+    }
+
+    Vector result{};
+    result.type = get_vector_operand_type(operand);
+
+    for (size_t i = 0; i < lane_count; i++) {
+        result.lanes[i] = source.lanes[get_vector_operand_lane(operand, i)];
+    }
+
+    stack.pop();
+    stack.push(result);
+}
+
+// Writes the value on top into lanes of the vector under it
+template<typename Vector>
+static void insert_vector_lanes(Vector& target, const Vector& value, size_t operand) {
+    for (size_t i = 0; i < get_vector_operand_lane_count(operand); i++) {
+        target.lanes[get_vector_operand_lane(operand, i)] = value.lanes[i];
+    }
+}
+
+static void insert_vector(ByteStack& stack, size_t operand) {
+    Type type = get_vector_operand_type(operand);
+    bool is_scalar = get_vector_operand_lane_count(operand) == 1;
+    size_t first_lane = get_vector_operand_lane(operand, 0);
+
+    if (is_int_vector_type(type)) {
+        IntVector result = stack.top_as_int_vector(1);
+
+        if (is_scalar) {
+            result.lanes[first_lane] = stack.top_as_int(0);
+        }
+
+        else {
+            insert_vector_lanes(result, stack.top_as_int_vector(0), operand);
+        }
+
+        stack.pop(2);
+        stack.push_int_vector(result);
+        return;
+    }
+
+    FloatVector result = stack.top_as_float_vector(1);
+
+    if (is_scalar) {
+        result.lanes[first_lane] = stack.top_as_float(0);
+    }
+
+    else {
+        insert_vector_lanes(result, stack.top_as_float_vector(0), operand);
+    }
+
+    stack.pop(2);
+    stack.push_float_vector(result);
+}
+
+static char* get_array_element(const ArrayView& array, int index, size_t slot_count) {
+    return static_cast<char*>(array.data) + static_cast<size_t>(index) * slot_count * ARRAY_SLOT_SIZE;
+}
+
+static void check_array_index(const ArrayView& array, int index) {
+    if (index < 0 || index >= array.length) {
+        printf("Array index %d out of bounds for length %d\n", index, array.length);
+        exit(1);
+    }
+}
+
+Engine::Engine(const Program& program)
+    : m_program (program)
+{
+    std::unordered_map<std::string, size_t> global_slots;
+    std::vector<std::unordered_map<std::string, size_t>> local_slots(program.functions.size());
+    std::unordered_map<size_t, size_t> function_index_by_code_index;
+
+    for (size_t i = 0; i < static_cast<size_t>(Type::OBJECT); i++) {
+        m_scalar_slot_types.push_back({ static_cast<Type>(i) });
+    }
+
+    // Struct variables take one slot per flattened field, named "variable.field"
+    auto append_slot_names = [&](std::vector<std::string>& slot_names, const Variable& variable) {
+        if (!is_object_type(variable.type)) {
+            slot_names.push_back(variable.name);
+            return;
+        }
+
+        for (const std::string& field_name : program.object_types.at(object_type_index(variable.type)).slot_names) {
+            slot_names.push_back(variable.name + "." + field_name);
+        }
+    };
+
+    for (const Variable& variable : program.global_variables) {
+        if (global_slots.count(variable.name) > 0) {
+            continue;
+        }
+
+        global_slots[variable.name] = m_global_names.size();
+        append_slot_names(m_global_names, variable);
+    }
+
+    for (size_t i = 0; i < program.functions.size(); i++) {
+        const Function& function = program.functions.at(i);
+
+        EngineFunction engine_function{};
+        engine_function.code_index = function.code_index;
+
+        // Variables in sibling blocks can share a name, they share their slots as well.
+        // The compiler only allows that when they take the same number of slots.
+        for (const Variable& variable : function.local_variables) {
+            if (local_slots[i].count(variable.name) > 0) {
+                continue;
+            }
+
+            local_slots[i][variable.name] = engine_function.slot_names.size();
+            append_slot_names(engine_function.slot_names, variable);
+        }
+
+        engine_function.frame_size = engine_function.slot_names.size();
+
+        m_functions.push_back(engine_function);
+        function_index_by_code_index[function.code_index] = i;
+
+        if (function.name == "main") {
+            m_main_function_index = i;
+        }
+
+        std::optional<FunctionHandle> handle = program.resolve_function(function.name);
+        if (handle.has_value()) {
+            m_function_handles[function.name] = handle.value();
+        }
+    }
+
+    for (const ExternalFunction& function : program.external_functions) {
+        std::optional<FunctionHandle> handle = program.resolve_function(function.name);
+        if (handle.has_value()) {
+            m_function_handles[function.name] = handle.value();
+        }
+    }
+
+    // Functions are emitted one after another, so each owns the code up to the next one
+    std::vector<size_t> functions_by_code_index(program.functions.size());
+    for (size_t i = 0; i < functions_by_code_index.size(); i++) {
+        functions_by_code_index[i] = i;
+    }
+
+    std::sort(functions_by_code_index.begin(), functions_by_code_index.end(), 
+        [&](size_t a, size_t b) {
+            return program.functions.at(a).code_index < program.functions.at(b).code_index;
+        }
+    );
+
+    std::optional<size_t> owning_function;
+    size_t next_function = 0;
+
+    auto resolve_variable = [&](const std::string& identifier, OpType local_op, OpType global_op) -> EngineOp {
+        if (owning_function.has_value()) {
+            const auto& slots = local_slots.at(owning_function.value());
+            auto itr = slots.find(identifier);
+
+            if (itr != slots.end()) {
+                return { local_op, 0, itr->second };
+            }
+        }
+
+        auto itr = global_slots.find(identifier);
+        if (itr != global_slots.end()) {
+            return { global_op, 0, itr->second };
+        }
+
+        size_t slot = m_global_names.size();
+        global_slots[identifier] = slot;
+        m_global_names.push_back(identifier);
+
+        return { global_op, 0, slot };
+    };
+
+    for (size_t i = 0; i < program.operations.size(); i++) {
+        while (   next_function < functions_by_code_index.size() 
+               && program.functions.at(functions_by_code_index[next_function]).code_index <= i) 
+        {
+            owning_function = functions_by_code_index[next_function];
+            next_function++;
+        }
+
+        const ByteCodeOp& op = program.operations.at(i);
+        EngineOp engine_op { op.type, 0, 0 };
+
+        switch (op.type) {
+            case OpType::PUSH_LITERAL: {
+                const ByteCodePushLiteralOp& operand = std::get<ByteCodePushLiteralOp>(op.operand);
+                engine_op.operand = m_constants.size();
+                m_constants.push_back({ operand.type, operand.value });
+                break;
+            }
+            case OpType::PUSH_VARIABLE: {
+                const ByteCodePushVariableOp& operand = std::get<ByteCodePushVariableOp>(op.operand);
+                engine_op = resolve_variable(operand.identifier, OpType::PUSH_LOCAL, OpType::PUSH_GLOBAL);
+                break;
+            }
+            case OpType::STORE_VARIABLE: {
+                const ByteCodeStoreVariableOp& operand = std::get<ByteCodeStoreVariableOp>(op.operand);
+                engine_op = resolve_variable(operand.identifier, OpType::STORE_LOCAL, OpType::STORE_GLOBAL);
+                break;
+            }
+            case OpType::APPEND_VARIABLE: {
+                const ByteCodeStoreVariableOp& operand = std::get<ByteCodeStoreVariableOp>(op.operand);
+                engine_op = resolve_variable(operand.identifier, OpType::APPEND_LOCAL, OpType::APPEND_GLOBAL);
+                break;
+            }
+            case OpType::PUSH_FIELD: {
+                const ByteCodeFieldOp& operand = std::get<ByteCodeFieldOp>(op.operand);
+                engine_op = resolve_variable(operand.identifier, OpType::PUSH_LOCAL, OpType::PUSH_GLOBAL);
+                engine_op.operand += operand.offset;
+                break;
+            }
+            case OpType::STORE_FIELD: {
+                const ByteCodeFieldOp& operand = std::get<ByteCodeFieldOp>(op.operand);
+                engine_op = resolve_variable(operand.identifier, OpType::STORE_LOCAL, OpType::STORE_GLOBAL);
+                engine_op.operand += operand.offset;
+                break;
+            }
+            case OpType::PUSH_INDEX:
+            case OpType::STORE_INDEX:
+            case OpType::PUSH_INDEX_UNCHECKED:
+            case OpType::STORE_INDEX_UNCHECKED: {
+                const ByteCodeIndexOp& operand = std::get<ByteCodeIndexOp>(op.operand);
+                engine_op.operand = static_cast<size_t>(operand.element_type);
+                break;
+            }
+            case OpType::MAKE_VECTOR:
+            case OpType::VECTOR_SWIZZLE:
+            case OpType::VECTOR_INSERT: {
+                engine_op.operand = pack_vector_operand(std::get<ByteCodeVectorOp>(op.operand));
+                break;
+            }
+            case OpType::CALL_FUNCTION: {
+                const ByteCodeCallFunctionOp& operand = std::get<ByteCodeCallFunctionOp>(op.operand);
+                engine_op.operand = function_index_by_code_index.at(operand.code_index);
+                break;
+            }
+            case OpType::CALL_FUNCTION_EXTERNAL: {
+                const ByteCodeCallFunctionOp& operand = std::get<ByteCodeCallFunctionOp>(op.operand);
+                engine_op.operand = operand.code_index;
+                break;
+            }
+            case OpType::JUMP:
+            case OpType::JUMP_IF_FALSE: {
+                const ByteCodeJumpOp& operand = std::get<ByteCodeJumpOp>(op.operand);
+                engine_op.operand = operand.code_index;
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+
+        m_operations.push_back(engine_op);
+    }
+
+    decode_basic_blocks();
+}
+
+void Engine::decode_basic_blocks() {
+    // A block starts at every function, every jump target, and after every operation
+    // that can move the program counter somewhere other than the next operation
+    std::vector<bool> leaders(m_operations.size() + 1, false);
+    leaders[0] = true;
+
+    for (const EngineFunction& function : m_functions) {
+        leaders[function.code_index] = true;
+    }
+
+    for (size_t i = 0; i < m_operations.size(); i++) {
+        const EngineOp& op = m_operations[i];
+
+        switch (op.type) {
+            case OpType::JUMP:
+            case OpType::JUMP_IF_FALSE: {
+                leaders[op.operand] = true;
+                leaders[i + 1] = true;
+                break;
+            }
+            case OpType::CALL_FUNCTION:
+            case OpType::RETURN:
+            case OpType::YIELD: {
+                leaders[i + 1] = true;
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+    }
+
+    size_t block_start = 0;
+
+    for (size_t i = 1; i <= m_operations.size(); i++) {
+        if (!leaders[i]) {
+            continue;
+        }
+
+        m_operations[block_start].block_cost = static_cast<uint32_t>(i - block_start);
+        block_start = i;
+    }
+}
+
+const Program& Engine::get_program() const {
+    return m_program;
+}
+
+std::optional<FunctionHandle> Engine::resolve_function(const std::string& identifier) const {
+    auto itr = m_function_handles.find(identifier);
+    if (itr == m_function_handles.end()) {
+        return std::nullopt;
+    }
+
+    return itr->second;
+}
+
+Fiber Engine::create_fiber(std::pmr::memory_resource* memory) const {
+    Fiber fiber(memory);
+    reset(fiber);
+    return fiber;
+}
+
+void Engine::reset(Fiber& fiber) const {
+    if (!m_main_function_index.has_value()) {
+        fiber.stack.clear();
+        fiber.discard_arena();
+        fiber.call_stack.clear();
+        fiber.function_index = 0;
+        fiber.frame_base = 0;
+        fiber.frame_top = 0;
+        halt(fiber);
+        return;
+    }
+
+    FunctionHandle main_function{};
+    main_function.type = FunctionType::SCRIPT;
+    main_function.function_index = m_main_function_index.value();
+
+    reset(fiber, main_function);
+}
+
+void Engine::reset(Fiber& fiber, const FunctionHandle& function) const {
+    // Whatever the fiber was running ends here
+    halt(fiber);
+
+    fiber.stack.clear();
+    fiber.call_stack.clear();
+    fiber.globals.resize(m_global_names.size());
+
+    // Every variable is stored before it is read, so slots are not cleared, only
+    // the strings they hold from the last run's arena are dropped
+    fiber.discard_arena();
+
+    fiber.frame_base = 0;
+
+    if (function.type != FunctionType::SCRIPT) {
+        fiber.function_index = 0;
+        fiber.frame_top = 0;
+
+        if (fiber.trace_buffer) {
+            fiber.trace_buffer->write(TraceEventType::RUNTIME_ERROR, static_cast<uint32_t>(function.function_index));
+        }
+
+        return;
+    }
+
+    const EngineFunction& engine_function = m_functions.at(function.function_index);
+
+    fiber.function_index = function.function_index;
+    fiber.frame_top = engine_function.frame_size;
+
+    if (fiber.locals.size() < fiber.frame_top) {
+        fiber.locals.resize(fiber.frame_top);
+    }
+
+    fiber.program_counter = engine_function.code_index;
+    fiber.next_program_counter = fiber.program_counter;
+
+    if (fiber.sampled_call_stack) {
+        fiber.sampled_call_stack->reset(fiber.function_index);
+    }
+
+    if (fiber.trace_buffer) {
+        fiber.trace_buffer->write(TraceEventType::FUNCTION_ENTER, static_cast<uint32_t>(fiber.function_index));
+    }
+}
+
+ExecutionStatus Engine::execute(Fiber& fiber) const {
+    ExecutionStatus status = ExecutionStatus::COMPLETED;
+    begin_execution(fiber);
+
+    while (get_is_not_halted(fiber)) {
+        ExecutionStatus op_status = execute_op(fiber);
+
+        if (op_status != ExecutionStatus::RUNNING) {
+            status = op_status;
+            break;
+        }
+    }
+
+    end_execution(fiber);
+    return status;
+}
+
+ExecutionStatus Engine::resume(Fiber& fiber) const {
+    return execute(fiber);
+}
+
+ExecutionStatus Engine::execute_for(Fiber& fiber, size_t instruction_count) const {
+    ExecutionStatus status = ExecutionStatus::COMPLETED;
+    size_t fuel = instruction_count;
+    bool ran_block = false;
+
+    begin_execution(fiber);
+
+    while (get_is_not_halted(fiber)) {
+        // Fuel is only checked where a block starts, its operations then run without
+        // it. A fiber stopped partway through a block, by a step from a debugger,
+        // runs what's left of it one free operation at a time.
+        size_t cost = m_operations[fiber.program_counter].block_cost;
+
+        if (cost > fuel && ran_block) {
+            status = ExecutionStatus::OUT_OF_FUEL;
+            break;
+        }
+
+        fuel = cost > fuel ? 0 : fuel - cost;
+        ran_block = ran_block || cost > 0;
+
+        size_t op_count = cost > 0 ? cost : 1;
+        ExecutionStatus op_status = ExecutionStatus::RUNNING;
+
+        for (size_t i = 0; i < op_count && op_status == ExecutionStatus::RUNNING && get_is_not_halted(fiber); i++) {
+            op_status = execute_op(fiber);
+        }
+
+        if (op_status != ExecutionStatus::RUNNING) {
+            status = op_status;
+            break;
+        }
+    }
+
+    end_execution(fiber);
+    return status;
+}
+
+ExecutionStatus Engine::execute_until(Fiber& fiber, std::chrono::steady_clock::time_point deadline, size_t slice_instruction_count) const {
+    while (true) {
+        ExecutionStatus status = execute_for(fiber, slice_instruction_count);
+
+        if (status != ExecutionStatus::OUT_OF_FUEL) {
+            return status;
+        }
+
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return ExecutionStatus::OUT_OF_FUEL;
+        }
+    }
+}
+
+ExecutionStatus Engine::execute_op(Fiber& fiber) const {
+    if (fiber.op_hook) {
+        return execute_op_hooked(fiber);
+    }
+
+    fiber.next_program_counter = fiber.program_counter + 1;
+    ExecutionStatus status = execute_op_switch(fiber);
+    fiber.program_counter = fiber.next_program_counter;
+    return status;
+}
+
+ExecutionStatus Engine::execute_op_hooked(Fiber& fiber) const {
+    OpHook& hook = *fiber.op_hook;
+
+    size_t code_index = fiber.program_counter;
+    OpType type = m_operations[code_index].type;
+
+    hook.before_op(fiber, code_index, type);
+
+    fiber.next_program_counter = fiber.program_counter + 1;
+    ExecutionStatus status = execute_op_switch(fiber);
+    fiber.program_counter = fiber.next_program_counter;
+
+    hook.after_op(fiber, code_index, type);
+
+    return status;
+}
+
+void Engine::halt(Fiber& fiber) const {
+    if (fiber.trace_buffer) {
+        trace_exit_frames(fiber, m_operations.size());
+    }
+
+    fiber.program_counter = m_operations.size();
+    fiber.next_program_counter = m_operations.size();
+
+    if (fiber.sampled_call_stack) {
+        fiber.sampled_call_stack->clear();
+    }
+}
+
+void Engine::begin_execution(Fiber& fiber) const {
+    fiber.execution_depth++;
+
+    if (fiber.sampled_call_stack && fiber.execution_depth == 1) {
+        fiber.sampled_call_stack->set_running(true);
+    }
+}
+
+void Engine::end_execution(Fiber& fiber) const {
+    fiber.execution_depth--;
+
+    if (fiber.execution_depth > 0) {
+        return;
+    }
+
+    if (fiber.sampled_call_stack) {
+        fiber.sampled_call_stack->set_running(false);
+    }
+
+    // Each run from the host hands the arena back, unless it was made from inside
+    // another one. A fiber that yields keeps its strings in its memory instead.
+    fiber.release_arena();
+}
+
+ExecutionStatus Engine::invoke_function(Fiber& fiber, const FunctionHandle& function) const {
+    ExecutionStatus status = ExecutionStatus::COMPLETED;
+    begin_execution(fiber);
+
+    switch (function.type) {
+        case FunctionType::SCRIPT: {
+            // Run until the call frame pushed here is returned from, then put the
+            // program counter back so the host can keep driving the fiber
+            size_t return_program_counter = fiber.program_counter;
+            size_t call_depth = fiber.call_stack.size();
+
+            execute_op_call_function(fiber, function.function_index);
+            fiber.program_counter = fiber.next_program_counter;
+
+            // An external function may halt the fiber with the frames still pushed
+            while (fiber.call_stack.size() > call_depth && get_is_not_halted(fiber)) {
+                ExecutionStatus op_status = execute_op(fiber);
+
+                if (op_status != ExecutionStatus::RUNNING) {
+                    status = op_status;
+                    break;
+                }
+            }
+
+            if (fiber.call_stack.size() == call_depth) {
+                fiber.program_counter = return_program_counter;
+                fiber.next_program_counter = return_program_counter;
+            }
+
+            break;
+        }
+        case FunctionType::EXTERNAL: {
+            execute_op_call_external_function(fiber, function.function_index);
+            break;
+        }
+        default: {
+            halt(fiber);
+            break;
+        }
+    }
+
+    end_execution(fiber);
+    return status;
+}
+
+bool Engine::get_is_not_halted(const Fiber& fiber) const {
+    return fiber.program_counter < m_operations.size();
+}
+
+OpType Engine::patch_operation(size_t code_index, OpType type) {
+    OpType previous = m_operations.at(code_index).type;
+    m_operations[code_index].type = type;
+    return previous;
+}
+
+const std::vector<EngineOp>& Engine::get_operations() const {
+    return m_operations;
+}
+
+const VariableSlot& Engine::get_constant(size_t constant_index) const {
+    return m_constants.at(constant_index);
+}
+
+const EngineFunction& Engine::get_function(size_t function_index) const {
+    return m_functions.at(function_index);
+}
+
+const std::vector<std::string>& Engine::get_global_slot_names() const {
+    return m_global_names;
+}
+
+ByteCodeVmState Engine::get_state(const Fiber& fiber) const {
+    ByteCodeVmState state;
+    state.stack = fiber.stack;
+    state.stack.detach_strings();
+    state.program_counter = fiber.program_counter;
+
+    for (const CallFrame& frame : fiber.call_stack) {
+        state.call_stack.push_back(frame.return_code_index);
+    }
+
+    for (size_t i = 0; i < fiber.globals.size(); i++) {
+        const VariableSlot& slot = fiber.globals.at(i);
+
+        if (slot.type != Type::VOID) {
+            state.variables[m_global_names.at(i)] = { slot.type, detach_variant(slot.value) };
+        }
+    }
+
+    if (fiber.function_index < m_functions.size()) {
+        const EngineFunction& function = m_functions.at(fiber.function_index);
+
+        for (size_t i = 0; i < function.slot_names.size(); i++) {
+            size_t slot_index = fiber.frame_base + i;
+
+            if (slot_index >= fiber.locals.size()) {
+                break;
+            }
+
+            const VariableSlot& slot = fiber.locals.at(slot_index);
+
+            if (slot.type != Type::VOID) {
+                state.variables[function.slot_names.at(i)] = { slot.type, detach_variant(slot.value) };
+            }
+        }
+    }
+
+    return state;
+}
+
+void Engine::print(const Fiber& fiber) const {
+    printf("\033[2J\033[H");
+    m_program.print(fiber.program_counter);
+
+    printf("\nCall Stack:\n");
+    for (size_t i = 0; i < fiber.call_stack.size(); ++i) {
+        printf("  [%zu] -> %zu\n", i, fiber.call_stack[i].return_code_index);
+    }
+
+    printf("\nStack:\n");
+    fiber.stack.print();
+
+    printf("\nVariables:\n");
+    for (const auto& [name, pair] : get_state(fiber).variables) {
+        const Type& type = pair.first;
+        const TypeVariant& value = pair.second;
+
+        printf("  %s : ", name.c_str());
+        print_type_variant(type, value);
+        printf("\n");
+    }
+}
+
+ExecutionStatus Engine::execute_op_switch(Fiber& fiber) const {
+    const EngineOp& op = m_operations[fiber.program_counter];
+
+    switch (op.type) {
+        case OpType::PUSH_LITERAL: {
+            const VariableSlot& constant = m_constants[op.operand];
+            push_variant(fiber.stack, constant.type, constant.value);
+            break;
+        }
+
+        case OpType::PUSH_LOCAL: {
+            const VariableSlot& slot = fiber.locals[fiber.frame_base + op.operand];
+            push_variant(fiber.stack, slot.type, slot.value);
+            break;
+        }
+
+        case OpType::PUSH_GLOBAL: {
+            const VariableSlot& slot = fiber.globals[op.operand];
+            push_variant(fiber.stack, slot.type, slot.value);
+            break;
+        }
+
+        case OpType::STORE_LOCAL: {
+            store_slot(fiber.stack, fiber.locals[fiber.frame_base + op.operand]);
+            break;
+        }
+
+        case OpType::STORE_GLOBAL: {
+            store_slot(fiber.stack, fiber.globals[op.operand]);
+            break;
+        }
+
+        case OpType::APPEND_LOCAL: {
+            append_slot(fiber.stack, fiber.arena, fiber.locals[fiber.frame_base + op.operand]);
+            break;
+        }
+
+        case OpType::APPEND_GLOBAL: {
+            append_slot(fiber.stack, fiber.arena, fiber.globals[op.operand]);
+            break;
+        }
+
+        case OpType::POP: {
+            fiber.stack.pop();
+            break;
+        }
+
+        // Arrays, the index is on top with the array under it
+
+        case OpType::PUSH_INDEX: {
+            check_array_index(fiber.stack.top_as_array(1), fiber.stack.top_as_int(0));
+            execute_op_push_index(fiber, static_cast<Type>(op.operand));
+            break;
+        }
+
+        case OpType::STORE_INDEX: {
+            check_array_index(fiber.stack.top_as_array(1), fiber.stack.top_as_int(0));
+            execute_op_store_index(fiber, static_cast<Type>(op.operand));
+            break;
+        }
+
+        case OpType::PUSH_INDEX_UNCHECKED: {
+            execute_op_push_index(fiber, static_cast<Type>(op.operand));
+            break;
+        }
+
+        case OpType::STORE_INDEX_UNCHECKED: {
+            execute_op_store_index(fiber, static_cast<Type>(op.operand));
+            break;
+        }
+
+        case OpType::ARRAY_LENGTH: {
+            int result = fiber.stack.top_as_array().length;
+            fiber.stack.pop();
+            fiber.stack.push_int(result);
+            break;
+        }
+
+        case OpType::CALL_FUNCTION: {
+            execute_op_call_function(fiber, op.operand);
+            break;
+        }
+
+        case OpType::CALL_FUNCTION_EXTERNAL: {
+            execute_op_call_external_function(fiber, op.operand);
+            break;
+        }
+
+        case OpType::RETURN: {
+            if (fiber.sampled_call_stack) {
+                fiber.sampled_call_stack->pop();
+            }
+
+            if (fiber.trace_buffer) {
+                fiber.trace_buffer->write(TraceEventType::FUNCTION_EXIT, static_cast<uint32_t>(fiber.function_index));
+            }
+
+            if (fiber.call_stack.size() == 0) {
+                fiber.next_program_counter = m_operations.size();
+                break;
+            }
+
+            const CallFrame& frame = fiber.call_stack.back();
+            fiber.next_program_counter = frame.return_code_index + 1;
+            fiber.function_index = frame.function_index;
+            fiber.frame_top = fiber.frame_base;
+            fiber.frame_base = frame.frame_base;
+            fiber.call_stack.pop_back();
+            break;
+        }
+
+        case OpType::YIELD: {
+            if (fiber.trace_buffer) {
+                fiber.trace_buffer->write(TraceEventType::YIELD, static_cast<uint32_t>(fiber.function_index));
+            }
+
+            return ExecutionStatus::YIELDED;
+        }
+
+        case OpType::BREAKPOINT: {
+            fiber.next_program_counter = fiber.program_counter;
+            return ExecutionStatus::BREAKPOINT;
+        }
+
+        case OpType::JUMP: {
+            fiber.next_program_counter = op.operand;
+            break;
+        }
+
+        case OpType::JUMP_IF_FALSE: {
+            bool value = fiber.stack.top_as_bool();
+            fiber.stack.pop();
+            
+            if (!value) {
+                fiber.next_program_counter = op.operand;
+            }
+
+            break;
+        }
+
+        // Unary
+
+        case OpType::NOT_BOOL: {
+            bool result = !fiber.stack.top_as_bool();
+            fiber.stack.pop();
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::NEGATE_INT: {
+            int result = -fiber.stack.top_as_int();
+            fiber.stack.pop();
+            fiber.stack.push_int(result);
+            break;
+        }
+        case OpType::NEGATE_FLOAT: {
+            float result = -fiber.stack.top_as_float();
+            fiber.stack.pop();
+            fiber.stack.push_float(result);
+            break;
+        }
+
+        // Binary
+
+        case OpType::ADD_INT: {
+            int result = fiber.stack.top_as_int(1) + fiber.stack.top_as_int(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_int(result);
+            break;
+        }
+        case OpType::ADD_FLOAT: {
+            float result = fiber.stack.top_as_float(1) + fiber.stack.top_as_float(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_float(result);
+            break;
+        }
+        case OpType::ADD_STRING: {
+            add_strings(fiber.stack, fiber.arena);
+            break;
+        }
+        case OpType::SUBTRACT_INT: {
+            int result = fiber.stack.top_as_int(1) - fiber.stack.top_as_int(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_int(result);
+            break;
+        }
+        case OpType::SUBTRACT_FLOAT: {
+            float result = fiber.stack.top_as_float(1) - fiber.stack.top_as_float(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_float(result);
+            break;
+        }
+        case OpType::MULTIPLY_INT: {
+            int result = fiber.stack.top_as_int(1) * fiber.stack.top_as_int(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_int(result);
+            break;
+        }
+        case OpType::MULTIPLY_FLOAT: {
+            float result = fiber.stack.top_as_float(1) * fiber.stack.top_as_float(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_float(result);
+            break;
+        }
+        case OpType::DIVIDE_INT: {
+            int result = fiber.stack.top_as_int(1) / fiber.stack.top_as_int(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_int(result);
+            break;
+        }
+        case OpType::DIVIDE_FLOAT: {
+            float result = fiber.stack.top_as_float(1) / fiber.stack.top_as_float(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_float(result);
+            break;
+        }
+
+        // Comparisons
+
+        case OpType::EQUALS_STRING: {
+            bool result = fiber.stack.top_as_string(1) == fiber.stack.top_as_string(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::EQUALS_BOOL: {
+            bool result = fiber.stack.top_as_bool(1) == fiber.stack.top_as_bool(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::EQUALS_INT: {
+            bool result = fiber.stack.top_as_int(1) == fiber.stack.top_as_int(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::EQUALS_FLOAT: {
+            bool result = fiber.stack.top_as_float(1) == fiber.stack.top_as_float(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::NOT_EQUALS_STRING: {
+            bool result = fiber.stack.top_as_string(1) != fiber.stack.top_as_string(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::NOT_EQUALS_BOOL: {
+            bool result = fiber.stack.top_as_bool(1) != fiber.stack.top_as_bool(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::NOT_EQUALS_INT: {
+            bool result = fiber.stack.top_as_int(1) != fiber.stack.top_as_int(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::NOT_EQUALS_FLOAT: {
+            bool result = fiber.stack.top_as_float(1) != fiber.stack.top_as_float(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::LESS_THAN_INT: {
+            bool result = fiber.stack.top_as_int(1) < fiber.stack.top_as_int(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::LESS_THAN_FLOAT: {
+            bool result = fiber.stack.top_as_float(1) < fiber.stack.top_as_float(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::GREATER_THAN_INT: {
+            bool result = fiber.stack.top_as_int(1) > fiber.stack.top_as_int(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::GREATER_THAN_FLOAT: {
+            bool result = fiber.stack.top_as_float(1) > fiber.stack.top_as_float(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::LESS_THAN_EQUALS_INT: {
+            bool result = fiber.stack.top_as_int(1) <= fiber.stack.top_as_int(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::LESS_THAN_EQUALS_FLOAT: {
+            bool result = fiber.stack.top_as_float(1) <= fiber.stack.top_as_float(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::GREATER_THAN_EQUALS_INT: {
+            bool result = fiber.stack.top_as_int(1) >= fiber.stack.top_as_int(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::GREATER_THAN_EQUALS_FLOAT: {
+            bool result = fiber.stack.top_as_float(1) >= fiber.stack.top_as_float(0);
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+
+        // Vectors
+
+        case OpType::MAKE_VECTOR: {
+            make_vector(fiber.stack, op.operand);
+            break;
+        }
+        case OpType::VECTOR_SWIZZLE: {
+            if (is_int_vector_type(fiber.stack.top_value_type())) {
+                swizzle_vector<IntVector, int>(fiber.stack, fiber.stack.top_as_int_vector(), op.operand);
+            }
+
+            else {
+                swizzle_vector<FloatVector, float>(fiber.stack, fiber.stack.top_as_float_vector(), op.operand);
+            }
+
+            break;
+        }
+        case OpType::VECTOR_INSERT: {
+            insert_vector(fiber.stack, op.operand);
+            break;
+        }
+        case OpType::NEGATE_INT_VECTOR: {
+            IntVector result = vector_negate(fiber.stack.top_as_int_vector());
+            fiber.stack.pop();
+            fiber.stack.push_int_vector(result);
+            break;
+        }
+        case OpType::NEGATE_FLOAT_VECTOR: {
+            FloatVector result = vector_negate(fiber.stack.top_as_float_vector());
+            fiber.stack.pop();
+            fiber.stack.push_float_vector(result);
+            break;
+        }
+        case OpType::ADD_INT_VECTOR: {
+            IntVector result = vector_add(fiber.stack.top_as_int_vector(1), fiber.stack.top_as_int_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_int_vector(result);
+            break;
+        }
+        case OpType::ADD_FLOAT_VECTOR: {
+            FloatVector result = vector_add(fiber.stack.top_as_float_vector(1), fiber.stack.top_as_float_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_float_vector(result);
+            break;
+        }
+        case OpType::SUBTRACT_INT_VECTOR: {
+            IntVector result = vector_subtract(fiber.stack.top_as_int_vector(1), fiber.stack.top_as_int_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_int_vector(result);
+            break;
+        }
+        case OpType::SUBTRACT_FLOAT_VECTOR: {
+            FloatVector result = vector_subtract(fiber.stack.top_as_float_vector(1), fiber.stack.top_as_float_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_float_vector(result);
+            break;
+        }
+        case OpType::MULTIPLY_INT_VECTOR: {
+            IntVector result = vector_multiply(fiber.stack.top_as_int_vector(1), fiber.stack.top_as_int_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_int_vector(result);
+            break;
+        }
+        case OpType::MULTIPLY_FLOAT_VECTOR: {
+            FloatVector result = vector_multiply(fiber.stack.top_as_float_vector(1), fiber.stack.top_as_float_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_float_vector(result);
+            break;
+        }
+        case OpType::DIVIDE_INT_VECTOR: {
+            IntVector result = vector_divide(fiber.stack.top_as_int_vector(1), fiber.stack.top_as_int_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_int_vector(result);
+            break;
+        }
+        case OpType::DIVIDE_FLOAT_VECTOR: {
+            FloatVector result = vector_divide(fiber.stack.top_as_float_vector(1), fiber.stack.top_as_float_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_float_vector(result);
+            break;
+        }
+        case OpType::MULTIPLY_INT_VECTOR_SCALAR: {
+            IntVector result = vector_multiply(fiber.stack.top_as_int_vector(1), fiber.stack.top_as_int(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_int_vector(result);
+            break;
+        }
+        case OpType::MULTIPLY_FLOAT_VECTOR_SCALAR: {
+            FloatVector result = vector_multiply(fiber.stack.top_as_float_vector(1), fiber.stack.top_as_float(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_float_vector(result);
+            break;
+        }
+        case OpType::DIVIDE_FLOAT_VECTOR_SCALAR: {
+            FloatVector result = vector_divide(fiber.stack.top_as_float_vector(1), fiber.stack.top_as_float(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_float_vector(result);
+            break;
+        }
+        case OpType::EQUALS_INT_VECTOR: {
+            bool result = vector_equals(fiber.stack.top_as_int_vector(1), fiber.stack.top_as_int_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::EQUALS_FLOAT_VECTOR: {
+            bool result = vector_equals(fiber.stack.top_as_float_vector(1), fiber.stack.top_as_float_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::NOT_EQUALS_INT_VECTOR: {
+            bool result = !vector_equals(fiber.stack.top_as_int_vector(1), fiber.stack.top_as_int_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::NOT_EQUALS_FLOAT_VECTOR: {
+            bool result = !vector_equals(fiber.stack.top_as_float_vector(1), fiber.stack.top_as_float_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_bool(result);
+            break;
+        }
+        case OpType::DOT_INT_VECTOR: {
+            int result = vector_dot(fiber.stack.top_as_int_vector(1), fiber.stack.top_as_int_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_int(result);
+            break;
+        }
+        case OpType::DOT_FLOAT_VECTOR: {
+            float result = vector_dot(fiber.stack.top_as_float_vector(1), fiber.stack.top_as_float_vector(0));
+            fiber.stack.pop(2);
+            fiber.stack.push_float(result);
+            break;
+        }
+        case OpType::LENGTH_FLOAT_VECTOR: {
+            float result = vector_length(fiber.stack.top_as_float_vector());
+            fiber.stack.pop();
+            fiber.stack.push_float(result);
+            break;
+        }
+        default: {
+            exit(1);
+        }
+    }
+
+    return ExecutionStatus::RUNNING;
+}
+
+const std::vector<Type>& Engine::get_element_slot_types(Type element_type) const {
+    if (is_object_type(element_type)) {
+        return m_program.object_types[object_type_index(element_type)].slot_types;
+    }
+
+    return m_scalar_slot_types[static_cast<size_t>(element_type)];
+}
+
+void Engine::execute_op_push_index(Fiber& fiber, Type element_type) const {
+    const std::vector<Type>& slot_types = get_element_slot_types(element_type);
+
+    int index = fiber.stack.top_as_int(0);
+    ArrayView array = fiber.stack.top_as_array(1);
+    fiber.stack.pop(2);
+
+    const char* element = get_array_element(array, index, slot_types.size());
+
+    for (size_t i = 0; i < slot_types.size(); i++) {
+        const char* slot = element + i * ARRAY_SLOT_SIZE;
+
+        if (slot_types[i] == Type::FLOAT) {
+            float value;
+            std::memcpy(&value, slot, sizeof(value));
+            fiber.stack.push_float(value);
+        }
+
+        else {
+            int value;
+            std::memcpy(&value, slot, sizeof(value));
+            fiber.stack.push_int(value);
+        }
+    }
+}
+
+void Engine::execute_op_store_index(Fiber& fiber, Type element_type) const {
+    const std::vector<Type>& slot_types = get_element_slot_types(element_type);
+
+    int index = fiber.stack.top_as_int(0);
+    ArrayView array = fiber.stack.top_as_array(1);
+    fiber.stack.pop(2);
+
+    char* element = get_array_element(array, index, slot_types.size());
+
+    // The value's last slot is on top
+    for (size_t i = slot_types.size(); i > 0; i--) {
+        char* slot = element + (i - 1) * ARRAY_SLOT_SIZE;
+
+        if (slot_types[i - 1] == Type::FLOAT) {
+            std::memcpy(slot, &fiber.stack.top_as_float(), sizeof(float));
+        }
+
+        else {
+            std::memcpy(slot, &fiber.stack.top_as_int(), sizeof(int));
+        }
+
+        fiber.stack.pop();
+    }
+}
+
+void Engine::execute_op_call_function(Fiber& fiber, size_t function_index) const {
+    const EngineFunction& function = m_functions[function_index];
+
+    fiber.call_stack.push_back({ fiber.program_counter, fiber.function_index, fiber.frame_base });
+
+    fiber.function_index = function_index;
+    fiber.frame_base = fiber.frame_top;
+    fiber.frame_top += function.frame_size;
+
+    if (fiber.locals.size() < fiber.frame_top) {
+        fiber.locals.resize(fiber.frame_top);
+    }
+
+    fiber.next_program_counter = function.code_index;
+
+    if (fiber.sampled_call_stack) {
+        fiber.sampled_call_stack->push(function_index);
+    }
+
+    if (fiber.trace_buffer) {
+        fiber.trace_buffer->write(TraceEventType::FUNCTION_ENTER, static_cast<uint32_t>(function_index));
+    }
+}
+
+void Engine::execute_op_call_external_function(Fiber& fiber, size_t function_index) const {
+    const ExternalFunction& function = m_program.external_functions[function_index];
+
+    if (fiber.trace_buffer) {
+        fiber.trace_buffer->write(TraceEventType::EXTERNAL_CALL_BEGIN, static_cast<uint32_t>(function_index));
+    }
+
+    if (fiber.execution_log && fiber.execution_log->is_replaying()) {
+        fiber.execution_log->replay_external_call(function_index, function, fiber.stack);
+    }
+
+    else if (fiber.external_gate && !function.thread_safe) {
+        fiber.external_gate->call(function, fiber.stack);
+    }
+
+    else {
+        call_external_function(function, fiber.stack);
+    }
+
+    if (fiber.execution_log && !fiber.execution_log->is_replaying()) {
+        fiber.execution_log->record_external_call(function_index, function, fiber.stack);
+    }
+
+    if (fiber.trace_buffer) {
+        fiber.trace_buffer->write(TraceEventType::EXTERNAL_CALL_END, static_cast<uint32_t>(function_index));
+    }
+
+    // A log that can't record or replay any further stops the fiber where it failed
+    if (fiber.execution_log && fiber.execution_log->get_error()) {
+        if (fiber.trace_buffer) {
+            fiber.trace_buffer->write(TraceEventType::RUNTIME_ERROR, static_cast<uint32_t>(fiber.function_index));
+        }
+
+        halt(fiber);
+    }
+}
+
+void call_external_function(const ExternalFunction& function, ByteStack& stack) {
+    if (function.trampoline) {
+        function.trampoline(stack, function.native);
+        return;
+    }
+
+    std::vector<TypeVariant> args;
+    for (size_t i = 0; i < function.arguments.size(); i++) {
+        auto [value_type, value] = pop_variant(stack);
+        args.push_back(value);
+    }
+
+    if (function.return_type == Type::VOID) {
+        function.proc(args);
+    }
+
+    else {
+        TypeVariant result = function.proc(args);
+        push_variant(stack, function.return_type, result);
+    }
+}
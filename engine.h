@@ -0,0 +1,138 @@
+#pragma once
+
+#include "fiber.h"
+#include "program.h"
+
+#include <unordered_map>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+
+// An operation with its operand resolved to an index: a constant, a variable slot,
+// a code index, or a function index depending on the type. The first operation of
+// each basic block carries the number of operations in the block, the rest carry 0.
+struct EngineOp {
+    OpType type;
+    uint32_t block_cost;
+    size_t operand;
+};
+
+// Pops the function's arguments off the stack, calls it, and pushes its result
+void call_external_function(const ExternalFunction& function, ByteStack& stack);
+
+struct EngineFunction {
+    size_t code_index;
+    size_t frame_size;
+    std::vector<std::string> slot_names;
+};
+
+// The program side of the vm. A program is decoded once into an Engine, which never
+// changes afterwards so any number of fibers can run on it from any number of threads.
+class Engine {
+public:
+    Engine(const Program& program);
+
+    const Program& get_program() const;
+
+    std::optional<FunctionHandle> resolve_function(const std::string& identifier) const;
+
+    // Fibers
+
+    Fiber create_fiber(std::pmr::memory_resource* memory = std::pmr::get_default_resource()) const;
+
+    // Puts the fiber back at the start of main, keeping the memory it has already allocated
+    void reset(Fiber& fiber) const;
+
+    // Puts the fiber at the start of a script function instead, it halts when that returns.
+    // The function's arguments are pushed afterwards.
+    void reset(Fiber& fiber, const FunctionHandle& function) const;
+
+    // Runs until the fiber halts or yields. A yielded fiber keeps its stack, frames and
+    // program counter, and picks up after the yield on the next call.
+    ExecutionStatus execute(Fiber& fiber) const;
+
+    ExecutionStatus resume(Fiber& fiber) const;
+
+    // Runs at most about instruction_count operations. Fuel is charged a whole basic
+    // block at a time, so the fiber stops with OUT_OF_FUEL at the start of the first
+    // block it can't pay for, and carries on from there on the next call. The first
+    // block is always run so a fiber makes progress with any amount of fuel.
+    ExecutionStatus execute_for(Fiber& fiber, size_t instruction_count) const;
+
+    // Runs in slices of fuel until the fiber halts, yields, or the deadline has passed
+    ExecutionStatus execute_until(Fiber& fiber, std::chrono::steady_clock::time_point deadline, size_t slice_instruction_count = 4096) const;
+
+    ExecutionStatus execute_op(Fiber& fiber) const;
+
+    void halt(Fiber& fiber) const;
+
+    // Calls a resolved function and runs it until it returns, leaving any return value
+    // on the fiber's stack. Stops early when the fiber halts, or with the status of a
+    // yield or breakpoint inside the call, which resume() carries on from.
+    ExecutionStatus invoke_function(Fiber& fiber, const FunctionHandle& function) const;
+
+    template<typename... Args>
+    ExecutionStatus call_function(Fiber& fiber, const FunctionHandle& function, const Args&... args) const {
+        (fiber.stack.push(args), ...);
+        return invoke_function(fiber, function);
+    }
+
+    bool get_is_not_halted(const Fiber& fiber) const;
+
+    // The decoded program, for executors that run it some other way than a fiber
+
+    const std::vector<EngineOp>& get_operations() const;
+
+    const VariableSlot& get_constant(size_t constant_index) const;
+
+    const EngineFunction& get_function(size_t function_index) const;
+
+    // Names of the global slots, struct fields as "variable.field"
+    const std::vector<std::string>& get_global_slot_names() const;
+
+    ByteCodeVmState get_state(const Fiber& fiber) const;
+
+    void print(const Fiber& fiber) const;
+
+private:
+    // Only the debugger patches operations, on its own copy of the engine that no other
+    // fiber runs on, since patching an engine that's shared races with its fibers
+    friend class ByteCodeVmDebugger;
+
+    // Swaps an operation for BREAKPOINT or back. Returns the type that was there before.
+    OpType patch_operation(size_t code_index, OpType type);
+
+    void decode_basic_blocks();
+
+    ExecutionStatus execute_op_switch(Fiber& fiber) const;
+
+    ExecutionStatus execute_op_hooked(Fiber& fiber) const;
+
+    // Every way of running a fiber starts and ends with these
+    void begin_execution(Fiber& fiber) const;
+
+    void end_execution(Fiber& fiber) const;
+
+    // Every array element is one scalar or a struct of them, these are the slots of one
+    const std::vector<Type>& get_element_slot_types(Type element_type) const;
+
+    void execute_op_push_index(Fiber& fiber, Type element_type) const;
+
+    void execute_op_store_index(Fiber& fiber, Type element_type) const;
+
+    void execute_op_call_function(Fiber& fiber, size_t function_index) const;
+
+    void execute_op_call_external_function(Fiber& fiber, size_t function_index) const;
+
+private:
+    const Program& m_program;
+
+    std::vector<EngineOp> m_operations;
+    std::vector<VariableSlot> m_constants;
+    std::vector<EngineFunction> m_functions;
+    std::vector<std::string> m_global_names;
+    std::vector<std::vector<Type>> m_scalar_slot_types;
+    std::unordered_map<std::string, FunctionHandle> m_function_handles;
+
+    std::optional<size_t> m_main_function_index;
+};
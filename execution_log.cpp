@@ -0,0 +1,392 @@
+#include "execution_log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+ExecutionLog::ExecutionLog(const Program& program)
+    : m_program (program)
+{}
+
+bool ExecutionLog::begin_recording(Fiber& fiber) {
+    m_data.clear();
+    m_arrays.clear();
+    m_read_offset = 0;
+    m_replaying = false;
+    m_error = nullptr;
+
+    size_t stack_item_count = fiber.stack.item_count();
+    write(static_cast<uint32_t>(stack_item_count));
+
+    for (size_t i = stack_item_count; i > 0; i--) {
+        write_stack_value(fiber.stack, i - 1);
+    }
+
+    write(static_cast<uint32_t>(fiber.globals.size()));
+
+    for (const VariableSlot& slot : fiber.globals) {
+        write_slot(slot);
+    }
+
+    if (m_error) {
+        m_data.clear();
+        return false;
+    }
+
+    fiber.execution_log = this;
+    return true;
+}
+
+bool ExecutionLog::begin_replay(Fiber& fiber) {
+    m_arrays.clear();
+    m_read_offset = 0;
+    m_replaying = true;
+    m_error = nullptr;
+
+    fiber.stack.clear();
+    uint32_t stack_size = read<uint32_t>();
+
+    for (uint32_t i = 0; i < stack_size; i++) {
+        read_stack_value(fiber.stack);
+    }
+
+    uint32_t global_count = read<uint32_t>();
+
+    if (global_count != fiber.globals.size()) {
+        fail("the log was recorded from a different program");
+        return false;
+    }
+
+    for (VariableSlot& slot : fiber.globals) {
+        read_slot(slot, fiber.memory);
+    }
+
+    if (m_error) {
+        return false;
+    }
+
+    fiber.execution_log = this;
+    return true;
+}
+
+void ExecutionLog::end(Fiber& fiber) {
+    if (fiber.execution_log == this) {
+        fiber.execution_log = nullptr;
+    }
+}
+
+bool ExecutionLog::is_replaying() const {
+    return m_replaying;
+}
+
+bool ExecutionLog::is_replay_finished() const {
+    return m_replaying && !m_error && m_read_offset == m_data.size();
+}
+
+const char* ExecutionLog::get_error() const {
+    return m_error;
+}
+
+void ExecutionLog::replay_external_call(size_t function_index, const ExternalFunction& function, ByteStack& stack) {
+    bool is_recorded = !m_error && m_read_offset < m_data.size() && read<uint32_t>() == function_index;
+    stack.pop(function.arguments.size());
+
+    if (!is_recorded) {
+        fail("the script called an external function that wasn't recorded");
+        return;
+    }
+
+    if (function.return_type != Type::VOID) {
+        read_stack_value(stack);
+    }
+}
+
+size_t ExecutionLog::get_size() const {
+    return m_data.size();
+}
+
+bool ExecutionLog::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    file.write("SLREPLAY", 8);
+    file.write(m_data.data(), m_data.size());
+
+    return file.good();
+}
+
+bool ExecutionLog::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[8];
+
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, "SLREPLAY", sizeof(magic)) != 0) {
+        return false;
+    }
+
+    m_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    m_arrays.clear();
+    m_read_offset = 0;
+    m_replaying = false;
+
+    return true;
+}
+
+void ExecutionLog::fail(const char* reason) {
+    if (!m_error) {
+        printf("Execution log failed: %s\n", reason);
+        m_error = reason;
+    }
+}
+
+void ExecutionLog::write_bytes(const void* data, size_t size) {
+    const char* ptr = static_cast<const char*>(data);
+    m_data.insert(m_data.end(), ptr, ptr + size);
+}
+
+void ExecutionLog::write_array(const ArrayView& array) {
+    write(array.element_type);
+    write(array.length);
+    write_bytes(array.data, array.length * get_element_size(array.element_type));
+}
+
+void ExecutionLog::write_stack_value(const ByteStack& stack, size_t item_index) {
+    Type type = stack.top_value_type(item_index);
+    write(type);
+
+    if (is_array_type(type)) {
+        write_array(stack.top_as_array(item_index));
+        return;
+    }
+
+    switch (type) {
+        case Type::STRING: {
+            std::string_view value = stack.top_as_string(item_index);
+            write(static_cast<uint32_t>(value.size()));
+            write_bytes(value.data(), value.size());
+            break;
+        }
+        case Type::BOOL: {
+            write(stack.top_as_bool(item_index));
+            break;
+        }
+        case Type::INT: {
+            write(stack.top_as_int(item_index));
+            break;
+        }
+        case Type::FLOAT: {
+            write(stack.top_as_float(item_index));
+            break;
+        }
+        case Type::INT2:
+        case Type::INT4: {
+            write(stack.top_as_int_vector(item_index));
+            break;
+        }
+        case Type::FLOAT2:
+        case Type::FLOAT3:
+        case Type::FLOAT4: {
+            write(stack.top_as_float_vector(item_index));
+            break;
+        }
+        default: {
+            fail("the stack holds a value the log can't hold");
+            break;
+        }
+    }
+}
+
+// Slots that were never stored to are written as VOID with nothing after
+void ExecutionLog::write_slot(const VariableSlot& slot) {
+    write(slot.type);
+
+    if (is_array_type(slot.type)) {
+        write_array(std::get<ArrayView>(slot.value));
+        return;
+    }
+
+    switch (slot.type) {
+        case Type::VOID: {
+            break;
+        }
+        case Type::STRING: {
+            std::string_view value = std::get<VmString>(slot.value).view();
+            write(static_cast<uint32_t>(value.size()));
+            write_bytes(value.data(), value.size());
+            break;
+        }
+        case Type::BOOL: {
+            write(std::get<bool>(slot.value));
+            break;
+        }
+        case Type::INT: {
+            write(std::get<int>(slot.value));
+            break;
+        }
+        case Type::FLOAT: {
+            write(std::get<float>(slot.value));
+            break;
+        }
+        case Type::INT2:
+        case Type::INT4: {
+            write(std::get<IntVector>(slot.value));
+            break;
+        }
+        case Type::FLOAT2:
+        case Type::FLOAT3:
+        case Type::FLOAT4: {
+            write(std::get<FloatVector>(slot.value));
+            break;
+        }
+        default: {
+            fail("a state variable holds a value the log can't hold");
+            break;
+        }
+    }
+}
+
+void ExecutionLog::read_bytes(void* data, size_t size) {
+    if (m_error) {
+        return;
+    }
+
+    if (size > m_data.size() - m_read_offset) {
+        fail("the log ended early");
+        return;
+    }
+
+    std::memcpy(data, m_data.data() + m_read_offset, size);
+    m_read_offset += size;
+}
+
+std::string_view ExecutionLog::read_string() {
+    uint32_t size = read<uint32_t>();
+
+    if (m_error) {
+        return {};
+    }
+
+    if (size > m_data.size() - m_read_offset) {
+        fail("the log ended early");
+        return {};
+    }
+
+    std::string_view value(m_data.data() + m_read_offset, size);
+    m_read_offset += size;
+
+    return value;
+}
+
+ArrayView ExecutionLog::read_array(Type element_type) {
+    int length = read<int>();
+    size_t size = length * get_element_size(element_type);
+
+    m_arrays.push_back(std::make_unique<char[]>(size));
+    read_bytes(m_arrays.back().get(), size);
+
+    return { element_type, m_arrays.back().get(), length };
+}
+
+void ExecutionLog::read_stack_value(ByteStack& stack) {
+    Type type = read<Type>();
+
+    if (is_array_type(type)) {
+        stack.push_array(read_array(read<Type>()));
+        return;
+    }
+
+    switch (type) {
+        case Type::STRING: {
+            stack.push_string(read_string());
+            break;
+        }
+        case Type::BOOL: {
+            stack.push_bool(read<bool>());
+            break;
+        }
+        case Type::INT: {
+            stack.push_int(read<int>());
+            break;
+        }
+        case Type::FLOAT: {
+            stack.push_float(read<float>());
+            break;
+        }
+        case Type::INT2:
+        case Type::INT4: {
+            stack.push_int_vector(read<IntVector>());
+            break;
+        }
+        case Type::FLOAT2:
+        case Type::FLOAT3:
+        case Type::FLOAT4: {
+            stack.push_float_vector(read<FloatVector>());
+            break;
+        }
+        default: {
+            fail("the log holds a value of an unknown type");
+            break;
+        }
+    }
+}
+
+void ExecutionLog::read_slot(VariableSlot& slot, std::pmr::memory_resource* memory) {
+    slot.type = read<Type>();
+
+    if (is_array_type(slot.type)) {
+        slot.value = read_array(read<Type>());
+        return;
+    }
+
+    switch (slot.type) {
+        case Type::VOID: {
+            slot.value = TypeVariant();
+            break;
+        }
+        case Type::STRING: {
+            slot.value = VmString(read_string(), memory);
+            break;
+        }
+        case Type::BOOL: {
+            slot.value = read<bool>();
+            break;
+        }
+        case Type::INT: {
+            slot.value = read<int>();
+            break;
+        }
+        case Type::FLOAT: {
+            slot.value = read<float>();
+            break;
+        }
+        case Type::INT2:
+        case Type::INT4: {
+            slot.value = read<IntVector>();
+            break;
+        }
+        case Type::FLOAT2:
+        case Type::FLOAT3:
+        case Type::FLOAT4: {
+            slot.value = read<FloatVector>();
+            break;
+        }
+        default: {
+            fail("the log holds a value of an unknown type");
+            slot.type = Type::VOID;
+            slot.value = TypeVariant();
+            break;
+        }
+    }
+}
+
+// Every element is one slot, or a struct's slots back to back
+size_t ExecutionLog::get_element_size(Type element_type) const {
+    size_t slot_count = is_object_type(element_type)
+        ? m_program.object_types.at(object_type_index(element_type)).slot_types.size()
+        : 1;
+
+    return slot_count * ARRAY_SLOT_SIZE;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "fiber.h"
+#include "program.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// What a fiber's run depends on from outside the script: the values on its stack when
+// it starts, which are main's arguments, its state variables, and the result of every
+// external function it calls. Replaying the log runs the script again exactly as it
+// ran, with the recorded results fed back in place of calling the host.
+//
+// The log starts with the stack's values from the bottom up and the state variables
+// by slot, then has each external call as its function index and result, every value
+// written as its type followed by its bytes. Arrays are written out element by element
+// and replayed from copies the log owns.
+//
+// A value the log can't hold, or a replay that goes differently from the recording,
+// fails the log rather than the host. The fiber is halted at the external call that
+// failed, with a RUNTIME_ERROR trace event, and get_error() says why.
+class ExecutionLog {
+public:
+    ExecutionLog(const Program& program);
+
+    // Logs what the fiber does from here on, dropping anything logged before. The
+    // fiber should be ready to run, with main's arguments already pushed. Returns
+    // false, without logging anything, when its state can't be logged.
+    bool begin_recording(Fiber& fiber);
+
+    // Puts the fiber's stack and state variables back to how they were when the
+    // recording began, and answers its external calls from the log from the start.
+    // Returns false, leaving the fiber unlogged, when the log doesn't fit the fiber.
+    bool begin_replay(Fiber& fiber);
+
+    // Stops the fiber recording or replaying, the fiber must not be running
+    void end(Fiber& fiber);
+
+    bool is_replaying() const;
+
+    // Every recorded call was replayed, and none of them failed
+    bool is_replay_finished() const;
+
+    // Why recording or replaying stopped, or nullptr while it's going fine
+    const char* get_error() const;
+
+    // Called after the external function has left its result on the stack
+    void record_external_call(size_t function_index, const ExternalFunction& function, const ByteStack& stack) {
+        if (m_error) {
+            return;
+        }
+
+        write(static_cast<uint32_t>(function_index));
+
+        if (function.return_type != Type::VOID) {
+            write_stack_value(stack, 0);
+        }
+    }
+
+    // Called in place of the external function, pops its arguments and pushes the
+    // recorded result. A run that calls something other than what was recorded
+    // can't be replayed any further, and fails the log.
+    void replay_external_call(size_t function_index, const ExternalFunction& function, ByteStack& stack);
+
+    size_t get_size() const;
+
+    bool save(const std::string& path) const;
+
+    bool load(const std::string& path);
+
+private:
+    // Keeps the first reason, the log stays failed until it begins again
+    void fail(const char* reason);
+
+    template<typename T>
+    void write(const T& value) {
+        const char* ptr = reinterpret_cast<const char*>(&value);
+        m_data.insert(m_data.end(), ptr, ptr + sizeof(T));
+    }
+
+    void write_bytes(const void* data, size_t size);
+
+    void write_array(const ArrayView& array);
+
+    void write_stack_value(const ByteStack& stack, size_t item_index);
+
+    void write_slot(const VariableSlot& slot);
+
+    // Reads zeroes once the log has failed
+    template<typename T>
+    T read() {
+        T value{};
+        read_bytes(&value, sizeof(T));
+        return value;
+    }
+
+    void read_bytes(void* data, size_t size);
+
+    std::string_view read_string();
+
+    ArrayView read_array(Type element_type);
+
+    void read_stack_value(ByteStack& stack);
+
+    void read_slot(VariableSlot& slot, std::pmr::memory_resource* memory);
+
+    size_t get_element_size(Type element_type) const;
+
+private:
+    const Program& m_program;
+
+    std::vector<char> m_data;
+    size_t m_read_offset = 0;
+    bool m_replaying = false;
+    const char* m_error = nullptr;
+
+    // The arrays replayed so far, which the fiber can hold on to until the log goes away
+    std::vector<std::unique_ptr<char[]>> m_arrays;
+};
@@ -0,0 +1,261 @@
+#include "execution_trace.h"
+
+#include "program.h"
+#include "byte_code_enum_translation.h"
+
+#include <algorithm>
+#include <cstdio>
+
+TraceBuffer::TraceBuffer(size_t capacity) {
+    size_t size = 1;
+
+    while (size < capacity) {
+        size *= 2;
+    }
+
+    m_events.resize(size);
+    m_mask = size - 1;
+}
+
+size_t TraceBuffer::read(TraceEvent* events, size_t max_count) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t count = std::min(m_head.load(std::memory_order_acquire) - tail, max_count);
+
+    for (size_t i = 0; i < count; i++) {
+        events[i] = m_events[(tail + i) & m_mask];
+    }
+
+    m_tail.store(tail + count, std::memory_order_release);
+    return count;
+}
+
+uint64_t TraceBuffer::get_dropped_count() const {
+    return m_dropped_count.load(std::memory_order_relaxed);
+}
+
+void Tracer::OpTracer::before_op(const Fiber& fiber, size_t code_index, OpType type) {
+    fiber.trace_buffer->write(TraceEventType::OP, static_cast<uint32_t>(code_index), static_cast<uint16_t>(type));
+}
+
+void Tracer::OpTracer::after_op(const Fiber&, size_t, OpType) {}
+
+Tracer::Tracer(const Program& program, const std::string& path, TraceFormat format, bool trace_ops, size_t buffer_capacity)
+    : m_program         (program)
+    , m_format          (format)
+    , m_trace_ops       (trace_ops)
+    , m_buffer_capacity (buffer_capacity)
+    , m_file            (path, std::ios::binary)
+    , m_start_timestamp (trace_timestamp())
+{
+    if (m_format == TraceFormat::BINARY) {
+        m_file.write("SLTRACE1", 8);
+    }
+
+    else {
+        m_file << "{\"traceEvents\":[\n";
+    }
+}
+
+Tracer::~Tracer() {
+    stop();
+}
+
+bool Tracer::is_open() const {
+    return m_file.is_open();
+}
+
+// The frames below the current one are the callers in the call stack. A call the host
+// made into a fiber that wasn't running has no caller to count.
+void trace_enter_frames(const Fiber& fiber, size_t operation_count) {
+    if (fiber.program_counter >= operation_count) {
+        return;
+    }
+
+    for (const CallFrame& frame : fiber.call_stack) {
+        if (frame.return_code_index < operation_count) {
+            fiber.trace_buffer->write(TraceEventType::FUNCTION_ENTER, static_cast<uint32_t>(frame.function_index));
+        }
+    }
+
+    fiber.trace_buffer->write(TraceEventType::FUNCTION_ENTER, static_cast<uint32_t>(fiber.function_index));
+}
+
+void trace_exit_frames(const Fiber& fiber, size_t operation_count) {
+    if (fiber.program_counter >= operation_count) {
+        return;
+    }
+
+    fiber.trace_buffer->write(TraceEventType::FUNCTION_EXIT, static_cast<uint32_t>(fiber.function_index));
+
+    for (size_t i = fiber.call_stack.size(); i > 0; i--) {
+        const CallFrame& frame = fiber.call_stack[i - 1];
+
+        if (frame.return_code_index < operation_count) {
+            fiber.trace_buffer->write(TraceEventType::FUNCTION_EXIT, static_cast<uint32_t>(frame.function_index));
+        }
+    }
+}
+
+void Tracer::attach(Fiber& fiber) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    AttachedFiber attached = { &fiber, m_next_fiber_id++, fiber.op_hook, std::make_unique<TraceBuffer>(m_buffer_capacity) };
+    fiber.trace_buffer = attached.buffer.get();
+
+    // A fiber attached part way through is shown entering what it is already inside
+    trace_enter_frames(fiber, m_program.operations.size());
+
+    if (m_trace_ops) {
+        fiber.op_hook = &m_op_tracer;
+    }
+
+    m_fibers.push_back(std::move(attached));
+}
+
+void Tracer::detach(Fiber& fiber) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (size_t i = 0; i < m_fibers.size(); i++) {
+        AttachedFiber& attached = m_fibers[i];
+
+        if (attached.fiber != &fiber) {
+            continue;
+        }
+
+        trace_exit_frames(fiber, m_program.operations.size());
+        fiber.trace_buffer = nullptr;
+
+        if (fiber.op_hook == &m_op_tracer) {
+            fiber.op_hook = attached.previous_op_hook;
+        }
+
+        drain(attached);
+        m_dropped_count += attached.buffer->get_dropped_count();
+        m_fibers.erase(m_fibers.begin() + i);
+        return;
+    }
+}
+
+void Tracer::start() {
+    if (m_thread.joinable()) {
+        return;
+    }
+
+    m_stopping = false;
+    m_thread = std::thread(&Tracer::drain_loop, this);
+}
+
+void Tracer::stop() {
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+
+        m_stop_requested.notify_one();
+        m_thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (AttachedFiber& attached : m_fibers) {
+        drain(attached);
+    }
+
+    if (!m_finished && m_format == TraceFormat::CHROME_JSON) {
+        m_file << "\n]}\n";
+    }
+
+    m_finished = true;
+    m_file.flush();
+}
+
+uint64_t Tracer::get_dropped_count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint64_t dropped_count = m_dropped_count;
+
+    for (const AttachedFiber& attached : m_fibers) {
+        dropped_count += attached.buffer->get_dropped_count();
+    }
+
+    return dropped_count;
+}
+
+void Tracer::drain_loop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_stopping) {
+        for (AttachedFiber& attached : m_fibers) {
+            drain(attached);
+        }
+
+        m_stop_requested.wait_for(lock, std::chrono::milliseconds(1), [this]() { return m_stopping; });
+    }
+}
+
+void Tracer::drain(AttachedFiber& attached) {
+    if (m_finished) {
+        return;
+    }
+
+    m_drained.resize(4096);
+
+    while (size_t count = attached.buffer->read(m_drained.data(), m_drained.size())) {
+        if (m_format == TraceFormat::BINARY) {
+            uint32_t header[2] = { attached.id, static_cast<uint32_t>(count) };
+            m_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+            m_file.write(reinterpret_cast<const char*>(m_drained.data()), count * sizeof(TraceEvent));
+            continue;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            write_event(attached.id, m_drained[i]);
+        }
+    }
+}
+
+void Tracer::write_event(uint32_t fiber_id, const TraceEvent& event) {
+    const char* phase = "i";
+    std::string_view name;
+
+    switch (event.type) {
+        case TraceEventType::FUNCTION_ENTER:
+        case TraceEventType::FUNCTION_EXIT:
+            phase = event.type == TraceEventType::FUNCTION_ENTER ? "B" : "E";
+            name = m_program.functions.at(event.value).name;
+            break;
+        case TraceEventType::EXTERNAL_CALL_BEGIN:
+        case TraceEventType::EXTERNAL_CALL_END:
+            phase = event.type == TraceEventType::EXTERNAL_CALL_BEGIN ? "B" : "E";
+            name = m_program.external_functions.at(event.value).name;
+            break;
+        case TraceEventType::YIELD:
+            name = "yield";
+            break;
+        case TraceEventType::RUNTIME_ERROR:
+            name = "error";
+            break;
+        case TraceEventType::OP:
+            name = op_type_to_string(static_cast<OpType>(event.op_type));
+            break;
+    }
+
+    if (!m_first_event) {
+        m_file << ",\n";
+    }
+
+    m_first_event = false;
+
+    char timestamp[32];
+    snprintf(timestamp, sizeof(timestamp), "%.3f", (event.timestamp - m_start_timestamp) / 1000.0);
+
+    m_file << "{\"name\":\"" << name << "\",\"ph\":\"" << phase << "\",\"ts\":" << timestamp
+        << ",\"pid\":1,\"tid\":" << fiber_id;
+
+    if (phase[0] == 'i') {
+        m_file << ",\"s\":\"t\",\"args\":{\"value\":" << event.value << "}";
+    }
+
+    m_file << "}";
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "fiber.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Program;
+
+enum class TraceEventType : uint8_t {
+    FUNCTION_ENTER,
+    FUNCTION_EXIT,
+    EXTERNAL_CALL_BEGIN,
+    EXTERNAL_CALL_END,
+    YIELD,
+    RUNTIME_ERROR,
+    OP,
+};
+
+// The value is the script function for enters, exits, yields and errors, the external
+// function for external calls and the instruction for ops
+struct TraceEvent {
+    uint64_t timestamp;
+    uint32_t value;
+    uint16_t op_type;
+    TraceEventType type;
+    uint8_t reserved;
+};
+
+static_assert(sizeof(TraceEvent) == 16);
+
+inline uint64_t trace_timestamp() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Events from one fiber on their way to the thread writing them out. Only the thread
+// running the fiber writes and only the tracer's thread reads, so neither waits for the
+// other. When the reader falls behind events are dropped rather than stalling the fiber.
+class TraceBuffer {
+public:
+    explicit TraceBuffer(size_t capacity);
+
+    void write(TraceEventType type, uint32_t value, uint16_t op_type = 0) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+
+        if (head - m_tail.load(std::memory_order_acquire) > m_mask) {
+            m_dropped_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        m_events[head & m_mask] = { trace_timestamp(), value, op_type, type, 0 };
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    // Takes up to max_count of the oldest events
+    size_t read(TraceEvent* events, size_t max_count);
+
+    uint64_t get_dropped_count() const;
+
+private:
+    std::vector<TraceEvent> m_events;
+    size_t m_mask;
+
+    // Kept on their own cache lines so the two threads don't fight over them
+    alignas(64) std::atomic<size_t> m_head = 0;
+    alignas(64) std::atomic<size_t> m_tail = 0;
+    alignas(64) std::atomic<uint64_t> m_dropped_count = 0;
+};
+
+// Writes enters for the script functions a fiber is inside, from the outermost in, or
+// exits for them from the innermost out. Nothing for a fiber that isn't running.
+void trace_enter_frames(const Fiber& fiber, size_t operation_count);
+
+void trace_exit_frames(const Fiber& fiber, size_t operation_count);
+
+enum class TraceFormat {
+    // "SLTRACE1" followed by chunks of a fiber number, an event count and the events
+    // as TraceEvent lays them out, names have to come from the program
+    BINARY,
+
+    // The trace event format chrome://tracing and Perfetto open
+    CHROME_JSON,
+};
+
+// Records what the fibers attached to it do, script function calls and returns,
+// external calls, yields and errors, and with trace_ops every operation as well. A
+// helper thread drains the fibers' buffers into the file while they run.
+class Tracer {
+public:
+    Tracer(const Program& program, const std::string& path, TraceFormat format, bool trace_ops = false, size_t buffer_capacity = 64 * 1024);
+
+    ~Tracer();
+
+    bool is_open() const;
+
+    // The fiber must not be running while it is attached or detached, and has to be
+    // detached before either of them goes away. Tracing every op takes the fiber's op
+    // hook while attached.
+    void attach(Fiber& fiber);
+
+    void detach(Fiber& fiber);
+
+    void start();
+
+    // Writes out everything still buffered and finishes the file
+    void stop();
+
+    uint64_t get_dropped_count() const;
+
+private:
+    // Puts the events of every op into the fiber's buffer
+    class OpTracer : public OpHook {
+    public:
+        void before_op(const Fiber& fiber, size_t code_index, OpType type) override;
+
+        void after_op(const Fiber& fiber, size_t code_index, OpType type) override;
+    };
+
+    struct AttachedFiber {
+        Fiber* fiber;
+        uint32_t id;
+        OpHook* previous_op_hook;
+        std::unique_ptr<TraceBuffer> buffer;
+    };
+
+    void drain_loop();
+
+    void drain(AttachedFiber& attached);
+
+    void write_event(uint32_t fiber_id, const TraceEvent& event);
+
+private:
+    const Program& m_program;
+    TraceFormat m_format;
+    bool m_trace_ops;
+    size_t m_buffer_capacity;
+
+    std::ofstream m_file;
+    uint64_t m_start_timestamp;
+    bool m_first_event = true;
+    bool m_finished = false;
+
+    OpTracer m_op_tracer;
+
+    std::thread m_thread;
+    bool m_stopping = false;
+    std::condition_variable m_stop_requested;
+
+    mutable std::mutex m_mutex;
+    std::vector<AttachedFiber> m_fibers;
+    uint32_t m_next_fiber_id = 0;
+    uint64_t m_dropped_count = 0;
+
+    std::vector<TraceEvent> m_drained;
+};
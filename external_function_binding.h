@@ -0,0 +1,146 @@
+#pragma once
+
+#include "program.h"
+#include "byte_stack.h"
+
+#include <string_view>
+#include <string>
+#include <utility>
+#include <type_traits>
+
+// Maps a C++ type onto the script type it binds to, and how to move it on and
+// off the stack. Strings are read as views into the stack, so they are only
+// valid for the duration of the call, a VmString keeps its buffer alive instead.
+
+template<typename T>
+struct NativeType;
+
+template<>
+struct NativeType<void> {
+    static constexpr Type type = Type::VOID;
+};
+
+template<>
+struct NativeType<std::string_view> {
+    static constexpr Type type = Type::STRING;
+
+    static std::string_view read(const ByteStack& stack, size_t item_index) {
+        return stack.top_as_string(item_index);
+    }
+
+    static void write(ByteStack& stack, std::string_view value) {
+        stack.push_string(value);
+    }
+};
+
+template<>
+struct NativeType<std::string> {
+    static constexpr Type type = Type::STRING;
+
+    static void write(ByteStack& stack, const std::string& value) {
+        stack.push_string(value);
+    }
+};
+
+// Shares the script's own buffer without a copy, for functions that keep or hand back
+// strings. Only strings in the fiber's arena are copied, into the vm's memory, so a
+// host that keeps one has to keep the vm alive as well, or vm_string_detach() it.
+template<>
+struct NativeType<VmString> {
+    static constexpr Type type = Type::STRING;
+
+    static VmString read(const ByteStack& stack, size_t item_index) {
+        return vm_string_detach_from_arena(stack.top_as_vm_string(item_index), stack.get_memory());
+    }
+
+    static void write(ByteStack& stack, const VmString& value) {
+        stack.push_vm_string(value);
+    }
+};
+
+template<>
+struct NativeType<bool> {
+    static constexpr Type type = Type::BOOL;
+
+    static bool read(const ByteStack& stack, size_t item_index) {
+        return stack.top_as_bool(item_index);
+    }
+
+    static void write(ByteStack& stack, bool value) {
+        stack.push_bool(value);
+    }
+};
+
+template<>
+struct NativeType<int> {
+    static constexpr Type type = Type::INT;
+
+    static int read(const ByteStack& stack, size_t item_index) {
+        return stack.top_as_int(item_index);
+    }
+
+    static void write(ByteStack& stack, int value) {
+        stack.push_int(value);
+    }
+};
+
+template<>
+struct NativeType<float> {
+    static constexpr Type type = Type::FLOAT;
+
+    static float read(const ByteStack& stack, size_t item_index) {
+        return stack.top_as_float(item_index);
+    }
+
+    static void write(ByteStack& stack, float value) {
+        stack.push_float(value);
+    }
+};
+
+template<typename T>
+using NativeTypeOf = NativeType<std::remove_cv_t<std::remove_reference_t<T>>>;
+
+template<typename R, typename... Args, size_t... I>
+R invoke_native(const ByteStack& stack, R(*native)(Args...), std::index_sequence<I...>) {
+    // Arguments were pushed in order, so the last one is on top
+    return native(NativeTypeOf<Args>::read(stack, sizeof...(Args) - 1 - I)...);
+}
+
+template<typename R, typename... Args>
+void external_function_trampoline(ByteStack& stack, void(*native)()) {
+    auto function = reinterpret_cast<R(*)(Args...)>(native);
+
+    if constexpr (std::is_void_v<R>) {
+        invoke_native(stack, function, std::index_sequence_for<Args...>{});
+        stack.pop(sizeof...(Args));
+    }
+
+    else {
+        // The result is pushed before the arguments are popped, since it may be a view
+        // into one of them
+        R result = invoke_native(stack, function, std::index_sequence_for<Args...>{});
+        NativeTypeOf<R>::write(stack, result);
+        stack.pop_under(sizeof...(Args));
+    }
+}
+
+// Builds an ExternalFunction whose signature comes from the C++ function type.
+// Captureless lambdas can be bound with a leading + to turn them into a function pointer.
+template<typename R, typename... Args>
+ExternalFunction bind_external(std::string name, R(*native)(Args...), bool thread_safe = false) {
+    ExternalFunction function{};
+    function.return_type = NativeTypeOf<R>::type;
+    function.name = std::move(name);
+
+    Type argument_types[] = { NativeTypeOf<Args>::type..., Type::VOID };
+
+    for (size_t i = 0; i < sizeof...(Args); i++) {
+        function.arguments.push_back({ argument_types[i], "arg" + std::to_string(i) });
+    }
+
+    function.trampoline = &external_function_trampoline<R, Args...>;
+    function.native = reinterpret_cast<void(*)()>(native);
+    function.thread_safe = thread_safe;
+
+    return function;
+}
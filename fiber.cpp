@@ -0,0 +1,112 @@
+#include "fiber.h"
+
+#include <algorithm>
+
+Fiber::Fiber()
+    : Fiber(std::pmr::get_default_resource())
+{}
+
+Fiber::Fiber(std::pmr::memory_resource* memory)
+    : memory     (memory)
+    , arena      (memory)
+    , stack      (memory)
+    , globals    (memory)
+    , locals     (memory)
+    , call_stack (memory)
+{}
+
+void Fiber::shrink_to_fit() {
+    stack.shrink_to_fit();
+
+    locals.resize(frame_top);
+    locals.shrink_to_fit();
+
+    call_stack.shrink_to_fit();
+
+    if (arena.is_empty()) {
+        arena.release();
+    }
+}
+
+// Keeps an arena string by copying it into memory, or forgets it
+static void detach_slots(VariableSlot* begin, VariableSlot* end, std::pmr::memory_resource* memory, bool keep) {
+    for (VariableSlot* slot = begin; slot != end; slot++) {
+        VmString* value = std::get_if<VmString>(&slot->value);
+
+        if (value && value->is_in_arena()) {
+            *value = keep ? vm_string_detach_from_arena(*value, memory) : VmString();
+        }
+    }
+}
+
+void Fiber::release_arena() {
+    if (arena.is_empty()) {
+        return;
+    }
+
+    stack.detach_arena_strings();
+
+    // Slots past the frame top belong to calls that have returned
+    size_t live_local_count = std::min(frame_top, locals.size());
+
+    detach_slots(globals.data(), globals.data() + globals.size(), memory, true);
+    detach_slots(locals.data(), locals.data() + live_local_count, memory, true);
+    detach_slots(locals.data() + live_local_count, locals.data() + locals.size(), memory, false);
+
+    arena.reset();
+}
+
+void Fiber::discard_arena() {
+    if (arena.is_empty()) {
+        return;
+    }
+
+    stack.detach_arena_strings();
+
+    detach_slots(globals.data(), globals.data() + globals.size(), memory, false);
+    detach_slots(locals.data(), locals.data() + locals.size(), memory, false);
+
+    arena.reset();
+}
+
+void Fiber::checkpoint(FiberCheckpoint& checkpoint) {
+    // The arena is reset between runs, so its strings can't be shared
+    release_arena();
+
+    size_t live_local_count = std::min(frame_top, locals.size());
+
+    checkpoint.stack = stack;
+    checkpoint.globals.assign(globals.begin(), globals.end());
+    checkpoint.locals.assign(locals.begin(), locals.begin() + live_local_count);
+    checkpoint.call_stack.assign(call_stack.begin(), call_stack.end());
+
+    checkpoint.program_counter = program_counter;
+    checkpoint.next_program_counter = next_program_counter;
+
+    checkpoint.function_index = function_index;
+    checkpoint.frame_base = frame_base;
+    checkpoint.frame_top = frame_top;
+}
+
+void Fiber::restore(const FiberCheckpoint& checkpoint) {
+    discard_arena();
+
+    stack = checkpoint.stack;
+    globals.assign(checkpoint.globals.begin(), checkpoint.globals.end());
+    call_stack.assign(checkpoint.call_stack.begin(), checkpoint.call_stack.end());
+
+    // Locals past the checkpoint's are left as they are, every variable is stored
+    // before it is read
+    if (locals.size() < checkpoint.locals.size()) {
+        locals.resize(checkpoint.locals.size());
+    }
+
+    std::copy(checkpoint.locals.begin(), checkpoint.locals.end(), locals.begin());
+
+    program_counter = checkpoint.program_counter;
+    next_program_counter = checkpoint.next_program_counter;
+
+    function_index = checkpoint.function_index;
+    frame_base = checkpoint.frame_base;
+    frame_top = checkpoint.frame_top;
+}
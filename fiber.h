@@ -0,0 +1,136 @@
+#pragma once
+
+#include "byte_stack.h"
+#include "byte_code_types.h"
+#include "bump_arena.h"
+
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+struct VariableSlot {
+    Type type = Type::VOID;
+    TypeVariant value;
+};
+
+struct ExternalFunction;
+struct Fiber;
+class SampledCallStack;
+class TraceBuffer;
+class ExecutionLog;
+
+// Lets whoever runs a fiber decide where its external functions that aren't
+// thread safe get called
+class ExternalCallGate {
+public:
+    virtual ~ExternalCallGate() = default;
+
+    virtual void call(const ExternalFunction& function, ByteStack& stack) = 0;
+};
+
+// Sees every operation a fiber runs, for profilers and other instrumentation. A fiber
+// without a hook only checks for one before each operation.
+class OpHook {
+public:
+    virtual ~OpHook() = default;
+
+    // The fiber's program counter is still at the operation
+    virtual void before_op(const Fiber& fiber, size_t code_index, OpType type) = 0;
+
+    // The fiber has moved on to whatever comes next, which may be another function
+    virtual void after_op(const Fiber& fiber, size_t code_index, OpType type) = 0;
+};
+
+struct CallFrame {
+    size_t return_code_index;
+    size_t function_index;
+    size_t frame_base;
+};
+
+// Where a fiber was at one point, to put it or other fibers on the same engine back
+// there. Only what the fiber is using is kept, and strings are shared with it rather
+// than copied, since a string is only ever changed in place while it has a single
+// reference. Taking a checkpoint into one that was used before reuses its memory.
+struct FiberCheckpoint {
+    ByteStack stack;
+    std::vector<VariableSlot> globals;
+    std::vector<VariableSlot> locals;
+    std::vector<CallFrame> call_stack;
+
+    size_t program_counter = 0;
+    size_t next_program_counter = 0;
+
+    size_t function_index = 0;
+    size_t frame_base = 0;
+    size_t frame_top = 0;
+};
+
+// Everything that changes while a program runs. Fibers are cheap to create and only
+// make sense together with the Engine they were created by, which holds the program.
+// All of a fiber's memory comes from the resource it was created with, which must
+// outlive it.
+struct Fiber {
+    Fiber();
+
+    explicit Fiber(std::pmr::memory_resource* memory);
+
+    std::pmr::memory_resource* memory;
+
+    // Strings built while running are allocated here and handed back all at once.
+    // It comes before the values so it outlives everything that can refer to it.
+    BumpArena arena;
+
+    ByteStack stack;
+    std::pmr::vector<VariableSlot> globals;
+    std::pmr::vector<VariableSlot> locals;
+    std::pmr::vector<CallFrame> call_stack;
+
+    size_t program_counter = 0;
+    size_t next_program_counter = 0;
+
+    size_t function_index = 0;
+    size_t frame_base = 0;
+    size_t frame_top = 0;
+
+    ExternalCallGate* external_gate = nullptr;
+
+    OpHook* op_hook = nullptr;
+
+    // Where the fiber publishes its call stack for a sampling profiler
+    SampledCallStack* sampled_call_stack = nullptr;
+
+    // Where the fiber writes its events for a tracer
+    TraceBuffer* trace_buffer = nullptr;
+
+    // Where the results of external calls are recorded, or replayed from instead of
+    // calling the host
+    ExecutionLog* execution_log = nullptr;
+
+    // How many runs on this fiber are in progress, a host call made from inside an
+    // external function runs inside another one
+    size_t execution_depth = 0;
+
+    // Frees whatever memory the fiber holds beyond what it is using right now, for
+    // fibers that stay suspended for a long time
+    void shrink_to_fit();
+
+    // Copies the arena strings the fiber still holds into its memory, then resets the arena
+    void release_arena();
+
+    // Drops the fiber's arena strings instead of keeping them, for when it starts over
+    void discard_arena();
+
+    // The fiber must not be running. Strings the checkpoint shares come from this
+    // fiber's memory, which has to outlive it and every fiber restored from it.
+    void checkpoint(FiberCheckpoint& checkpoint);
+
+    void restore(const FiberCheckpoint& checkpoint);
+};
+
+// A deep copy of a fiber with its variables named, used for inspecting results
+struct ByteCodeVmState {
+    ByteStack stack;
+    std::unordered_map<std::string, std::pair<Type, TypeVariant>> variables;
+    std::vector<size_t> call_stack;
+    size_t program_counter;
+};
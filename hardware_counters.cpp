@@ -0,0 +1,235 @@
+#include "hardware_counters.h"
+
+#include "engine.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+const char* hardware_event_to_string(HardwareEvent event) {
+    switch (event) {
+        case HardwareEvent::CYCLES: return "cycles";
+        case HardwareEvent::INSTRUCTIONS: return "instructions";
+        case HardwareEvent::BRANCHES: return "branches";
+        case HardwareEvent::BRANCH_MISSES: return "branch-misses";
+        case HardwareEvent::L1D_MISSES: return "L1d-misses";
+        case HardwareEvent::LLC_MISSES: return "LLC-misses";
+    }
+
+    return "unknown";
+}
+
+#if defined(__linux__)
+static int open_event(HardwareEvent event) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    auto cache_miss = [](uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+
+    switch (event) {
+        case HardwareEvent::CYCLES:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case HardwareEvent::INSTRUCTIONS:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case HardwareEvent::BRANCHES:
+            attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+            break;
+        case HardwareEvent::BRANCH_MISSES:
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case HardwareEvent::L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cache_miss(PERF_COUNT_HW_CACHE_L1D);
+            break;
+        case HardwareEvent::LLC_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cache_miss(PERF_COUNT_HW_CACHE_LL);
+            break;
+    }
+
+    // This thread on whichever cpu it runs
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+#endif
+
+HardwareCounters::HardwareCounters() {
+    m_fds.fill(-1);
+
+#if defined(__linux__)
+    for (size_t i = 0; i < HARDWARE_EVENT_COUNT; i++) {
+        m_fds[i] = open_event(static_cast<HardwareEvent>(i));
+    }
+#endif
+}
+
+HardwareCounters::~HardwareCounters() {
+#if defined(__linux__)
+    for (int fd : m_fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+bool HardwareCounters::is_available(HardwareEvent event) const {
+    return m_fds[static_cast<size_t>(event)] >= 0;
+}
+
+bool HardwareCounters::is_any_available() const {
+    return std::any_of(m_fds.begin(), m_fds.end(), [](int fd) { return fd >= 0; });
+}
+
+HardwareCounts HardwareCounters::read() const {
+    HardwareCounts counts;
+
+#if defined(__linux__)
+    for (size_t i = 0; i < HARDWARE_EVENT_COUNT; i++) {
+        // value, time enabled, time running
+        uint64_t values[3];
+
+        if (m_fds[i] < 0 || ::read(m_fds[i], values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+            continue;
+        }
+
+        counts.values[i] = values[2] < values[1]
+            ? static_cast<uint64_t>(static_cast<double>(values[0]) * values[1] / values[2])
+            : values[0];
+    }
+#endif
+
+    return counts;
+}
+
+HardwareCounterProfile::HardwareCounterProfile(const Engine& engine)
+    : m_program (engine.get_program())
+{
+    m_functions.resize(m_program.functions.size());
+}
+
+bool HardwareCounterProfile::is_available(HardwareEvent event) const {
+    return m_counters.is_available(event);
+}
+
+bool HardwareCounterProfile::is_any_available() const {
+    return m_counters.is_any_available();
+}
+
+void HardwareCounterProfile::clear() {
+    std::fill(m_functions.begin(), m_functions.end(), FunctionHardwareCounts{});
+    m_total = {};
+    m_total_invocation_count = 0;
+}
+
+void HardwareCounterProfile::begin(size_t function_index) {
+    m_invocations.push_back({ function_index, m_counters.read() });
+}
+
+void HardwareCounterProfile::end() {
+    HardwareCounts stop = m_counters.read();
+    const Invocation& invocation = m_invocations.back();
+
+    HardwareCounts counts;
+    for (size_t i = 0; i < HARDWARE_EVENT_COUNT; i++) {
+        counts.values[i] = stop.values[i] - invocation.start.values[i];
+    }
+
+    if (invocation.function_index < m_functions.size()) {
+        FunctionHardwareCounts& function = m_functions[invocation.function_index];
+        function.invocation_count++;
+
+        for (size_t i = 0; i < HARDWARE_EVENT_COUNT; i++) {
+            function.counts.values[i] += counts.values[i];
+        }
+    }
+
+    m_invocations.pop_back();
+
+    if (m_invocations.empty()) {
+        m_total_invocation_count++;
+
+        for (size_t i = 0; i < HARDWARE_EVENT_COUNT; i++) {
+            m_total.values[i] += counts.values[i];
+        }
+    }
+}
+
+const FunctionHardwareCounts& HardwareCounterProfile::get_function(size_t function_index) const {
+    return m_functions.at(function_index);
+}
+
+const HardwareCounts& HardwareCounterProfile::get_total() const {
+    return m_total;
+}
+
+static double get_ratio(uint64_t count, uint64_t total) {
+    return total > 0 ? static_cast<double>(count) / total : 0.0;
+}
+
+void HardwareCounterProfile::print() const {
+    if (!is_any_available()) {
+        printf("\nHardware counters: not available\n");
+        return;
+    }
+
+    printf("\nHardware counters:\n");
+    printf("%10s", "calls");
+
+    for (size_t i = 0; i < HARDWARE_EVENT_COUNT; i++) {
+        if (is_available(static_cast<HardwareEvent>(i))) {
+            printf(" %14s", hardware_event_to_string(static_cast<HardwareEvent>(i)));
+        }
+    }
+
+    printf(" %6s %8s  %s\n", "ipc", "miss %", "function");
+
+    auto print_counts = [&](uint64_t invocation_count, const HardwareCounts& counts, const char* name) {
+        printf("%10llu", static_cast<unsigned long long>(invocation_count));
+
+        for (size_t i = 0; i < HARDWARE_EVENT_COUNT; i++) {
+            if (is_available(static_cast<HardwareEvent>(i))) {
+                printf(" %14llu", static_cast<unsigned long long>(counts.values[i]));
+            }
+        }
+
+        // Instructions per cycle, and how many branches the cpu mispredicted
+        printf(" %6.2f %7.2f%%  %s\n",
+            get_ratio(counts.get(HardwareEvent::INSTRUCTIONS), counts.get(HardwareEvent::CYCLES)),
+            100.0 * get_ratio(counts.get(HardwareEvent::BRANCH_MISSES), counts.get(HardwareEvent::BRANCHES)),
+            name
+        );
+    };
+
+    std::vector<size_t> order;
+
+    for (size_t i = 0; i < m_functions.size(); i++) {
+        if (m_functions[i].invocation_count > 0) {
+            order.push_back(i);
+        }
+    }
+
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return m_functions[a].counts.get(HardwareEvent::CYCLES) > m_functions[b].counts.get(HardwareEvent::CYCLES);
+    });
+
+    for (size_t i : order) {
+        print_counts(m_functions[i].invocation_count, m_functions[i].counts, m_program.functions.at(i).name.c_str());
+    }
+
+    print_counts(m_total_invocation_count, m_total, "(total)");
+}
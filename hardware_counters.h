@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Program;
+class Engine;
+
+enum class HardwareEvent {
+    CYCLES,
+    INSTRUCTIONS,
+    BRANCHES,
+    BRANCH_MISSES,
+    L1D_MISSES,
+    LLC_MISSES,
+};
+
+constexpr size_t HARDWARE_EVENT_COUNT = 6;
+
+const char* hardware_event_to_string(HardwareEvent event);
+
+struct HardwareCounts {
+    std::array<uint64_t, HARDWARE_EVENT_COUNT> values = {};
+
+    uint64_t get(HardwareEvent event) const {
+        return values[static_cast<size_t>(event)];
+    }
+};
+
+// The cpu's performance counters for the thread that opened them, through
+// perf_event_open on Linux. Counters the cpu, kernel or its permissions don't allow
+// are left closed and read as 0, elsewhere none of them open.
+class HardwareCounters {
+public:
+    HardwareCounters();
+
+    HardwareCounters(const HardwareCounters&) = delete;
+
+    ~HardwareCounters();
+
+    HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+    bool is_available(HardwareEvent event) const;
+
+    bool is_any_available() const;
+
+    // What has been counted since the counters opened, scaled up for the time the
+    // kernel had to share the cpu's counters with others
+    HardwareCounts read() const;
+
+private:
+    std::array<int, HARDWARE_EVENT_COUNT> m_fds;
+};
+
+struct FunctionHardwareCounts {
+    uint64_t invocation_count = 0;
+    HardwareCounts counts;
+};
+
+// Adds up the hardware counts of each host invocation under the function it ran.
+// Counts are inclusive, everything the function called is counted with it, and an
+// invocation made from inside another one is counted for both.
+class HardwareCounterProfile {
+public:
+    HardwareCounterProfile(const Engine& engine);
+
+    bool is_available(HardwareEvent event) const;
+
+    bool is_any_available() const;
+
+    void clear();
+
+    void begin(size_t function_index);
+
+    void end();
+
+    const FunctionHardwareCounts& get_function(size_t function_index) const;
+
+    // Invocations started by the host, without the nested ones counted twice
+    const HardwareCounts& get_total() const;
+
+    void print() const;
+
+private:
+    struct Invocation {
+        size_t function_index;
+        HardwareCounts start;
+    };
+
+    const Program& m_program;
+    HardwareCounters m_counters;
+
+    std::vector<FunctionHardwareCounts> m_functions;
+    std::vector<Invocation> m_invocations;
+    HardwareCounts m_total;
+    uint64_t m_total_invocation_count = 0;
+};
+
+// Counts one invocation, or nothing for a null profile
+class HardwareCountScope {
+public:
+    HardwareCountScope(HardwareCounterProfile* profile, size_t function_index)
+        : m_profile (profile)
+    {
+        if (m_profile) {
+            m_profile->begin(function_index);
+        }
+    }
+
+    HardwareCountScope(const HardwareCountScope&) = delete;
+
+    ~HardwareCountScope() {
+        if (m_profile) {
+            m_profile->end();
+        }
+    }
+
+    HardwareCountScope& operator=(const HardwareCountScope&) = delete;
+
+private:
+    HardwareCounterProfile* m_profile;
+};
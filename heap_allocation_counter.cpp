@@ -0,0 +1,29 @@
+#include "heap_allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<size_t> s_heap_allocations = 0;
+
+void* operator new(size_t size) {
+    s_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* pointer = std::malloc(size > 0 ? size : 1)) {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+size_t get_heap_allocation_count() {
+    return s_heap_allocations.load(std::memory_order_relaxed);
+}
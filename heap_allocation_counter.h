@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+
+// How many times operator new has been called. Linking heap_allocation_counter.cpp
+// into an executable replaces the global operator new to count them, so it's kept out
+// of the core library and only tools that measure allocations take it.
+size_t get_heap_allocation_count();
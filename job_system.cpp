@@ -0,0 +1,205 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+JobSystem::MainThreadGate::MainThreadGate(JobSystem& jobs)
+    : m_jobs (jobs)
+{}
+
+void JobSystem::MainThreadGate::call(const ExternalFunction& function, ByteStack& stack) {
+    MainThreadCall call { &function, &stack, false };
+
+    std::unique_lock<std::mutex> lock(m_jobs.m_main_mutex);
+    m_jobs.m_main_calls.push_back(&call);
+    m_jobs.m_main_wakeup.notify_one();
+
+    m_jobs.m_main_calls_done.wait(lock, [&]() { 
+        return call.done; 
+    });
+}
+
+JobSystem::JobSystem(size_t worker_count) 
+    : m_batch_generation (0)
+    , m_stopping         (false)
+    , m_remaining_jobs   (0)
+    , m_main_thread_gate (*this)
+{
+    worker_count = std::max<size_t>(worker_count, 1);
+
+    for (size_t i = 0; i < worker_count; i++) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+
+    for (size_t i = 0; i < worker_count; i++) {
+        m_workers.at(i)->thread = std::thread(&JobSystem::worker_loop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_work_mutex);
+        m_stopping = true;
+    }
+
+    m_work_available.notify_all();
+
+    for (std::unique_ptr<Worker>& worker : m_workers) {
+        worker->thread.join();
+    }
+}
+
+void JobSystem::run(std::vector<ScriptJob>& jobs) {
+    if (jobs.size() == 0) {
+        return;
+    }
+
+    m_remaining_jobs = jobs.size();
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        ScriptJob& job = jobs.at(i);
+
+        Worker& worker = *m_workers.at(i % m_workers.size());
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs.push_back(&job);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_work_mutex);
+        m_batch_generation++;
+    }
+
+    m_work_available.notify_all();
+
+    // Serve the external functions pinned to this thread until the batch is done
+
+    std::unique_lock<std::mutex> lock(m_main_mutex);
+
+    while (true) {
+        m_main_wakeup.wait(lock, [&]() {
+            return m_main_calls.size() > 0 || m_remaining_jobs == 0;
+        });
+
+        if (m_main_calls.size() == 0) {
+            break;
+        }
+
+        std::vector<MainThreadCall*> calls;
+        calls.swap(m_main_calls);
+
+        lock.unlock();
+
+        for (MainThreadCall* call : calls) {
+            call_external_function(*call->function, *call->stack);
+        }
+
+        lock.lock();
+
+        for (MainThreadCall* call : calls) {
+            call->done = true;
+        }
+
+        m_main_calls_done.notify_all();
+    }
+}
+
+size_t JobSystem::get_worker_count() const {
+    return m_workers.size();
+}
+
+void JobSystem::worker_loop(size_t worker_index) {
+    size_t seen_generation = 0;
+
+    while (true) {
+        ScriptJob* job = take_job(worker_index);
+
+        if (job) {
+            run_job(*job);
+            finish_job();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_work_mutex);
+
+        m_work_available.wait(lock, [&]() {
+            return m_stopping || m_batch_generation != seen_generation;
+        });
+
+        if (m_stopping) {
+            return;
+        }
+
+        seen_generation = m_batch_generation;
+    }
+}
+
+ScriptJob* JobSystem::take_job(size_t worker_index) {
+    {
+        Worker& worker = *m_workers.at(worker_index);
+        std::lock_guard<std::mutex> lock(worker.mutex);
+
+        if (worker.jobs.size() > 0) {
+            ScriptJob* job = worker.jobs.back();
+            worker.jobs.pop_back();
+            return job;
+        }
+    }
+
+    for (size_t i = 1; i < m_workers.size(); i++) {
+        Worker& victim = *m_workers.at((worker_index + i) % m_workers.size());
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (victim.jobs.size() > 0) {
+            ScriptJob* job = victim.jobs.front();
+            victim.jobs.pop_front();
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+void JobSystem::run_job(ScriptJob& job) {
+    const Engine& engine = *job.engine;
+    Fiber& fiber = job.fiber;
+
+    bool resuming = job.status == ScriptJobStatus::YIELDED 
+                 || job.status == ScriptJobStatus::OUT_OF_BUDGET;
+
+    if (!resuming) {
+        engine.reset(fiber, job.function);
+
+        for (const TypeVariant& arg : job.args) {
+            std::visit([&](const auto& value) { fiber.stack.push(value); }, arg);
+        }
+    }
+
+    fiber.external_gate = &m_main_thread_gate;
+
+    ExecutionStatus status = job.instruction_budget == 0 
+        ? engine.execute(fiber) 
+        : engine.execute_for(fiber, job.instruction_budget);
+
+    switch (status) {
+        case ExecutionStatus::YIELDED: {
+            job.status = ScriptJobStatus::YIELDED;
+            break;
+        }
+        case ExecutionStatus::OUT_OF_FUEL: {
+            job.status = ScriptJobStatus::OUT_OF_BUDGET;
+            break;
+        }
+        default: {
+            job.status = ScriptJobStatus::COMPLETED;
+            break;
+        }
+    }
+}
+
+void JobSystem::finish_job() {
+    if (--m_remaining_jobs > 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_main_mutex);
+    m_main_wakeup.notify_one();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "engine.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class ScriptJobStatus {
+    PENDING,
+    COMPLETED,
+    YIELDED,
+    OUT_OF_BUDGET
+};
+
+// One call into a script. The fiber is kept with the job, so reusing jobs from one
+// batch to the next reuses their memory, and the return value is left on its stack.
+// A job that yielded or ran out of budget picks up where it stopped in the next batch.
+struct ScriptJob {
+    const Engine* engine;
+    FunctionHandle function;
+    std::vector<TypeVariant> args;
+
+    // Instructions the job may run before it is stopped, 0 for no limit
+    size_t instruction_budget = 0;
+
+    Fiber fiber;
+    ScriptJobStatus status = ScriptJobStatus::PENDING;
+};
+
+// Runs batches of script jobs across worker threads. Each worker has its own deque of
+// jobs, it takes work from the back of its own and steals from the front of the others.
+class JobSystem {
+public:
+    JobSystem(size_t worker_count = std::thread::hardware_concurrency());
+
+    ~JobSystem();
+
+    // Runs every job and returns once they have all finished. This has to be called from
+    // the main thread, which runs the external functions that aren't thread safe while
+    // it waits.
+    void run(std::vector<ScriptJob>& jobs);
+
+    size_t get_worker_count() const;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<ScriptJob*> jobs;
+        std::thread thread;
+    };
+
+    struct MainThreadCall {
+        const ExternalFunction* function;
+        ByteStack* stack;
+        bool done;
+    };
+
+    class MainThreadGate : public ExternalCallGate {
+    public:
+        MainThreadGate(JobSystem& jobs);
+
+        void call(const ExternalFunction& function, ByteStack& stack) override;
+
+    private:
+        JobSystem& m_jobs;
+    };
+
+    void worker_loop(size_t worker_index);
+
+    ScriptJob* take_job(size_t worker_index);
+
+    void run_job(ScriptJob& job);
+
+    void finish_job();
+
+private:
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    std::mutex m_work_mutex;
+    std::condition_variable m_work_available;
+    size_t m_batch_generation;
+    bool m_stopping;
+
+    std::atomic<size_t> m_remaining_jobs;
+
+    std::mutex m_main_mutex;
+    std::condition_variable m_main_wakeup;
+    std::condition_variable m_main_calls_done;
+    std::vector<MainThreadCall*> m_main_calls;
+    
+    MainThreadGate m_main_thread_gate;
+};
@@ -0,0 +1,70 @@
+#include "compiler.h"
+#include "job_system.h"
+
+#include <chrono>
+
+// Runs the same batch of script jobs with 1 to N workers and reports the speedup
+
+static const char* s_script =
+    "int work(int n) {"
+    "    int i = 0;"
+    "    int sum = 0;"
+    "    while (i < n) {"
+    "        sum = sum + i;"
+    "        i = i + 1;"
+    "    }"
+    "    return sum;"
+    "}"
+    ""
+    "void main() {}";
+
+int main() {
+    CompilationResults results = compile(s_script, {});
+
+    if (results.error.type != CompilationErrorType::NONE) {
+        return 1;
+    }
+
+    Engine engine(results.program);
+    std::optional<FunctionHandle> work = engine.resolve_function("work");
+
+    if (!work.has_value()) {
+        return 1;
+    }
+
+    const size_t job_count = 10000;
+    const int iterations = 1000;
+
+    std::vector<ScriptJob> jobs(job_count);
+    for (ScriptJob& job : jobs) {
+        job.engine = &engine;
+        job.function = work.value();
+        job.args = { iterations };
+    }
+
+    size_t max_workers = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    double single_worker_ms = 0;
+
+    printf("\n%8s %12s %10s\n", "workers", "ms", "speedup");
+
+    for (size_t workers = 1; workers <= max_workers; workers++) {
+        JobSystem job_system(workers);
+
+        // Warm up the fibers so the timed run doesn't measure their first allocations
+        job_system.run(jobs);
+
+        auto start = std::chrono::steady_clock::now();
+        job_system.run(jobs);
+        auto end = std::chrono::steady_clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+        if (workers == 1) {
+            single_worker_ms = ms;
+        }
+
+        printf("%8zu %12.2f %9.2fx\n", workers, ms, single_worker_ms / ms);
+    }
+
+    return 0;
+}
@@ -1,14 +1,22 @@
 #include "byte_code_vm_debugger.h"
 #include "compiler.h"
+#include "heap_allocation_counter.h"
+#include "standard_externals.h"
 
 #include "test.h"
 
 #include <thread>
 #include <fstream>
 #include <sstream>
-#include <charconv>
 
-int main() {
+// Pass --compile-stats to print where compiling test.sl spent its time and allocations
+int main(int argc, char** argv) {
+    bool compile_stats = argc > 1 && std::string_view(argv[1]) == "--compile-stats";
+
+    if (compile_stats) {
+        set_compilation_allocation_counter(get_heap_allocation_count);
+    }
+
     run_tests();
 
     std::string x;
@@ -20,32 +28,15 @@ int main() {
     }
     
     std::vector<ExternalFunction> external_functions = {
-        {
-            Type::VOID,
-            "print",
-            {
-                { Type::STRING, "string" }
-            },
-            [](const std::vector<TypeVariant>& args) -> TypeVariant {
-                printf("%s\n", std::get<std::string>(args.at(0)).c_str());
-                return {};
-            }
-        },
-        {
-            Type::STRING,
-            "to_string",
-            {
-                { Type::INT, "value" },
-            },
-            [](const std::vector<TypeVariant>& args) -> TypeVariant {
-                char buf[32];
-                std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), std::get<int>(args.at(0)));
-                return std::string(buf, r.ptr);
-            }
-        }
+        bind_print(),
+        bind_to_string()
     };
 
-    CompilationResults results = compile(x, external_functions);
+    CompilationResults results = compile(x, external_functions, compile_stats);
+
+    if (results.stats.has_value()) {
+        print_compilation_stats(results.stats.value());
+    }
 
     if (results.error.type != CompilationErrorType::NONE) {
         return 1;
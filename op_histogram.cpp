@@ -0,0 +1,240 @@
+#include "op_histogram.h"
+
+#include "engine.h"
+#include "byte_code_enum_translation.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+// Sequences are keyed by their op types packed into one integer
+static constexpr uint32_t OP_BITS = 10;
+
+static uint32_t pack_sequence(const OpType* ops, size_t length) {
+    uint32_t key = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        key = (key << OP_BITS) | static_cast<uint32_t>(ops[i]);
+    }
+
+    return key;
+}
+
+static std::array<OpType, 3> unpack_sequence(uint32_t key, size_t length) {
+    std::array<OpType, 3> ops{};
+
+    for (size_t i = length; i-- > 0;) {
+        ops[i] = static_cast<OpType>(key & ((1u << OP_BITS) - 1));
+        key >>= OP_BITS;
+    }
+
+    return ops;
+}
+
+OpHistogram::OpHistogram() {
+    assert(op_type_count() <= (1u << OP_BITS));
+}
+
+void OpHistogram::add_static(const Engine& engine) {
+    const std::vector<EngineOp>& operations = engine.get_operations();
+
+    // Functions are laid out one after the other, a sequence doesn't cross into the next
+    std::vector<bool> function_starts(operations.size() + 1, false);
+
+    for (size_t i = 0; i < engine.get_program().functions.size(); i++) {
+        function_starts[engine.get_function(i).code_index] = true;
+    }
+
+    for (size_t i = 0; i < operations.size(); i++) {
+        OpType ops[3];
+        size_t length = 0;
+
+        for (; length < 3 && i + length < operations.size(); length++) {
+            if (length > 0 && function_starts[i + length]) {
+                break;
+            }
+
+            ops[length] = operations[i + length].type;
+        }
+
+        if (length >= 2) {
+            m_pairs[pack_sequence(ops, 2)].static_count++;
+        }
+
+        if (length >= 3) {
+            m_trigrams[pack_sequence(ops, 3)].static_count++;
+        }
+    }
+}
+
+void OpHistogram::before_op(const Fiber& fiber, size_t, OpType type) {
+    if (m_previous_count >= 1) {
+        OpType pair[2] = { m_previous[0], type };
+        m_pairs[pack_sequence(pair, 2)].dynamic_count++;
+    }
+
+    if (m_previous_count >= 2) {
+        OpType trigram[3] = { m_previous[1], m_previous[0], type };
+        m_trigrams[pack_sequence(trigram, 3)].dynamic_count++;
+    }
+
+    m_previous[1] = m_previous[0];
+    m_previous[0] = type;
+    m_previous_count = std::min<size_t>(m_previous_count + 1, 2);
+
+    // Returning from the outermost function ends the run
+    if (type == OpType::RETURN && fiber.call_stack.empty()) {
+        break_sequence();
+    }
+}
+
+void OpHistogram::after_op(const Fiber&, size_t, OpType) {}
+
+void OpHistogram::break_sequence() {
+    m_previous_count = 0;
+}
+
+void OpHistogram::clear() {
+    m_pairs.clear();
+    m_trigrams.clear();
+    break_sequence();
+}
+
+bool OpHistogram::load(const std::string& path) {
+    std::ifstream file(path);
+
+    if (!file) {
+        return false;
+    }
+
+    std::string line;
+
+    while (std::getline(file, line)) {
+        std::istringstream words(line);
+        std::string kind;
+        words >> kind;
+
+        size_t length = kind == "pair" ? 2 : kind == "trigram" ? 3 : 0;
+
+        if (length == 0) {
+            continue;
+        }
+
+        OpType ops[3];
+        bool known = true;
+
+        for (size_t i = 0; i < length; i++) {
+            std::string name;
+            words >> name;
+
+            std::optional<OpType> type = op_type_from_string(name);
+            known = known && type.has_value();
+            ops[i] = type.value_or(OpType::PLACEHOLDER);
+        }
+
+        Counts counts;
+        words >> counts.dynamic_count >> counts.static_count;
+
+        if (!known || words.fail()) {
+            continue;
+        }
+
+        Counts& total = get_sequences(length)[pack_sequence(ops, length)];
+        total.dynamic_count += counts.dynamic_count;
+        total.static_count += counts.static_count;
+    }
+
+    return true;
+}
+
+bool OpHistogram::save(const std::string& path) const {
+    std::ofstream file(path);
+
+    if (!file) {
+        return false;
+    }
+
+    file << "# kind, operations, dynamic count, static count\n";
+
+    for (size_t length = 2; length <= 3; length++) {
+        for (const OpSequenceCount& sequence : get_ranked(length)) {
+            file << (length == 2 ? "pair" : "trigram");
+
+            for (size_t i = 0; i < length; i++) {
+                file << ' ' << op_type_to_string(sequence.ops[i]);
+            }
+
+            file << ' ' << sequence.dynamic_count << ' ' << sequence.static_count << '\n';
+        }
+    }
+
+    return static_cast<bool>(file);
+}
+
+std::vector<OpSequenceCount> OpHistogram::get_ranked(size_t length) const {
+    std::vector<OpSequenceCount> ranked;
+
+    for (const auto& [key, counts] : get_sequences(length)) {
+        ranked.push_back({ unpack_sequence(key, length), length, counts.dynamic_count, counts.static_count });
+    }
+
+    std::sort(ranked.begin(), ranked.end(), [](const OpSequenceCount& a, const OpSequenceCount& b) {
+        if (a.dynamic_count != b.dynamic_count) {
+            return a.dynamic_count > b.dynamic_count;
+        }
+
+        if (a.static_count != b.static_count) {
+            return a.static_count > b.static_count;
+        }
+
+        return a.ops < b.ops;
+    });
+
+    return ranked;
+}
+
+uint64_t OpHistogram::get_dynamic_total(size_t length) const {
+    uint64_t total = 0;
+
+    for (const auto& [key, counts] : get_sequences(length)) {
+        total += counts.dynamic_count;
+    }
+
+    return total;
+}
+
+void OpHistogram::print(size_t count) const {
+    for (size_t length = 2; length <= 3; length++) {
+        std::vector<OpSequenceCount> ranked = get_ranked(length);
+        uint64_t total = get_dynamic_total(length);
+
+        printf("\n%s:\n", length == 2 ? "Pairs" : "Trigrams");
+        printf("%14s %7s %8s  %s\n", "dynamic", "%", "static", "operations");
+
+        for (size_t i = 0; i < std::min(count, ranked.size()); i++) {
+            const OpSequenceCount& sequence = ranked[i];
+
+            printf("%14llu %6.2f%% %8llu  ",
+                static_cast<unsigned long long>(sequence.dynamic_count),
+                total > 0 ? 100.0 * sequence.dynamic_count / total : 0.0,
+                static_cast<unsigned long long>(sequence.static_count)
+            );
+
+            for (size_t j = 0; j < length; j++) {
+                printf("%s%s", j > 0 ? " " : "", op_type_to_string(sequence.ops[j]).data());
+            }
+
+            printf("\n");
+        }
+    }
+}
+
+std::unordered_map<uint32_t, OpHistogram::Counts>& OpHistogram::get_sequences(size_t length) {
+    return length == 2 ? m_pairs : m_trigrams;
+}
+
+const std::unordered_map<uint32_t, OpHistogram::Counts>& OpHistogram::get_sequences(size_t length) const {
+    return length == 2 ? m_pairs : m_trigrams;
+}
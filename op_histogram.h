@@ -0,0 +1,74 @@
+#pragma once
+
+#include "fiber.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Engine;
+
+struct OpSequenceCount {
+    std::array<OpType, 3> ops;
+    size_t length;
+
+    // How often the sequence ran, and how often it appears in the programs added
+    uint64_t dynamic_count;
+    uint64_t static_count;
+};
+
+// Counts how often each pair and each triple of consecutive operations runs, to pick
+// superinstructions and the order of handlers from. Counts from any number of runs
+// and programs add up, and a file written by save() is merged in by load(), so they
+// can be gathered over many sessions. Sequences are of the engine's decoded operations,
+// the ones the vm actually dispatches on.
+class OpHistogram : public OpHook {
+public:
+    OpHistogram();
+
+    // Counts the sequences in the engine's operations as they appear in the program,
+    // without running anything
+    void add_static(const Engine& engine);
+
+    void before_op(const Fiber& fiber, size_t code_index, OpType type) override;
+
+    void after_op(const Fiber& fiber, size_t code_index, OpType type) override;
+
+    // Forgets the operations that came before, so a sequence doesn't span two runs
+    void break_sequence();
+
+    void clear();
+
+    // Adds the counts from a file written by save(), operations it doesn't know are
+    // skipped. Returns false when the file can't be read.
+    bool load(const std::string& path);
+
+    bool save(const std::string& path) const;
+
+    // Sequences of 2 or 3 operations, the ones that ran the most first
+    std::vector<OpSequenceCount> get_ranked(size_t length) const;
+
+    uint64_t get_dynamic_total(size_t length) const;
+
+    void print(size_t count = 30) const;
+
+private:
+    struct Counts {
+        uint64_t dynamic_count = 0;
+        uint64_t static_count = 0;
+    };
+
+    std::unordered_map<uint32_t, Counts>& get_sequences(size_t length);
+
+    const std::unordered_map<uint32_t, Counts>& get_sequences(size_t length) const;
+
+private:
+    std::unordered_map<uint32_t, Counts> m_pairs;
+    std::unordered_map<uint32_t, Counts> m_trigrams;
+
+    // The operations that ran last, the most recent first
+    std::array<OpType, 2> m_previous{};
+    size_t m_previous_count = 0;
+};
@@ -0,0 +1,85 @@
+#include "compiler.h"
+#include "byte_code_vm.h"
+#include "op_histogram.h"
+#include "standard_externals.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+// Gathers op pair and trigram counts from running scripts into a file, and ranks them.
+//
+//   SimpleLangOpStats record <histogram file> <script>...
+//   SimpleLangOpStats report <histogram file> [count]
+
+static int record(const std::string& histogram_path, int script_count, char** script_paths) {
+    OpHistogram histogram;
+    histogram.load(histogram_path);
+
+    std::vector<ExternalFunction> external_functions = {
+        bind_print(),
+        bind_to_string()
+    };
+
+    for (int i = 0; i < script_count; i++) {
+        std::ifstream file(script_paths[i]);
+        std::stringstream text;
+        text << file.rdbuf();
+
+        CompilationResults results = compile(text.str(), external_functions, false, true);
+
+        if (results.error.type != CompilationErrorType::NONE) {
+            fprintf(stderr, "%s: doesn't compile, skipped\n", script_paths[i]);
+            continue;
+        }
+
+        std::optional<FunctionHandle> main_function = results.program.resolve_function("main");
+
+        if (!main_function.has_value() || main_function.value().argument_count > 0) {
+            fprintf(stderr, "%s: needs a main without arguments, skipped\n", script_paths[i]);
+            continue;
+        }
+
+        ByteCodeVm vm(results.program);
+        histogram.add_static(vm.get_engine());
+
+        vm.set_op_hook(&histogram);
+        vm.execute();
+        histogram.break_sequence();
+    }
+
+    if (!histogram.save(histogram_path)) {
+        fprintf(stderr, "%s: can't be written\n", histogram_path.c_str());
+        return 1;
+    }
+
+    return 0;
+}
+
+static int report(const std::string& histogram_path, size_t count) {
+    OpHistogram histogram;
+
+    if (!histogram.load(histogram_path)) {
+        fprintf(stderr, "%s: can't be read\n", histogram_path.c_str());
+        return 1;
+    }
+
+    histogram.print(count);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string command = argc > 2 ? argv[1] : "";
+
+    if (command == "record") {
+        return record(argv[2], argc - 3, argv + 3);
+    }
+
+    if (command == "report") {
+        return report(argv[2], argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 30);
+    }
+
+    fprintf(stderr, "usage: %s record <histogram file> <script>...\n", argv[0]);
+    fprintf(stderr, "       %s report <histogram file> [count]\n", argv[0]);
+    return 1;
+}
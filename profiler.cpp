@@ -0,0 +1,258 @@
+#include "profiler.h"
+
+#include "engine.h"
+#include "byte_code_enum_translation.h"
+#include "byte_code_printer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+static constexpr size_t NO_FUNCTION = static_cast<size_t>(-1);
+
+Profiler::Profiler(const Engine& engine)
+    : m_program         (engine.get_program())
+    , m_operation_count (engine.get_operations().size())
+{
+    m_op_types.resize(op_type_count());
+    m_instructions.resize(m_operation_count);
+    m_functions.resize(m_program.functions.size());
+    m_open_frame_counts.resize(m_program.functions.size());
+}
+
+void Profiler::clear() {
+    std::fill(m_op_types.begin(), m_op_types.end(), ProfileCounter{});
+    std::fill(m_instructions.begin(), m_instructions.end(), ProfileCounter{});
+    std::fill(m_functions.begin(), m_functions.end(), FunctionProfile{});
+    std::fill(m_open_frame_counts.begin(), m_open_frame_counts.end(), 0);
+
+    m_frames.clear();
+    m_total_cycles = 0;
+    m_total_count = 0;
+}
+
+void Profiler::before_op(const Fiber& fiber, size_t, OpType) {
+    // The host may have called into the fiber or reset it since the last operation
+    sync_frames(fiber);
+
+    m_op_function_index = fiber.function_index;
+    m_op_start = read_cycle_counter();
+}
+
+void Profiler::after_op(const Fiber& fiber, size_t code_index, OpType type) {
+    uint64_t stop = read_cycle_counter();
+
+    record_op(type, code_index, m_op_function_index, stop - m_op_start);
+    sync_frames(fiber);
+}
+
+void Profiler::record_op(OpType type, size_t code_index, size_t function_index, uint64_t cycles) {
+    ProfileCounter& op_type = m_op_types[static_cast<size_t>(type)];
+    op_type.count++;
+    op_type.cycles += cycles;
+
+    ProfileCounter& instruction = m_instructions[code_index];
+    instruction.count++;
+    instruction.cycles += cycles;
+
+    if (function_index < m_functions.size()) {
+        m_functions[function_index].self_cycles += cycles;
+    }
+
+    m_total_cycles += cycles;
+    m_total_count++;
+}
+
+void Profiler::sync_frames(const Fiber& fiber) {
+    if (fiber.program_counter >= m_operation_count) {
+        close_frames(0);
+        return;
+    }
+
+    size_t depth = fiber.call_stack.size() + 1;
+
+    // The function at each depth, the call stack holds the caller of every frame.
+    // A call the host made into a fiber that wasn't running has no caller to count.
+    auto get_frame_function = [&](size_t frame_index) {
+        if (frame_index + 1 == depth) {
+            return fiber.function_index;
+        }
+
+        const CallFrame& frame = fiber.call_stack[frame_index];
+        return frame.return_code_index < m_operation_count ? frame.function_index : NO_FUNCTION;
+    };
+
+    if (m_frames.size() == depth && m_frames.back().function_index == fiber.function_index) {
+        return;
+    }
+
+    // Calls and returns move one frame at a time
+    if (m_frames.size() + 1 == depth) {
+        open_frame(fiber.function_index);
+        return;
+    }
+
+    if (m_frames.size() == depth + 1 && m_frames[depth - 1].function_index == fiber.function_index) {
+        close_frames(depth);
+        return;
+    }
+
+    // Anything else, like a fiber that was reset, starts over from where the two differ
+    size_t matching = 0;
+
+    while (matching < m_frames.size() && matching < depth && m_frames[matching].function_index == get_frame_function(matching)) {
+        matching++;
+    }
+
+    close_frames(matching);
+
+    for (size_t i = matching; i < depth; i++) {
+        open_frame(get_frame_function(i));
+    }
+}
+
+void Profiler::open_frame(size_t function_index) {
+    m_frames.push_back({ function_index, m_total_cycles });
+
+    if (function_index < m_functions.size()) {
+        m_functions[function_index].call_count++;
+        m_open_frame_counts[function_index]++;
+    }
+}
+
+void Profiler::close_frames(size_t frame_count) {
+    while (m_frames.size() > frame_count) {
+        const Frame& frame = m_frames.back();
+
+        if (frame.function_index < m_functions.size() && --m_open_frame_counts[frame.function_index] == 0) {
+            m_functions[frame.function_index].inclusive_cycles += m_total_cycles - frame.start_cycles;
+        }
+
+        m_frames.pop_back();
+    }
+}
+
+const ProfileCounter& Profiler::get_op_type(OpType type) const {
+    return m_op_types.at(static_cast<size_t>(type));
+}
+
+const ProfileCounter& Profiler::get_instruction(size_t code_index) const {
+    return m_instructions.at(code_index);
+}
+
+const FunctionProfile& Profiler::get_function(size_t function_index) const {
+    return m_functions.at(function_index);
+}
+
+uint64_t Profiler::get_total_cycles() const {
+    return m_total_cycles;
+}
+
+uint64_t Profiler::get_total_count() const {
+    return m_total_count;
+}
+
+static double get_percent(uint64_t cycles, uint64_t total) {
+    return total > 0 ? 100.0 * cycles / total : 0.0;
+}
+
+void Profiler::print(size_t instruction_count) const {
+    printf("\nProfile: %llu operations, %llu cycles\n",
+        static_cast<unsigned long long>(m_total_count),
+        static_cast<unsigned long long>(m_total_cycles)
+    );
+
+    std::vector<size_t> order;
+
+    printf("\nOp types:\n");
+    printf("%12s %14s %7s %10s  %s\n", "count", "cycles", "%", "cycles/op", "op");
+
+    for (size_t i = 0; i < m_op_types.size(); i++) {
+        if (m_op_types[i].count > 0) {
+            order.push_back(i);
+        }
+    }
+
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return m_op_types[a].cycles > m_op_types[b].cycles;
+    });
+
+    for (size_t i : order) {
+        const ProfileCounter& counter = m_op_types[i];
+
+        printf("%12llu %14llu %6.2f%% %10.1f  %s\n",
+            static_cast<unsigned long long>(counter.count),
+            static_cast<unsigned long long>(counter.cycles),
+            get_percent(counter.cycles, m_total_cycles),
+            static_cast<double>(counter.cycles) / counter.count,
+            op_type_to_string(static_cast<OpType>(i)).data()
+        );
+    }
+
+    printf("\nFunctions:\n");
+    printf("%12s %14s %7s %14s %7s  %s\n", "calls", "self", "%", "inclusive", "%", "function");
+
+    order.clear();
+
+    for (size_t i = 0; i < m_functions.size(); i++) {
+        if (m_functions[i].call_count > 0 || m_functions[i].self_cycles > 0) {
+            order.push_back(i);
+        }
+    }
+
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return m_functions[a].inclusive_cycles > m_functions[b].inclusive_cycles;
+    });
+
+    for (size_t i : order) {
+        const FunctionProfile& function = m_functions[i];
+
+        printf("%12llu %14llu %6.2f%% %14llu %6.2f%%  %s\n",
+            static_cast<unsigned long long>(function.call_count),
+            static_cast<unsigned long long>(function.self_cycles),
+            get_percent(function.self_cycles, m_total_cycles),
+            static_cast<unsigned long long>(function.inclusive_cycles),
+            get_percent(function.inclusive_cycles, m_total_cycles),
+            m_program.functions.at(i).name.c_str()
+        );
+    }
+
+    printf("\nInstructions:\n");
+    printf("%12s %14s %7s %6s  %s\n", "count", "cycles", "%", "line", "operation");
+
+    order.clear();
+
+    for (size_t i = 0; i < m_instructions.size(); i++) {
+        if (m_instructions[i].count > 0) {
+            order.push_back(i);
+        }
+    }
+
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return m_instructions[a].cycles > m_instructions[b].cycles;
+    });
+
+    order.resize(std::min(order.size(), instruction_count));
+
+    for (size_t i : order) {
+        const ProfileCounter& counter = m_instructions[i];
+
+        printf("%12llu %14llu %6.2f%% ",
+            static_cast<unsigned long long>(counter.count),
+            static_cast<unsigned long long>(counter.cycles),
+            get_percent(counter.cycles, m_total_cycles)
+        );
+
+        // Programs that weren't compiled from source have no lines
+        if (i < m_program.source_lines.size() && m_program.source_lines[i] > 0) {
+            printf("%6zu", m_program.source_lines[i]);
+        }
+
+        else {
+            printf("%6s", "-");
+        }
+
+        printf("  %3zu : ", i);
+        print_byte_code(m_program.operations.at(i));
+        printf("\n");
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "fiber.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SIMPLE_LANG_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SIMPLE_LANG_HAS_TSC 1
+#endif
+
+// The cpu's time stamp counter where there is one, nanoseconds elsewhere
+inline uint64_t read_cycle_counter() {
+#ifdef SIMPLE_LANG_HAS_TSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct Program;
+class Engine;
+
+struct ProfileCounter {
+    uint64_t count = 0;
+    uint64_t cycles = 0;
+};
+
+// Self time is spent in the function's own operations, inclusive time adds everything
+// it called. A recursive function's inclusive time is only counted for its outermost call.
+struct FunctionProfile {
+    uint64_t call_count = 0;
+    uint64_t self_cycles = 0;
+    uint64_t inclusive_cycles = 0;
+};
+
+// Counts executions and cycles per op type, per instruction and per function for the
+// fiber it is hooked into. Time is only counted while operations run, so a fiber that
+// sits yielded doesn't add to the functions it is inside.
+class Profiler : public OpHook {
+public:
+    Profiler(const Engine& engine);
+
+    void clear();
+
+    void before_op(const Fiber& fiber, size_t code_index, OpType type) override;
+
+    void after_op(const Fiber& fiber, size_t code_index, OpType type) override;
+
+    // Results
+
+    const ProfileCounter& get_op_type(OpType type) const;
+
+    const ProfileCounter& get_instruction(size_t code_index) const;
+
+    const FunctionProfile& get_function(size_t function_index) const;
+
+    uint64_t get_total_cycles() const;
+
+    uint64_t get_total_count() const;
+
+    // Lists op types and functions, then the hottest instructions as Program::print
+    // shows them along with their source line
+    void print(size_t instruction_count = 20) const;
+
+private:
+    struct Frame {
+        size_t function_index;
+        uint64_t start_cycles;
+    };
+
+    void record_op(OpType type, size_t code_index, size_t function_index, uint64_t cycles);
+
+    // Follows the fiber into calls and out of returns
+    void sync_frames(const Fiber& fiber);
+
+    void open_frame(size_t function_index);
+
+    void close_frames(size_t frame_count);
+
+private:
+    const Program& m_program;
+    size_t m_operation_count;
+
+    std::vector<ProfileCounter> m_op_types;
+    std::vector<ProfileCounter> m_instructions;
+    std::vector<FunctionProfile> m_functions;
+
+    // Mirrors the profiled fiber's call stack, with how many frames each function has in it
+    std::vector<Frame> m_frames;
+    std::vector<size_t> m_open_frame_counts;
+
+    uint64_t m_total_cycles = 0;
+    uint64_t m_total_count = 0;
+
+    // The operation being timed
+    size_t m_op_function_index = 0;
+    uint64_t m_op_start = 0;
+};
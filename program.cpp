@@ -3,6 +3,32 @@
 #include "byte_code_printer.h"
 #include "byte_code_enum_translation.h"
 
+size_t Program::get_slot_count(Type type) const {
+    if (is_object_type(type)) {
+        return object_types.at(object_type_index(type)).slot_types.size();
+    }
+
+    return type == Type::VOID ? 0 : 1;
+}
+
+std::string_view Program::get_type_name(Type type) const {
+    if (is_object_type(type)) {
+        return object_types.at(object_type_index(type)).name;
+    }
+
+    return type_to_string(type);
+}
+
+std::optional<Type> Program::find_object_type(const std::string& name) const {
+    for (size_t i = 0; i < object_types.size(); i++) {
+        if (object_types.at(i).name == name) {
+            return object_type(i);
+        }
+    }
+
+    return std::nullopt;
+}
+
 std::optional<CallableFunctionInfo> Program::find_function(const std::string& identifier) const {
     for (size_t i = 0; i < functions.size(); i++) {
         if (functions.at(i).name != identifier) {
@@ -23,6 +49,37 @@ std::optional<CallableFunctionInfo> Program::find_function(const std::string& id
     return std::nullopt;
 }
 
+std::optional<FunctionHandle> Program::resolve_function(const std::string& identifier) const {
+    std::optional<CallableFunctionInfo> info = find_function(identifier);
+
+    if (!info.has_value()) {
+        return std::nullopt;
+    }
+
+    FunctionHandle handle{};
+    handle.type = info.value().type;
+    handle.function_index = info.value().function_index;
+
+    switch (handle.type) {
+        case FunctionType::SCRIPT: {
+            const Function& function = functions.at(handle.function_index);
+            handle.code_index = function.code_index;
+            handle.argument_count = function.argument_count;
+            handle.return_type = function.return_type;
+            break;
+        }
+        case FunctionType::EXTERNAL: {
+            const ExternalFunction& function = external_functions.at(handle.function_index);
+            handle.code_index = 0;
+            handle.argument_count = function.arguments.size();
+            handle.return_type = function.return_type;
+            break;
+        }
+    }
+
+    return handle;
+}
+
 void Program::print() const {
     print(main_code_index);
 }
@@ -57,11 +114,11 @@ void Program::print(size_t highlight_code_index) const {
     for (size_t i = 0; i < functions.size(); i++) {
         const Function& function = functions.at(i);
 
-        printf("%4zu : %s %s(", function.code_index, type_to_string(function.return_type).data(), function.name.c_str());
+        printf("%4zu : %s %s(", function.code_index, get_type_name(function.return_type).data(), function.name.c_str());
 
         for (size_t j = 0; j < function.argument_count; j++) {
             const Variable& variable = function.local_variables.at(j); 
-            printf("%s %s", type_to_string(variable.type).data(), variable.name.c_str());
+            printf("%s %s", get_type_name(variable.type).data(), variable.name.c_str());
 
             if (j != function.argument_count - 1) {
                 printf(", ");
@@ -72,12 +129,26 @@ void Program::print(size_t highlight_code_index) const {
 
         for (size_t j = function.argument_count; j < function.local_variables.size(); j++) {
             const Variable& variable = function.local_variables.at(j); 
-            printf("\n        %s %s", type_to_string(variable.type).data(), variable.name.c_str());
+            printf("\n        %s %s", get_type_name(variable.type).data(), variable.name.c_str());
         }
         
         printf("\n");
     }
 
+    printf("\nTypes:\n");
+    for (size_t i = 0; i < object_types.size(); i++) {
+        const ObjectType& object = object_types.at(i);
+
+        printf("%4zu : %s", i, object.name.c_str());
+
+        for (size_t j = 0; j < object.fields.size(); j++) {
+            const Variable& field = object.fields.at(j);
+            printf("\n        +%zu %s %s", object.field_offsets.at(j), get_type_name(field.type).data(), field.name.c_str());
+        }
+
+        printf("\n");
+    }
+
     printf("\nExternal functions:\n");
     for (size_t i = 0; i < external_functions.size(); i++) {
         const ExternalFunction& function = external_functions.at(i);
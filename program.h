@@ -11,9 +11,15 @@ struct Variable {
     std::string name;
 };
 
-// struct Type {
-
-// };
+// Structs are flat values, every field that isn't a struct takes one slot
+// in a variable or one item on the stack
+struct ObjectType {
+    std::string name;
+    std::vector<Variable> fields;
+    std::vector<size_t> field_offsets;
+    std::vector<Type> slot_types;
+    std::vector<std::string> slot_names;
+};
 
 struct Function {
     size_t code_index;
@@ -23,11 +29,23 @@ struct Function {
     std::vector<Variable> local_variables;
 };
 
+class ByteStack;
+
+// Allocation free entry point generated by bind_external. It reads its arguments
+// straight off the stack and pushes the result back in their place.
+using ExternalFunctionTrampoline = void(*)(ByteStack& stack, void(*native)());
+
 struct ExternalFunction {
     Type return_type;
     std::string name;
     std::vector<Variable> arguments;
     std::function<TypeVariant(const std::vector<TypeVariant>&)> proc;
+    ExternalFunctionTrampoline trampoline = nullptr;
+    void(*native)() = nullptr;
+
+    // Functions that aren't thread safe are only ever called on the main thread when
+    // scripts run on the job system
+    bool thread_safe = false;
 };
 
 enum class FunctionType {
@@ -40,14 +58,38 @@ struct CallableFunctionInfo {
     size_t function_index;
 };
 
+// A function resolved once by name so the host can call into the program
+// repeatedly without searching for it or checking its signature again.
+struct FunctionHandle {
+    FunctionType type;
+    size_t function_index;
+    size_t code_index;
+    size_t argument_count;
+    Type return_type;
+};
+
 struct Program {
     std::vector<ByteCodeOp> operations;
     std::vector<Function> functions;
     std::vector<ExternalFunction> external_functions;
+    std::vector<ObjectType> object_types;
+    std::vector<Variable> global_variables;
     size_t main_code_index;
 
+    // The source line each operation was compiled from, 0 where there isn't one.
+    // Empty for programs that weren't compiled from source.
+    std::vector<size_t> source_lines;
+
+    size_t get_slot_count(Type type) const;
+
+    std::string_view get_type_name(Type type) const;
+
+    std::optional<Type> find_object_type(const std::string& name) const;
+
     std::optional<CallableFunctionInfo> find_function(const std::string& identifier) const;
 
+    std::optional<FunctionHandle> resolve_function(const std::string& identifier) const;
+
     void print() const;
 
     void print(size_t highlight_code_index) const;
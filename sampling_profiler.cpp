@@ -0,0 +1,200 @@
+#include "sampling_profiler.h"
+
+#include "fiber.h"
+
+#include <algorithm>
+
+void SampledCallStack::push(size_t function_index) {
+    begin_write();
+
+    uint32_t depth = m_depth.load(std::memory_order_relaxed);
+
+    if (depth < MAX_DEPTH) {
+        m_functions[depth].store(static_cast<uint32_t>(function_index), std::memory_order_relaxed);
+    }
+
+    m_depth.store(depth + 1, std::memory_order_relaxed);
+
+    end_write();
+}
+
+void SampledCallStack::pop() {
+    begin_write();
+
+    uint32_t depth = m_depth.load(std::memory_order_relaxed);
+    m_depth.store(depth > 0 ? depth - 1 : 0, std::memory_order_relaxed);
+
+    end_write();
+}
+
+void SampledCallStack::reset(size_t function_index) {
+    begin_write();
+
+    m_functions[0].store(static_cast<uint32_t>(function_index), std::memory_order_relaxed);
+    m_depth.store(1, std::memory_order_relaxed);
+
+    end_write();
+}
+
+void SampledCallStack::clear() {
+    begin_write();
+    m_depth.store(0, std::memory_order_relaxed);
+    end_write();
+}
+
+void SampledCallStack::set_running(bool running) {
+    m_running.store(running, std::memory_order_relaxed);
+}
+
+size_t SampledCallStack::read(uint32_t* functions, size_t max_depth) const {
+    while (true) {
+        if (!m_running.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+
+        uint32_t sequence = m_sequence.load(std::memory_order_acquire);
+
+        if (sequence & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        uint32_t depth = m_depth.load(std::memory_order_relaxed);
+        size_t count = std::min<size_t>({ depth, max_depth, MAX_DEPTH });
+
+        for (size_t i = 0; i < count; i++) {
+            functions[i] = m_functions[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (m_sequence.load(std::memory_order_relaxed) == sequence) {
+            return depth;
+        }
+    }
+}
+
+void SampledCallStack::begin_write() {
+    m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void SampledCallStack::end_write() {
+    m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+SamplingProfiler::SamplingProfiler(const Program& program, std::chrono::microseconds interval)
+    : m_program  (program)
+    , m_interval (interval)
+{}
+
+SamplingProfiler::~SamplingProfiler() {
+    stop();
+}
+
+void SamplingProfiler::attach(Fiber& fiber) {
+    fiber.sampled_call_stack = &m_call_stack;
+
+    m_call_stack.clear();
+
+    if (fiber.program_counter >= m_program.operations.size()) {
+        return;
+    }
+
+    for (const CallFrame& frame : fiber.call_stack) {
+        m_call_stack.push(frame.function_index);
+    }
+
+    m_call_stack.push(fiber.function_index);
+}
+
+void SamplingProfiler::detach(Fiber& fiber) {
+    if (fiber.sampled_call_stack == &m_call_stack) {
+        fiber.sampled_call_stack = nullptr;
+    }
+
+    m_call_stack.set_running(false);
+    m_call_stack.clear();
+}
+
+void SamplingProfiler::start() {
+    if (m_thread.joinable()) {
+        return;
+    }
+
+    m_stopping = false;
+    m_thread = std::thread(&SamplingProfiler::sample_loop, this);
+}
+
+void SamplingProfiler::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_stop_requested.notify_one();
+    m_thread.join();
+}
+
+void SamplingProfiler::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_samples.clear();
+    m_sample_count = 0;
+}
+
+size_t SamplingProfiler::get_sample_count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sample_count;
+}
+
+void SamplingProfiler::write_folded(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const auto& [stack, count] : m_samples) {
+        for (size_t i = 0; i < stack.size(); i++) {
+            if (i > 0) {
+                out << ';';
+            }
+
+            if (stack[i] < m_program.functions.size()) {
+                out << m_program.functions[stack[i]].name;
+            }
+
+            else {
+                out << "[unknown]";
+            }
+        }
+
+        out << ' ' << count << '\n';
+    }
+}
+
+void SamplingProfiler::sample_loop() {
+    uint32_t functions[SampledCallStack::MAX_DEPTH];
+    std::chrono::steady_clock::time_point next_sample = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        next_sample += m_interval;
+
+        if (m_stop_requested.wait_until(lock, next_sample, [&]() { return m_stopping; })) {
+            break;
+        }
+
+        size_t depth = m_call_stack.read(functions, SampledCallStack::MAX_DEPTH);
+
+        if (depth == 0) {
+            continue;
+        }
+
+        size_t count = std::min(depth, SampledCallStack::MAX_DEPTH);
+
+        m_samples[std::vector<uint32_t>(functions, functions + count)]++;
+        m_sample_count++;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "program.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+struct Fiber;
+
+// A fiber's script call stack, kept up to date by the engine on every call and return
+// so another thread can read it while the fiber runs. Writes are bracketed by a sequence
+// number that is odd while a change is in progress, readers retry until they see the
+// same even number before and after reading.
+class SampledCallStack {
+public:
+    // Deeper frames are still counted but not recorded
+    static constexpr size_t MAX_DEPTH = 128;
+
+    // Updated by the engine
+
+    void push(size_t function_index);
+
+    void pop();
+
+    // The fiber is at the start of this function with nothing below it
+    void reset(size_t function_index);
+
+    void clear();
+
+    // Samples are only taken while the fiber is running
+    void set_running(bool running);
+
+    // Read from the sampling thread. Returns the stack's depth, 0 when the fiber isn't
+    // running, and fills in as many functions as fit from the outermost one down.
+    size_t read(uint32_t* functions, size_t max_depth) const;
+
+private:
+    void begin_write();
+
+    void end_write();
+
+private:
+    std::atomic<uint32_t> m_sequence = 0;
+    std::atomic<uint32_t> m_depth = 0;
+    std::atomic<bool> m_running = false;
+    std::atomic<uint32_t> m_functions[MAX_DEPTH] = {};
+};
+
+// Samples the call stack of a fiber from a helper thread at a fixed interval, for
+// timing scripts without the distortion of instrumenting every operation. Running
+// fibers only pay for keeping their call stack published on calls and returns.
+class SamplingProfiler {
+public:
+    SamplingProfiler(const Program& program, std::chrono::microseconds interval = std::chrono::microseconds(1000));
+
+    ~SamplingProfiler();
+
+    // The fiber must not be running while it is attached or detached, and has to be
+    // detached before either of them goes away
+    void attach(Fiber& fiber);
+
+    void detach(Fiber& fiber);
+
+    void start();
+
+    void stop();
+
+    void clear();
+
+    size_t get_sample_count() const;
+
+    // Brendan Gregg's folded stack format, one line per distinct stack with the script
+    // functions from the outermost in separated by ';', followed by its sample count.
+    // Feeds straight into flamegraph.pl.
+    void write_folded(std::ostream& out) const;
+
+private:
+    void sample_loop();
+
+private:
+    const Program& m_program;
+    std::chrono::microseconds m_interval;
+
+    SampledCallStack m_call_stack;
+
+    std::thread m_thread;
+    bool m_stopping = false;
+    std::condition_variable m_stop_requested;
+
+    mutable std::mutex m_mutex;
+    std::map<std::vector<uint32_t>, size_t> m_samples;
+    size_t m_sample_count = 0;
+};
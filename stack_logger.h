@@ -5,7 +5,15 @@
 
 class StackLogger {
 public:
-    StackLogger() : m_indent(0) {}
+    StackLogger() : m_indent(0), m_enabled(true) {}
+
+    void set_enabled(bool enabled) {
+        m_enabled = enabled;
+    }
+
+    bool is_enabled() const {
+        return m_enabled;
+    }
 
     void push() {
         m_indent++;
@@ -18,6 +26,10 @@ public:
     }
 
     void operator()(const char* format, ...) const {
+        if (!m_enabled) {
+            return;
+        }
+
         for (int i = 0; i < m_indent; ++i) {
             printf("  ");
         }
@@ -31,4 +43,5 @@ public:
 
 private:
     int m_indent;
+    bool m_enabled;
 };
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "external_function_binding.h"
+
+#include <charconv>
+#include <cstdio>
+
+// The externals the tools hand every script they run, so each tool binds the same ones
+
+// Prints the string and a newline to stdout
+inline ExternalFunction bind_print() {
+    return bind_external("print", +[](std::string_view value) {
+        printf("%.*s\n", static_cast<int>(value.size()), value.data());
+    });
+}
+
+// Formats an int, the result is copied onto the stack before the next call reuses the buffer
+inline ExternalFunction bind_to_string() {
+    return bind_external("to_string", +[](int value) -> std::string_view {
+        thread_local char buf[32];
+        std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), value);
+        return std::string_view(buf, r.ptr - buf);
+    });
+}
@@ -2,8 +2,22 @@
 
 #include "compiler.h"
 #include "byte_code_vm.h"
+#include "external_function_binding.h"
+#include "vm_pool.h"
+#include "job_system.h"
+#include "batch_executor.h"
+#include "sampling_profiler.h"
+#include "op_histogram.h"
+#include "heap_allocation_counter.h"
+#include "execution_trace.h"
+#include "byte_code_vm_debugger.h"
+#include "execution_log.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 
 struct TestResults {
     CompilationResults compilation;
@@ -78,7 +92,7 @@ TEST(no_strings_in_math_operations) {
     TestResults test = test_run(
         "void main() {"
         "   string x = \"\";"
-        "   string z = x + \"\";"
+        "   string z = x - \"\";"
         "}"
     );
 
@@ -274,6 +288,1166 @@ TEST(global_state_block_defines_global_identifier) {
     assert(test.compilation.error.type == CompilationErrorType::IDENTIFIED_ALREADY_DECLARED);
 }
 
+TEST(call_function_handle) {
+    CompilationResults compilation = compile(
+        "int combine(int x, int y) {"
+        "    return x * 10 + y;"
+        "}"
+        ""
+        "void main() {}",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    std::optional<FunctionHandle> combine = compilation.program.resolve_function("combine");
+    assert(combine.has_value());
+
+    ByteCodeVm vm(compilation.program);
+
+    // Arguments land in the order they were passed
+    vm.call_function(combine.value(), 1, 2);
+    assert(vm.get_stack().top_as_int() == 12);
+    vm.get_stack().pop();
+
+    TypeVariant args[] = { 4, 5 };
+    vm.call_function_span(combine.value(), args, 2);
+    assert(vm.get_stack().top_as_int() == 45);
+}
+
+TEST(bound_external_function) {
+    std::vector<ExternalFunction> external_functions = {
+        bind_external("digits", +[](int a, int b, int c) {
+            return a * 100 + b * 10 + c;
+        }),
+        bind_external("length", +[](std::string_view value) {
+            return static_cast<int>(value.size());
+        })
+    };
+
+    CompilationResults compilation = compile(
+        "void main() {"
+        "    int x = digits(1, 2, 3);"
+        "    int y = length(\"four\");"
+        "}",
+        external_functions
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    ByteCodeVm vm(compilation.program);
+    vm.execute();
+
+    ByteCodeVmState state = vm.get_state();
+    assert(std::get<int>(state.variables.at("x").second) == 123);
+    assert(std::get<int>(state.variables.at("y").second) == 4);
+    assert(state.stack.size() == 0);
+}
+
+TEST(bound_external_function_returns_its_argument) {
+    std::vector<ExternalFunction> external_functions = {
+        bind_external("identity", +[](std::string_view value) {
+            return value;
+        })
+    };
+
+    // The argument is a temporary the call holds the only reference to
+    CompilationResults compilation = compile(
+        "void main(string name) {"
+        "    string text = identity(name + \" and a suffix long enough to need a buffer\");"
+        "}",
+        external_functions
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    ByteCodeVm vm(compilation.program);
+    vm.rerun(std::string_view("a name"));
+
+    ByteCodeVmState state = vm.get_state();
+    const VmString& text = std::get<VmString>(state.variables.at("text").second);
+    assert(text.view() == "a name and a suffix long enough to need a buffer");
+    assert(state.stack.size() == 0);
+}
+
+TEST(bound_vm_string_shares_the_vms_buffer) {
+    VmMemory memory;
+    ByteStack stack(&memory);
+    stack.push_string("a string in the vm's memory");
+
+    VmString shared = NativeType<VmString>::read(stack, 0);
+    assert(shared.get_buffer() == stack.top_as_vm_string().get_buffer());
+
+    stack.pop();
+    assert(shared.view() == "a string in the vm's memory");
+}
+
+TEST(pooled_vm_reruns) {
+    CompilationResults compilation = compile(
+        "void main(int x) {"
+        "    int y = x * 2;"
+        "}",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    const ByteCodeVm* first = nullptr;
+
+    for (int i = 0; i < 3; i++) {
+        PooledVm vm = VmPool::local().acquire(compilation.program);
+        
+        if (first) {
+            assert(first == &*vm);
+        }
+
+        first = &*vm;
+
+        vm->rerun(i);
+        assert(std::get<int>(vm->get_state().variables.at("y").second) == i * 2);
+    }
+
+    assert(VmPool::local().get_idle_count(compilation.program) == 1);
+    VmPool::local().forget(compilation.program);
+}
+
+TEST(recursive_calls_have_their_own_frame) {
+    TestResults test = test_run(
+        "int fib(int n) {"
+        "    if (n < 2) {"
+        "        return n;"
+        "    }"
+        "    return fib(n - 1) + fib(n - 2);"
+        "}"
+        ""
+        "void main() {"
+        "    int x = fib(10);"
+        "}"
+    );
+
+    assert(test.compilation.error.type == CompilationErrorType::NONE);
+    assert(std::get<int>(test.execution.variables.at("x").second) == 55);
+}
+
+TEST(fibers_share_an_engine) {
+    CompilationResults compilation = compile(
+        "int square(int x) {"
+        "    return x * x;"
+        "}"
+        ""
+        "void main() {}",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    Engine engine(compilation.program);
+    std::optional<FunctionHandle> square = engine.resolve_function("square");
+    assert(square.has_value());
+
+    std::vector<Fiber> fibers;
+    for (int i = 0; i < 8; i++) {
+        fibers.push_back(engine.create_fiber());
+    }
+
+    for (int i = 0; i < 8; i++) {
+        engine.call_function(fibers.at(i), square.value(), i);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        assert(fibers.at(i).stack.top_as_int() == i * i);
+    }
+}
+
+TEST(job_system_runs_batch) {
+    std::vector<ExternalFunction> external_functions = {
+        bind_external("host_add", +[](int a, int b) {
+            return a + b;
+        })
+    };
+
+    CompilationResults compilation = compile(
+        "int work(int x) {"
+        "    return host_add(x, x * x);"
+        "}"
+        ""
+        "void main() {}",
+        external_functions
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    Engine engine(compilation.program);
+    std::optional<FunctionHandle> work = engine.resolve_function("work");
+    assert(work.has_value());
+
+    std::vector<ScriptJob> jobs(64);
+    for (int i = 0; i < 64; i++) {
+        jobs.at(i).engine = &engine;
+        jobs.at(i).function = work.value();
+        jobs.at(i).args = { i };
+    }
+
+    JobSystem job_system(4);
+    job_system.run(jobs);
+
+    for (int i = 0; i < 64; i++) {
+        assert(jobs.at(i).status == ScriptJobStatus::COMPLETED);
+        assert(jobs.at(i).fiber.stack.top_as_int() == i + i * i);
+    }
+}
+
+TEST(yield_suspends_and_resumes) {
+    CompilationResults compilation = compile(
+        "void main() {"
+        "    int x = 0;"
+        "    while (x < 3) {"
+        "        x = x + 1;"
+        "        yield;"
+        "    }"
+        "}",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    ByteCodeVm vm(compilation.program);
+
+    for (int i = 1; i <= 3; i++) {
+        assert(vm.resume() == ExecutionStatus::YIELDED);
+        assert(std::get<int>(vm.get_state().variables.at("x").second) == i);
+    }
+
+    assert(vm.resume() == ExecutionStatus::COMPLETED);
+}
+
+TEST(host_call_stops_at_yield_and_halt) {
+    static ByteCodeVm* running = nullptr;
+    static int after_stop_count = 0;
+
+    std::vector<ExternalFunction> external_functions = {
+        bind_external("stop", +[]() {
+            running->halt();
+        }),
+        bind_external("after_stop", +[]() {
+            after_stop_count++;
+        })
+    };
+
+    CompilationResults compilation = compile(
+        "int step(int x) {"
+        "    yield;"
+        "    return x + 1;"
+        "}"
+        ""
+        "void stop_early() {"
+        "    stop();"
+        "    after_stop();"
+        "}"
+        ""
+        "void main() {"
+        "}",
+        external_functions
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    ByteCodeVm vm(compilation.program);
+    running = &vm;
+    vm.execute();
+
+    // The yield stops the call, resuming finishes it
+    std::optional<FunctionHandle> step = compilation.program.resolve_function("step");
+    assert(vm.call_function(step.value(), 1) == ExecutionStatus::YIELDED);
+    assert(vm.resume() == ExecutionStatus::COMPLETED);
+    assert(vm.get_stack().top_as_int() == 2);
+    vm.get_stack().pop();
+
+    // Halting from the host leaves the call's frame behind, which isn't run any further
+    std::optional<FunctionHandle> stop_early = compilation.program.resolve_function("stop_early");
+    assert(vm.call_function(stop_early.value()) == ExecutionStatus::COMPLETED);
+    assert(!vm.get_is_not_halted());
+    assert(after_stop_count == 0);
+}
+
+TEST(execute_for_stops_and_resumes) {
+    CompilationResults compilation = compile(
+        "void main() {"
+        "    int x = 0;"
+        "    while (x < 100) {"
+        "        x = x + 1;"
+        "    }"
+        "}",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    ByteCodeVm vm(compilation.program);
+
+    size_t slices = 0;
+    while (vm.execute_for(16) == ExecutionStatus::OUT_OF_FUEL) {
+        slices++;
+    }
+
+    assert(slices > 1);
+    assert(std::get<int>(vm.get_state().variables.at("x").second) == 100);
+}
+
+TEST(struct_fields_are_flattened) {
+    TestResults test = test_run(
+        "struct Vec2 {"
+        "    int x;"
+        "    int y;"
+        "}"
+        ""
+        "struct Line {"
+        "    Vec2 a;"
+        "    Vec2 b;"
+        "}"
+        ""
+        "int length_x(Line line) {"
+        "    Vec2 a = line.a;"
+        "    Vec2 b = line.b;"
+        "    return b.x - a.x;"
+        "}"
+        ""
+        "void main() {"
+        "    Vec2 a = Vec2 { x = 1; y = 2; };"
+        "    Line line = Line { a = a; b = Vec2 { x = 5; }; };"
+        "    line.a = Vec2 { x = 2; y = 3; };"
+        "    int x = length_x(line);"
+        "}"
+    );
+
+    assert(test.compilation.error.type == CompilationErrorType::NONE);
+    assert(std::get<int>(test.execution.variables.at("x").second) == 3);
+    assert(std::get<int>(test.execution.variables.at("line.a.y").second) == 3);
+    assert(std::get<int>(test.execution.variables.at("line.b.y").second) == 0);
+}
+
+TEST(array_loop_skips_bounds_checks) {
+    CompilationResults compilation = compile(
+        "struct Particle {"
+        "    float x;"
+        "    float v;"
+        "}"
+        ""
+        "int sum(int[] values) {"
+        "    int total = 0;"
+        "    int i = 0;"
+        "    while (i < len(values)) {"
+        "        total = total + values[i];"
+        "        values[i] = 0;"
+        "        i = i + 1;"
+        "    }"
+        "    return total;"
+        "}"
+        ""
+        "void step(Particle[] particles, int i) {"
+        "    Particle p = particles[i];"
+        "    p.x = p.x + p.v;"
+        "    particles[i] = p;"
+        "}"
+        ""
+        "void main() {}",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    size_t checked_count = 0;
+    size_t unchecked_count = 0;
+
+    for (const ByteCodeOp& op : compilation.program.operations) {
+        checked_count += op.type == OpType::PUSH_INDEX || op.type == OpType::STORE_INDEX;
+        unchecked_count += op.type == OpType::PUSH_INDEX_UNCHECKED || op.type == OpType::STORE_INDEX_UNCHECKED;
+    }
+
+    // Only the loop in sum is proven in bounds
+    assert(unchecked_count == 2);
+    assert(checked_count == 2);
+
+    ByteCodeVm vm(compilation.program);
+
+    int values[] = { 1, 2, 3, 4 };
+    vm.call_function(compilation.program.resolve_function("sum").value(), make_array_view(values, 4));
+    assert(vm.get_stack().top_as_int() == 10);
+    assert(values[3] == 0);
+    vm.get_stack().pop();
+
+    struct Particle { float x; float v; };
+    Particle particles[] = { { 1.0f, 0.5f }, { 2.0f, 1.0f } };
+    Type particle = compilation.program.find_object_type("Particle").value();
+
+    vm.call_function(compilation.program.resolve_function("step").value(), ArrayView { particle, particles, 2 }, 1);
+    assert(particles[1].x == 3.0f);
+    assert(particles[0].x == 1.0f);
+}
+
+TEST(vector_math) {
+    TestResults test = test_run(
+        "float3 reflect(float3 v, float3 n) {"
+        "    return v - n * (2.0 * dot(v, n));"
+        "}"
+        ""
+        "void main() {"
+        "    float3 v = reflect(float3(1.0, -1.0, 0.0), float3(0.0, 1.0, 0.0));"
+        "    v.z = length(float3(3.0, 4.0, 0.0));"
+        "    float2 flat = v.zx;"
+        "    int4 counts = int4(1, 2, 3, 4) * 2;"
+        "    int sum = dot(counts, int4(1, 1, 1, 1));"
+        "    bool same = v == float3(1.0, 1.0, 5.0);"
+        "}"
+    );
+
+    assert(test.compilation.error.type == CompilationErrorType::NONE);
+
+    const FloatVector& flat = std::get<FloatVector>(test.execution.variables.at("flat").second);
+    assert(flat.type == Type::FLOAT2);
+    assert(flat.lanes[0] == 5.0f && flat.lanes[1] == 1.0f);
+
+    assert(std::get<int>(test.execution.variables.at("sum").second) == 20);
+    assert(std::get<bool>(test.execution.variables.at("same").second));
+}
+
+TEST(batch_matches_scalar_calls) {
+    CompilationResults compilation = compile(
+        "float damp(float x, int steps) {"
+        "    float s = x;"
+        ""
+        "    if (x < 0.0) {"
+        "        s = 0.0 - x;"
+        "    }"
+        ""
+        "    int i = 0;"
+        "    while (i < steps) {"
+        "        s = s * 0.5;"
+        "        i = i + 1;"
+        "    }"
+        ""
+        "    return s;"
+        "}"
+        ""
+        "void main() {}",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    ByteCodeVm vm(compilation.program);
+    std::optional<FunctionHandle> damp = vm.get_engine().resolve_function("damp");
+    assert(damp.has_value());
+
+    std::vector<float> xs;
+    std::vector<int> steps;
+    for (int i = 0; i < 3000; i++) {
+        xs.push_back(float(i % 37) - 18.0f);
+        steps.push_back(i % 5);
+    }
+
+    BatchExecutor batch(vm.get_engine());
+    assert(batch.can_execute(damp.value()));
+
+    BatchColumn result;
+    assert(batch.execute(damp.value(), { BatchColumn::from_floats(xs), BatchColumn::from_ints(steps) }, result));
+
+    for (size_t i = 0; i < xs.size(); i++) {
+        vm.call_function(damp.value(), xs.at(i), steps.at(i));
+        assert(vm.get_stack().top_as_float() == result.get_float(i));
+        vm.get_stack().pop();
+    }
+}
+
+TEST(strings_share_their_buffer) {
+    TestResults test = test_run(
+        "string relay(string s) {"
+        "    return s;"
+        "}"
+        ""
+        "void main() {"
+        "    string a = \"hello\";"
+        "    string b = relay(a);"
+        "    bool same = a == b;"
+        "}"
+    );
+
+    assert(test.compilation.error.type == CompilationErrorType::NONE);
+
+    const VmString& a = std::get<VmString>(test.execution.variables.at("a").second);
+    const VmString& b = std::get<VmString>(test.execution.variables.at("b").second);
+
+    assert(b.view() == "hello");
+    assert(a.get_buffer() == b.get_buffer());
+    assert(std::get<bool>(test.execution.variables.at("same").second));
+}
+
+TEST(strings_concatenate_and_append) {
+    TestResults test = test_run(
+        "void main() {"
+        "    string greeting = \"hello\" + \" \" + \"world\";"
+        ""
+        "    string log = \"\";"
+        "    int i = 0;"
+        "    while (i < 3) {"
+        "        append(log, i);"
+        "        append(log, \",\");"
+        "        i = i + 1;"
+        "    }"
+        "    append(log, true);"
+        "}"
+    );
+
+    assert(test.compilation.error.type == CompilationErrorType::NONE);
+    assert(std::get<VmString>(test.execution.variables.at("greeting").second).view() == "hello world");
+    assert(std::get<VmString>(test.execution.variables.at("log").second).view() == "0,1,2,true");
+}
+
+TEST(vm_memory_comes_from_upstream) {
+    std::vector<ExternalFunction> external_functions = {
+        bind_external("name", +[]() {
+            return std::string_view("a name long enough to need a buffer");
+        })
+    };
+
+    CompilationResults compilation = compile(
+        "void main(string greeting) {"
+        "    string message = greeting + \", \" + name();"
+        "    append(message, 42);"
+        "}",
+        external_functions
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    // Anything the vm allocates beyond this buffer throws
+    static char buffer[256 * 1024];
+    std::pmr::monotonic_buffer_resource upstream(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+    ByteCodeVmState state;
+    {
+        ByteCodeVm vm(compilation.program, &upstream);
+
+        for (int i = 0; i < 10; i++) {
+            vm.rerun(std::string_view("hello there"));
+        }
+
+        VmMemoryStats stats = vm.get_memory_stats();
+        assert(stats.bytes_live > 0);
+        assert(stats.bytes_peak >= stats.bytes_live);
+        assert(stats.bytes_reserved >= stats.bytes_live);
+        assert(stats.allocation_count > 0);
+
+        state = vm.get_state();
+    }
+
+    // The state's strings outlive the vm and its memory
+    const VmString& message = std::get<VmString>(state.variables.at("message").second);
+    assert(message.view() == "hello there, a name long enough to need a buffer42");
+}
+
+TEST(profiler_counts_functions_and_lines) {
+    CompilationResults compilation = compile(
+        "int square(int x) {\n"
+        "    return x * x;\n"
+        "}\n"
+        "\n"
+        "void main() {\n"
+        "    int total = 0;\n"
+        "    int i = 0;\n"
+        "    while (i < 10) {\n"
+        "        total = total + square(i);\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "}\n",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    const Program& program = compilation.program;
+    assert(program.source_lines.size() == program.operations.size());
+
+    ByteCodeVm vm(program);
+    vm.set_profiling(true);
+    vm.execute();
+    vm.set_profiling(false);
+
+    const Profiler& profiler = *vm.get_profiler();
+    const FunctionProfile& square_function = profiler.get_function(program.find_function("square")->function_index);
+    const FunctionProfile& main_function = profiler.get_function(program.find_function("main")->function_index);
+
+    assert(square_function.call_count == 10);
+    assert(main_function.call_count == 1);
+    assert(square_function.inclusive_cycles == square_function.self_cycles);
+    assert(main_function.inclusive_cycles == profiler.get_total_cycles());
+    assert(main_function.self_cycles + square_function.self_cycles == profiler.get_total_cycles());
+    assert(profiler.get_op_type(OpType::CALL_FUNCTION).count == 10);
+
+    for (size_t i = 0; i < program.operations.size(); i++) {
+        if (program.operations.at(i).type == OpType::CALL_FUNCTION) {
+            assert(program.source_lines.at(i) == 9);
+            assert(profiler.get_instruction(i).count == 10);
+        }
+    }
+}
+
+TEST(sampling_profiler_writes_folded_stacks) {
+    CompilationResults compilation = compile(
+        "int work(int n) {"
+        "    int total = 0;"
+        "    int i = 0;"
+        "    while (i < n) {"
+        "        total = total + i;"
+        "        i = i + 1;"
+        "    }"
+        "    return total;"
+        "}"
+        ""
+        "void main() {"
+        "    int x = work(20000);"
+        "}",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    ByteCodeVm vm(compilation.program);
+
+    SamplingProfiler sampler(compilation.program, std::chrono::microseconds(100));
+    sampler.attach(vm.get_fiber());
+    sampler.start();
+
+    for (int i = 0; i < 10 || (i < 1000 && sampler.get_sample_count() == 0); i++) {
+        vm.reset();
+        vm.execute();
+    }
+
+    sampler.stop();
+    sampler.detach(vm.get_fiber());
+
+    std::ostringstream folded;
+    sampler.write_folded(folded);
+    assert(sampler.get_sample_count() > 0);
+    assert(folded.str().find("main;work ") != std::string::npos);
+}
+
+TEST(op_histogram_counts_sequences) {
+    CompilationResults compilation = compile(
+        "void main() {"
+        "    int i = 0;"
+        "    while (i < 100) {"
+        "        i = i + 1;"
+        "    }"
+        "}",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    ByteCodeVm vm(compilation.program);
+
+    OpHistogram histogram;
+    histogram.add_static(vm.get_engine());
+
+    vm.set_op_hook(&histogram);
+    vm.execute();
+    vm.set_op_hook(nullptr);
+
+    // One run of n operations has n - 1 pairs and n - 2 trigrams
+    assert(histogram.get_dynamic_total(2) == histogram.get_dynamic_total(3) + 1);
+
+    std::vector<OpSequenceCount> pairs = histogram.get_ranked(2);
+    assert(pairs.front().dynamic_count >= 100);
+
+    bool found_loop_test = false;
+
+    for (const OpSequenceCount& pair : pairs) {
+        if (pair.ops[0] == OpType::LESS_THAN_INT && pair.ops[1] == OpType::JUMP_IF_FALSE) {
+            assert(pair.dynamic_count == 101);
+            assert(pair.static_count == 1);
+            found_loop_test = true;
+        }
+    }
+
+    assert(found_loop_test);
+}
+
+TEST(compilation_stats_count_phases) {
+    const char* text =
+        "int add(int x, int y) {"
+        "    return x + y;"
+        "}"
+        ""
+        "void main() {"
+        "    int x = add(1, 2);"
+        "}";
+
+    assert(!compile(text, {}).stats.has_value());
+
+    set_compilation_allocation_counter(get_heap_allocation_count);
+    CompilationResults compilation = compile(text, {}, true);
+    set_compilation_allocation_counter(nullptr);
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+    assert(compilation.stats.has_value());
+
+    const CompilationStats& stats = compilation.stats.value();
+    assert(stats.token_count > 0);
+    assert(stats.parse_tree_node_count > stats.token_count);
+    assert(stats.instruction_count == compilation.program.operations.size());
+    assert(stats.lexing.allocation_count > 0);
+    assert(stats.parsing.allocation_count > 0);
+    assert(stats.code_generation.allocation_count > 0);
+}
+
+TEST(hardware_counters_count_script_functions) {
+    CompilationResults compilation = compile(
+        "int add(int x, int y) {"
+        "    return x + y;"
+        "}"
+        ""
+        "void main() {"
+        "    int x = add(1, 2);"
+        "}",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    ByteCodeVm vm(compilation.program);
+    bool counting = vm.set_hardware_counting(true);
+
+    vm.execute();
+
+    std::optional<FunctionHandle> add = compilation.program.resolve_function("add");
+    vm.call_function(add.value(), 3, 4);
+    assert(vm.get_stack().top_as_int() == 7);
+    vm.get_stack().pop();
+
+    // Without counters the vm runs the same and has nothing to report
+    if (!counting) {
+        assert(vm.get_hardware_counters() == nullptr);
+        return;
+    }
+
+    const HardwareCounterProfile& counters = *vm.get_hardware_counters();
+    std::optional<FunctionHandle> main_function = compilation.program.resolve_function("main");
+
+    assert(counters.get_function(main_function.value().function_index).invocation_count == 1);
+    assert(counters.get_function(add.value().function_index).invocation_count == 1);
+
+    if (counters.is_available(HardwareEvent::INSTRUCTIONS)) {
+        assert(counters.get_total().get(HardwareEvent::INSTRUCTIONS) > 0);
+    }
+}
+
+TEST(tracer_writes_chrome_trace) {
+    std::vector<ExternalFunction> external_functions = {
+        bind_external("twice", +[](int x) {
+            return x * 2;
+        })
+    };
+
+    CompilationResults compilation = compile(
+        "int add(int x, int y) {"
+        "    return x + y;"
+        "}"
+        ""
+        "void main() {"
+        "    int x = add(1, 2);"
+        "    x = twice(x);"
+        "    yield;"
+        "    x = add(x, 3);"
+        "}",
+        external_functions
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    const char* path = "tracer_test.json";
+    {
+        ByteCodeVm vm(compilation.program);
+        Tracer tracer(compilation.program, path, TraceFormat::CHROME_JSON);
+        assert(tracer.is_open());
+
+        tracer.attach(vm.get_fiber());
+        tracer.start();
+
+        assert(vm.execute() == ExecutionStatus::YIELDED);
+        vm.resume();
+
+        tracer.detach(vm.get_fiber());
+        tracer.stop();
+        assert(tracer.get_dropped_count() == 0);
+    }
+
+    std::ifstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    file.close();
+    std::remove(path);
+
+    std::string text = buffer.str();
+
+    auto count = [&](std::string_view needle) {
+        size_t found = 0;
+        for (size_t i = text.find(needle); i != std::string::npos; i = text.find(needle, i + 1)) {
+            found++;
+        }
+        return found;
+    };
+
+    assert(count("{\"name\":\"main\",\"ph\":\"B\"") == 1);
+    assert(count("{\"name\":\"main\",\"ph\":\"E\"") == 1);
+    assert(count("{\"name\":\"add\",\"ph\":\"B\"") == 2);
+    assert(count("{\"name\":\"add\",\"ph\":\"E\"") == 2);
+    assert(count("{\"name\":\"twice\",\"ph\":\"B\"") == 1);
+    assert(count("{\"name\":\"yield\",\"ph\":\"i\"") == 1);
+    assert(text.back() == '\n');
+}
+
+TEST(debugger_stops_on_conditional_breakpoint) {
+    CompilationResults compilation = compile(
+        "void main() {\n"
+        "    int i = 0;\n"
+        "    int total = 0;\n"
+        "    while (i < 10) {\n"
+        "        total = total + i;\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "}\n",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    const std::vector<size_t>& lines = compilation.program.source_lines;
+    size_t loop_body = std::find(lines.begin(), lines.end(), 5) - lines.begin();
+    assert(loop_body < lines.size());
+
+    ByteCodeVm vm(compilation.program);
+    ByteCodeVmDebugger debugger(vm);
+
+    assert(!debugger.breakpoint_add(loop_body, "missing == 7"));
+    assert(debugger.breakpoint_add(loop_body, "i == 7"));
+
+    debugger.breakpoint_continue();
+    assert(debugger.get_breakpoint_hit());
+    assert(vm.get_program_counter() == loop_body);
+
+    ByteCodeVmState state = vm.get_state();
+    assert(std::get<int>(state.variables.at("i").second) == 7);
+    assert(std::get<int>(state.variables.at("total").second) == 21);
+
+    debugger.breakpoint_continue();
+    assert(!debugger.get_breakpoint_hit());
+    assert(!vm.get_is_not_halted());
+    assert(std::get<int>(vm.get_state().variables.at("total").second) == 45);
+}
+
+TEST(debugger_stops_at_watched_field_store) {
+    CompilationResults compilation = compile(
+        "struct Vec2 {\n"
+        "    int x;\n"
+        "    int y;\n"
+        "}\n"
+        "void main() {\n"
+        "    Vec2 p = Vec2 { x = 1; y = 2; };\n"
+        "    int i = 0;\n"
+        "    while (i < 3) {\n"
+        "        p.y = p.y + i;\n"
+        "        p.x = i;\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "}\n",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    ByteCodeVm vm(compilation.program);
+    ByteCodeVmDebugger debugger(vm);
+
+    assert(!debugger.watchpoint_add("main", "q"));
+    assert(debugger.watchpoint_add("main", "p.y"));
+
+    // Only the stores to p.y stop, the initializer's and one per iteration. The
+    // last one in the loop adds 2 to 3.
+    std::vector<WatchpointHit> hits;
+
+    while (vm.get_is_not_halted()) {
+        debugger.breakpoint_continue();
+
+        if (debugger.get_watchpoint_hit().has_value()) {
+            hits.push_back(debugger.get_watchpoint_hit().value());
+            assert(vm.get_program_counter() == hits.back().code_index + 1);
+        }
+    }
+
+    assert(hits.size() == 4);
+
+    for (const WatchpointHit& hit : hits) {
+        assert(hit.variable == "p.y");
+    }
+
+    const WatchpointHit& first = hits.front();
+    assert(compilation.program.source_lines.at(first.code_index) == 6);
+    assert(first.old_value.first == Type::VOID);
+    assert(std::get<int>(first.new_value.second) == 2);
+
+    const WatchpointHit& last = hits.back();
+    assert(compilation.program.source_lines.at(last.code_index) == 9);
+    assert(std::get<int>(last.old_value.second) == 3);
+    assert(std::get<int>(last.new_value.second) == 5);
+}
+
+TEST(replay_reproduces_external_results) {
+    static int roll_count = 0;
+
+    std::vector<ExternalFunction> external_functions = {
+        bind_external("roll", +[](int sides) {
+            roll_count++;
+            return roll_count * 7 % sides;
+        }),
+        bind_external("name", +[]() {
+            return std::string_view(roll_count > 4 ? "late" : "early");
+        })
+    };
+
+    CompilationResults compilation = compile(
+        "state { int total = 0; }"
+        ""
+        "void main(int rounds) {"
+        "    total = 0;"
+        "    int i = 0;"
+        "    while (i < rounds) {"
+        "        total = total + roll(6);"
+        "        i = i + 1;"
+        "    }"
+        "    string who = name();"
+        "}",
+        external_functions
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    ExecutionLog log(compilation.program);
+    ByteCodeVm vm(compilation.program);
+    vm.set_main_args({ { Type::INT, 5 } });
+
+    log.begin_recording(vm.get_fiber());
+    vm.execute();
+    log.end(vm.get_fiber());
+
+    ByteCodeVmState recorded = vm.get_state();
+    assert(roll_count == 5);
+    assert(log.save("replay_test.slreplay"));
+
+    // The replay starts from the recorded arguments and never calls the host
+    ExecutionLog loaded(compilation.program);
+    assert(loaded.load("replay_test.slreplay"));
+    std::remove("replay_test.slreplay");
+
+    ByteCodeVm replay_vm(compilation.program);
+    loaded.begin_replay(replay_vm.get_fiber());
+    replay_vm.execute();
+    loaded.end(replay_vm.get_fiber());
+
+    ByteCodeVmState replayed = replay_vm.get_state();
+    assert(roll_count == 5);
+    assert(loaded.is_replay_finished());
+    assert(std::get<int>(replayed.variables.at("total").second) == std::get<int>(recorded.variables.at("total").second));
+    assert(std::get<VmString>(replayed.variables.at("who").second).view() == "late");
+}
+
+TEST(replay_that_goes_differently_halts) {
+    std::vector<ExternalFunction> external_functions = {
+        bind_external("roll", +[](int sides) {
+            return sides - 1;
+        }),
+        bind_external("name", +[]() {
+            return std::string_view("host");
+        })
+    };
+
+    CompilationResults recorded = compile(
+        "void main() {"
+        "    int x = roll(6);"
+        "}",
+        external_functions
+    );
+
+    CompilationResults changed = compile(
+        "void main() {"
+        "    string who = name();"
+        "    int x = roll(6);"
+        "}",
+        external_functions
+    );
+
+    assert(recorded.error.type == CompilationErrorType::NONE);
+    assert(changed.error.type == CompilationErrorType::NONE);
+
+    ExecutionLog log(recorded.program);
+    ByteCodeVm vm(recorded.program);
+    assert(log.begin_recording(vm.get_fiber()));
+    vm.execute();
+    log.end(vm.get_fiber());
+    assert(log.get_error() == nullptr);
+
+    // The changed script calls name() where roll() was recorded, which stops it there
+    ByteCodeVm replay_vm(changed.program);
+    assert(log.begin_replay(replay_vm.get_fiber()));
+    assert(replay_vm.execute() == ExecutionStatus::COMPLETED);
+    log.end(replay_vm.get_fiber());
+
+    assert(!replay_vm.get_is_not_halted());
+    assert(log.get_error() != nullptr);
+    assert(!log.is_replay_finished());
+    assert(replay_vm.get_state().variables.count("x") == 0);
+}
+
+TEST(checkpoint_restores_and_forks) {
+    CompilationResults compilation = compile(
+        "state { string log = \"\"; }"
+        ""
+        "void main() {"
+        "    log = \"\";"
+        "    int x = 0;"
+        "    while (x < 4) {"
+        "        append(log, x);"
+        "        x = x + 1;"
+        "        yield;"
+        "    }"
+        "}",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    auto get_log = [](ByteCodeVm& vm) {
+        return std::string(std::get<VmString>(vm.get_state().variables.at("log").second).view());
+    };
+
+    ByteCodeVm vm(compilation.program);
+    vm.execute();
+    vm.resume();
+    assert(get_log(vm) == "01");
+
+    FiberCheckpoint checkpoint;
+    vm.checkpoint(checkpoint);
+    std::unique_ptr<ByteCodeVm> fork = vm.fork();
+
+    while (vm.resume() == ExecutionStatus::YIELDED) {}
+    assert(get_log(vm) == "0123");
+
+    // The fork carries on from where it was taken, the log it shares isn't changed
+    assert(get_log(*fork) == "01");
+    assert(fork->resume() == ExecutionStatus::YIELDED);
+    assert(get_log(*fork) == "012");
+
+    vm.restore(checkpoint);
+    assert(get_log(vm) == "01");
+    assert(std::get<int>(vm.get_state().variables.at("x").second) == 2);
+
+    while (vm.resume() == ExecutionStatus::YIELDED) {}
+    assert(get_log(vm) == "0123");
+    assert(!vm.get_is_not_halted());
+}
+
+TEST(sibling_blocks_redeclare_with_the_same_slot_count) {
+    TestResults different = test_run(
+        "struct Small {"
+        "    int a;"
+        "}"
+        ""
+        "struct Big {"
+        "    int a;"
+        "    int b;"
+        "    int c;"
+        "}"
+        ""
+        "void main() {"
+        "    int after = 7;"
+        "    if (true) {"
+        "        Small p = Small { a = 1; };"
+        "    }"
+        "    if (true) {"
+        "        Big p = Big { a = 1; b = 2; c = 3; };"
+        "    }"
+        "}"
+    );
+
+    assert(different.compilation.error.type == CompilationErrorType::IDENTIFIED_ALREADY_DECLARED);
+
+    TestResults same = test_run(
+        "struct Big {"
+        "    int a;"
+        "    int b;"
+        "    int c;"
+        "}"
+        ""
+        "void main() {"
+        "    if (true) {"
+        "        Big p = Big { a = 1; b = 2; c = 3; };"
+        "    }"
+        "    int after = 7;"
+        "    if (true) {"
+        "        Big p = Big { a = 4; b = 5; c = 6; };"
+        "    }"
+        "}"
+    );
+
+    assert(same.compilation.error.type == CompilationErrorType::NONE);
+    assert(std::get<int>(same.execution.variables.at("p.c").second) == 6);
+    assert(std::get<int>(same.execution.variables.at("after").second) == 7);
+
+    TestResults scalars = test_run(
+        "void main() {"
+        "    if (true) {"
+        "        int x = 1;"
+        "    }"
+        "    if (true) {"
+        "        float x = 2.5;"
+        "    }"
+        "}"
+    );
+
+    assert(scalars.compilation.error.type == CompilationErrorType::NONE);
+    assert(scalars.execution.variables.at("x").first == Type::FLOAT);
+    assert(std::get<float>(scalars.execution.variables.at("x").second) == 2.5f);
+}
+
+TEST(yielding_fiber_releases_its_arena) {
+    CompilationResults compilation = compile(
+        "void main() {"
+        "    string text = \"\";"
+        "    int i = 0;"
+        "    while (i < 500) {"
+        "        text = text + \"x\";"
+        "        i = i + 1;"
+        "        yield;"
+        "    }"
+        "}",
+        {}
+    );
+
+    assert(compilation.error.type == CompilationErrorType::NONE);
+
+    ByteCodeVm vm(compilation.program);
+    size_t max_reserved = 0;
+
+    while (vm.resume() == ExecutionStatus::YIELDED) {
+        max_reserved = std::max(max_reserved, vm.get_fiber().arena.get_bytes_reserved());
+        assert(vm.get_fiber().arena.is_empty());
+    }
+
+    // Without releasing between slices the concats add up to over 100KB
+    assert(max_reserved <= 16 * 1024);
+    assert(std::get<VmString>(vm.get_state().variables.at("text").second).size() == 500);
+}
+
 void run_tests() {
     for (const Test& test : tests) {
         printf("Test %s\n", test.name.data());
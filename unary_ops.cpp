@@ -23,7 +23,12 @@ static const std::unordered_map<UnaryOpMapIn, UnaryOpMapOut, InHash> s_valid = {
     // Right        Operator                    Operation              Result Type
     {{Type::BOOL,   UnaryOperatorType::NOT},    {OpType::NOT_BOOL,     Type::BOOL}},
     {{Type::INT,    UnaryOperatorType::NEGATE}, {OpType::NEGATE_INT,   Type::INT}},
-    {{Type::FLOAT,  UnaryOperatorType::NEGATE}, {OpType::NEGATE_FLOAT, Type::FLOAT}}
+    {{Type::FLOAT,  UnaryOperatorType::NEGATE}, {OpType::NEGATE_FLOAT, Type::FLOAT}},
+    {{Type::INT2,   UnaryOperatorType::NEGATE}, {OpType::NEGATE_INT_VECTOR,   Type::INT2}},
+    {{Type::INT4,   UnaryOperatorType::NEGATE}, {OpType::NEGATE_INT_VECTOR,   Type::INT4}},
+    {{Type::FLOAT2, UnaryOperatorType::NEGATE}, {OpType::NEGATE_FLOAT_VECTOR, Type::FLOAT2}},
+    {{Type::FLOAT3, UnaryOperatorType::NEGATE}, {OpType::NEGATE_FLOAT_VECTOR, Type::FLOAT3}},
+    {{Type::FLOAT4, UnaryOperatorType::NEGATE}, {OpType::NEGATE_FLOAT_VECTOR, Type::FLOAT4}}
 }; 
 
 std::optional<UnaryOpMapOut> map_unary_op(Type right_type, UnaryOperatorType op) {
@@ -0,0 +1,356 @@
+#pragma once
+
+#include "byte_code_types.h"
+
+#include <cmath>
+
+// The vector opcodes, each one is a single SIMD operation over all four lanes where the
+// target has one. Lanes past a type's width are zero on the way in and stay zero on the
+// way out, so they never affect comparisons or dot products.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define SIMPLE_LANG_SSE2
+    #include <emmintrin.h>
+
+    #if defined(__SSE4_1__) || defined(__AVX__)
+        #define SIMPLE_LANG_SSE41
+        #include <smmintrin.h>
+    #endif
+#elif defined(__ARM_NEON)
+    #define SIMPLE_LANG_NEON
+    #include <arm_neon.h>
+#endif
+
+inline void vector_clear_unused_lanes(FloatVector& vector) {
+    for (size_t i = vector_width(vector.type); i < 4; i++) {
+        vector.lanes[i] = 0.0f;
+    }
+}
+
+#if defined(SIMPLE_LANG_SSE2)
+
+inline __m128 vector_load(const FloatVector& vector) {
+    return _mm_loadu_ps(vector.lanes);
+}
+
+inline __m128i vector_load(const IntVector& vector) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(vector.lanes));
+}
+
+inline FloatVector vector_store(Type type, __m128 value) {
+    FloatVector result;
+    result.type = type;
+    _mm_storeu_ps(result.lanes, value);
+    return result;
+}
+
+inline IntVector vector_store(Type type, __m128i value) {
+    IntVector result;
+    result.type = type;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(result.lanes), value);
+    return result;
+}
+
+inline float vector_horizontal_sum(__m128 value) {
+    __m128 shuffled = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(value, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    sums = _mm_add_ss(sums, shuffled);
+    return _mm_cvtss_f32(sums);
+}
+
+inline FloatVector vector_add(const FloatVector& a, const FloatVector& b) {
+    return vector_store(a.type, _mm_add_ps(vector_load(a), vector_load(b)));
+}
+
+inline FloatVector vector_subtract(const FloatVector& a, const FloatVector& b) {
+    return vector_store(a.type, _mm_sub_ps(vector_load(a), vector_load(b)));
+}
+
+inline FloatVector vector_multiply(const FloatVector& a, const FloatVector& b) {
+    return vector_store(a.type, _mm_mul_ps(vector_load(a), vector_load(b)));
+}
+
+inline FloatVector vector_divide(const FloatVector& a, const FloatVector& b) {
+    FloatVector result = vector_store(a.type, _mm_div_ps(vector_load(a), vector_load(b)));
+    vector_clear_unused_lanes(result);
+    return result;
+}
+
+inline FloatVector vector_multiply(const FloatVector& a, float b) {
+    return vector_store(a.type, _mm_mul_ps(vector_load(a), _mm_set1_ps(b)));
+}
+
+inline FloatVector vector_divide(const FloatVector& a, float b) {
+    FloatVector result = vector_store(a.type, _mm_div_ps(vector_load(a), _mm_set1_ps(b)));
+    vector_clear_unused_lanes(result);
+    return result;
+}
+
+inline FloatVector vector_negate(const FloatVector& a) {
+    return vector_store(a.type, _mm_sub_ps(_mm_setzero_ps(), vector_load(a)));
+}
+
+inline bool vector_equals(const FloatVector& a, const FloatVector& b) {
+    return _mm_movemask_ps(_mm_cmpeq_ps(vector_load(a), vector_load(b))) == 0xF;
+}
+
+inline float vector_dot(const FloatVector& a, const FloatVector& b) {
+    return vector_horizontal_sum(_mm_mul_ps(vector_load(a), vector_load(b)));
+}
+
+inline IntVector vector_add(const IntVector& a, const IntVector& b) {
+    return vector_store(a.type, _mm_add_epi32(vector_load(a), vector_load(b)));
+}
+
+inline IntVector vector_subtract(const IntVector& a, const IntVector& b) {
+    return vector_store(a.type, _mm_sub_epi32(vector_load(a), vector_load(b)));
+}
+
+inline IntVector vector_negate(const IntVector& a) {
+    return vector_store(a.type, _mm_sub_epi32(_mm_setzero_si128(), vector_load(a)));
+}
+
+inline bool vector_equals(const IntVector& a, const IntVector& b) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(vector_load(a), vector_load(b))) == 0xFFFF;
+}
+
+#if defined(SIMPLE_LANG_SSE41)
+
+inline IntVector vector_multiply(const IntVector& a, const IntVector& b) {
+    return vector_store(a.type, _mm_mullo_epi32(vector_load(a), vector_load(b)));
+}
+
+inline IntVector vector_multiply(const IntVector& a, int b) {
+    return vector_store(a.type, _mm_mullo_epi32(vector_load(a), _mm_set1_epi32(b)));
+}
+
+#define SIMPLE_LANG_HAS_INT_VECTOR_MULTIPLY
+
+#endif
+
+#elif defined(SIMPLE_LANG_NEON)
+
+inline float32x4_t vector_load(const FloatVector& vector) {
+    return vld1q_f32(vector.lanes);
+}
+
+inline int32x4_t vector_load(const IntVector& vector) {
+    return vld1q_s32(vector.lanes);
+}
+
+inline FloatVector vector_store(Type type, float32x4_t value) {
+    FloatVector result;
+    result.type = type;
+    vst1q_f32(result.lanes, value);
+    return result;
+}
+
+inline IntVector vector_store(Type type, int32x4_t value) {
+    IntVector result;
+    result.type = type;
+    vst1q_s32(result.lanes, value);
+    return result;
+}
+
+inline float vector_horizontal_sum(float32x4_t value) {
+    float32x2_t sums = vadd_f32(vget_low_f32(value), vget_high_f32(value));
+    return vget_lane_f32(vpadd_f32(sums, sums), 0);
+}
+
+inline FloatVector vector_add(const FloatVector& a, const FloatVector& b) {
+    return vector_store(a.type, vaddq_f32(vector_load(a), vector_load(b)));
+}
+
+inline FloatVector vector_subtract(const FloatVector& a, const FloatVector& b) {
+    return vector_store(a.type, vsubq_f32(vector_load(a), vector_load(b)));
+}
+
+inline FloatVector vector_multiply(const FloatVector& a, const FloatVector& b) {
+    return vector_store(a.type, vmulq_f32(vector_load(a), vector_load(b)));
+}
+
+inline FloatVector vector_divide(const FloatVector& a, const FloatVector& b) {
+    FloatVector result;
+    result.type = a.type;
+
+    for (size_t i = 0; i < 4; i++) {
+        result.lanes[i] = a.lanes[i] / b.lanes[i];
+    }
+
+    vector_clear_unused_lanes(result);
+    return result;
+}
+
+inline FloatVector vector_multiply(const FloatVector& a, float b) {
+    return vector_store(a.type, vmulq_n_f32(vector_load(a), b));
+}
+
+inline FloatVector vector_divide(const FloatVector& a, float b) {
+    return vector_multiply(a, 1.0f / b);
+}
+
+inline FloatVector vector_negate(const FloatVector& a) {
+    return vector_store(a.type, vnegq_f32(vector_load(a)));
+}
+
+inline bool vector_equals(const FloatVector& a, const FloatVector& b) {
+    uint32x4_t equal = vceqq_f32(vector_load(a), vector_load(b));
+    uint32x2_t folded = vand_u32(vget_low_u32(equal), vget_high_u32(equal));
+    return (vget_lane_u32(folded, 0) & vget_lane_u32(folded, 1)) == 0xFFFFFFFF;
+}
+
+inline float vector_dot(const FloatVector& a, const FloatVector& b) {
+    return vector_horizontal_sum(vmulq_f32(vector_load(a), vector_load(b)));
+}
+
+inline IntVector vector_add(const IntVector& a, const IntVector& b) {
+    return vector_store(a.type, vaddq_s32(vector_load(a), vector_load(b)));
+}
+
+inline IntVector vector_subtract(const IntVector& a, const IntVector& b) {
+    return vector_store(a.type, vsubq_s32(vector_load(a), vector_load(b)));
+}
+
+inline IntVector vector_negate(const IntVector& a) {
+    return vector_store(a.type, vnegq_s32(vector_load(a)));
+}
+
+inline bool vector_equals(const IntVector& a, const IntVector& b) {
+    uint32x4_t equal = vceqq_s32(vector_load(a), vector_load(b));
+    uint32x2_t folded = vand_u32(vget_low_u32(equal), vget_high_u32(equal));
+    return (vget_lane_u32(folded, 0) & vget_lane_u32(folded, 1)) == 0xFFFFFFFF;
+}
+
+inline IntVector vector_multiply(const IntVector& a, const IntVector& b) {
+    return vector_store(a.type, vmulq_s32(vector_load(a), vector_load(b)));
+}
+
+inline IntVector vector_multiply(const IntVector& a, int b) {
+    return vector_store(a.type, vmulq_n_s32(vector_load(a), b));
+}
+
+#define SIMPLE_LANG_HAS_INT_VECTOR_MULTIPLY
+
+#else
+
+// Plain loops for targets without SIMD, the compiler can often still vectorize these
+
+template<typename Vector, typename Operation>
+inline Vector vector_lanewise(const Vector& a, const Vector& b, Operation operation) {
+    Vector result;
+    result.type = a.type;
+
+    for (size_t i = 0; i < 4; i++) {
+        result.lanes[i] = operation(a.lanes[i], b.lanes[i]);
+    }
+
+    return result;
+}
+
+inline FloatVector vector_add(const FloatVector& a, const FloatVector& b) {
+    return vector_lanewise(a, b, [](float x, float y) { return x + y; });
+}
+
+inline FloatVector vector_subtract(const FloatVector& a, const FloatVector& b) {
+    return vector_lanewise(a, b, [](float x, float y) { return x - y; });
+}
+
+inline FloatVector vector_multiply(const FloatVector& a, const FloatVector& b) {
+    return vector_lanewise(a, b, [](float x, float y) { return x * y; });
+}
+
+inline FloatVector vector_divide(const FloatVector& a, const FloatVector& b) {
+    FloatVector result = vector_lanewise(a, b, [](float x, float y) { return x / y; });
+    vector_clear_unused_lanes(result);
+    return result;
+}
+
+inline FloatVector vector_multiply(const FloatVector& a, float b) {
+    return vector_lanewise(a, a, [b](float x, float) { return x * b; });
+}
+
+inline FloatVector vector_divide(const FloatVector& a, float b) {
+    FloatVector result = vector_lanewise(a, a, [b](float x, float) { return x / b; });
+    vector_clear_unused_lanes(result);
+    return result;
+}
+
+inline FloatVector vector_negate(const FloatVector& a) {
+    return vector_lanewise(a, a, [](float x, float) { return -x; });
+}
+
+inline bool vector_equals(const FloatVector& a, const FloatVector& b) {
+    return std::equal(a.lanes, a.lanes + 4, b.lanes);
+}
+
+inline float vector_dot(const FloatVector& a, const FloatVector& b) {
+    return a.lanes[0] * b.lanes[0] + a.lanes[1] * b.lanes[1] + a.lanes[2] * b.lanes[2] + a.lanes[3] * b.lanes[3];
+}
+
+inline IntVector vector_add(const IntVector& a, const IntVector& b) {
+    return vector_lanewise(a, b, [](int x, int y) { return x + y; });
+}
+
+inline IntVector vector_subtract(const IntVector& a, const IntVector& b) {
+    return vector_lanewise(a, b, [](int x, int y) { return x - y; });
+}
+
+inline IntVector vector_negate(const IntVector& a) {
+    return vector_lanewise(a, a, [](int x, int) { return -x; });
+}
+
+inline bool vector_equals(const IntVector& a, const IntVector& b) {
+    return std::equal(a.lanes, a.lanes + 4, b.lanes);
+}
+
+#endif
+
+// No SIMD instruction for these on every target
+
+#if !defined(SIMPLE_LANG_HAS_INT_VECTOR_MULTIPLY)
+
+inline IntVector vector_multiply(const IntVector& a, const IntVector& b) {
+    IntVector result;
+    result.type = a.type;
+
+    for (size_t i = 0; i < 4; i++) {
+        result.lanes[i] = a.lanes[i] * b.lanes[i];
+    }
+
+    return result;
+}
+
+inline IntVector vector_multiply(const IntVector& a, int b) {
+    IntVector result;
+    result.type = a.type;
+
+    for (size_t i = 0; i < 4; i++) {
+        result.lanes[i] = a.lanes[i] * b;
+    }
+
+    return result;
+}
+
+#endif
+
+// Only the lanes in use are divided so the unused zero lanes can't divide by zero
+inline IntVector vector_divide(const IntVector& a, const IntVector& b) {
+    IntVector result{};
+    result.type = a.type;
+
+    for (size_t i = 0; i < vector_width(a.type); i++) {
+        result.lanes[i] = a.lanes[i] / b.lanes[i];
+    }
+
+    return result;
+}
+
+inline int vector_dot(const IntVector& a, const IntVector& b) {
+    IntVector products = vector_multiply(a, b);
+    return products.lanes[0] + products.lanes[1] + products.lanes[2] + products.lanes[3];
+}
+
+inline float vector_length(const FloatVector& a) {
+    return std::sqrt(vector_dot(a, a));
+}
@@ -0,0 +1,77 @@
+#include "vm_memory.h"
+
+// Blocks up to this size are pooled, a string header and a few dozen characters fit
+// well within it
+static constexpr size_t LARGEST_POOLED_BLOCK = 512;
+
+static std::pmr::pool_options get_pool_options() {
+    std::pmr::pool_options options;
+    options.largest_required_pool_block = LARGEST_POOLED_BLOCK;
+    return options;
+}
+
+VmMemory::UpstreamResource::UpstreamResource(std::pmr::memory_resource* upstream)
+    : m_upstream (upstream)
+{}
+
+void* VmMemory::UpstreamResource::do_allocate(size_t bytes, size_t alignment) {
+    void* pointer = m_upstream->allocate(bytes, alignment);
+    bytes_reserved.fetch_add(bytes, std::memory_order_relaxed);
+    return pointer;
+}
+
+void VmMemory::UpstreamResource::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    bytes_reserved.fetch_sub(bytes, std::memory_order_relaxed);
+    m_upstream->deallocate(pointer, bytes, alignment);
+}
+
+bool VmMemory::UpstreamResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+VmMemory::VmMemory(std::pmr::memory_resource* upstream)
+    : m_upstream    (upstream)
+    , m_pools       (get_pool_options(), &m_upstream)
+    , m_stats_start (std::chrono::steady_clock::now())
+{}
+
+VmMemoryStats VmMemory::get_stats() const {
+    VmMemoryStats stats;
+    stats.bytes_live = m_bytes_live.load(std::memory_order_relaxed);
+    stats.bytes_peak = m_bytes_peak.load(std::memory_order_relaxed);
+    stats.bytes_reserved = m_upstream.bytes_reserved.load(std::memory_order_relaxed);
+    stats.allocation_count = m_allocation_count.load(std::memory_order_relaxed);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_stats_start;
+    stats.allocations_per_second = elapsed.count() > 0.0 ? stats.allocation_count / elapsed.count() : 0.0;
+
+    return stats;
+}
+
+void VmMemory::reset_stats() {
+    m_bytes_peak.store(m_bytes_live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_allocation_count.store(0, std::memory_order_relaxed);
+    m_stats_start = std::chrono::steady_clock::now();
+}
+
+void* VmMemory::do_allocate(size_t bytes, size_t alignment) {
+    void* pointer = m_pools.allocate(bytes, alignment);
+
+    size_t live = m_bytes_live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = m_bytes_peak.load(std::memory_order_relaxed);
+
+    while (live > peak && !m_bytes_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+
+    m_allocation_count.fetch_add(1, std::memory_order_relaxed);
+
+    return pointer;
+}
+
+void VmMemory::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    m_bytes_live.fetch_sub(bytes, std::memory_order_relaxed);
+    m_pools.deallocate(pointer, bytes, alignment);
+}
+
+bool VmMemory::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
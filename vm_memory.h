@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory_resource>
+
+struct VmMemoryStats {
+    // Handed out to the vm and not given back yet
+    size_t bytes_live;
+    size_t bytes_peak;
+
+    // Taken from the upstream resource, including what the pools keep spare
+    size_t bytes_reserved;
+
+    size_t allocation_count;
+    double allocations_per_second;
+};
+
+// Where a vm's strings, arena chunks, stack and variables get their memory. Small
+// blocks come out of size classed pools, everything else and the pools themselves
+// come from the upstream resource, so a host with its own allocator or a memory
+// budget passes it in here. Safe to free into from any thread, strings handed to the
+// host may be dropped anywhere.
+class VmMemory : public std::pmr::memory_resource {
+public:
+    explicit VmMemory(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+    VmMemoryStats get_stats() const;
+
+    // Starts counting the peak, the allocations and their rate over from now
+    void reset_stats();
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    // Counts what the pools take from the host
+    class UpstreamResource : public std::pmr::memory_resource {
+    public:
+        explicit UpstreamResource(std::pmr::memory_resource* upstream);
+
+        std::atomic<size_t> bytes_reserved = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+        std::pmr::memory_resource* m_upstream;
+    };
+
+    UpstreamResource m_upstream;
+    std::pmr::synchronized_pool_resource m_pools;
+
+    std::atomic<size_t> m_bytes_live = 0;
+    std::atomic<size_t> m_bytes_peak = 0;
+    std::atomic<size_t> m_allocation_count = 0;
+    std::chrono::steady_clock::time_point m_stats_start;
+};
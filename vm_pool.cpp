@@ -0,0 +1,61 @@
+#include "vm_pool.h"
+
+PooledVm::PooledVm(VmPool& pool, const Program& program, std::unique_ptr<ByteCodeVm> vm)
+    : m_pool    (&pool)
+    , m_program (&program)
+    , m_vm      (std::move(vm))
+{}
+
+PooledVm::~PooledVm() {
+    if (m_vm) {
+        m_pool->release(*m_program, std::move(m_vm));
+    }
+}
+
+ByteCodeVm& PooledVm::operator*() const {
+    return *m_vm;
+}
+
+ByteCodeVm* PooledVm::operator->() const {
+    return m_vm.get();
+}
+
+VmPool& VmPool::local() {
+    thread_local VmPool pool;
+    return pool;
+}
+
+PooledVm VmPool::acquire(const Program& program) {
+    ProgramEntry& entry = m_programs[&program];
+
+    if (!entry.engine) {
+        entry.engine = std::make_unique<Engine>(program);
+    }
+
+    if (entry.idle.size() == 0) {
+        return PooledVm(*this, program, std::make_unique<ByteCodeVm>(*entry.engine));
+    }
+
+    std::unique_ptr<ByteCodeVm> vm = std::move(entry.idle.back());
+    entry.idle.pop_back();
+    vm->reset();
+
+    return PooledVm(*this, program, std::move(vm));
+}
+
+void VmPool::release(const Program& program, std::unique_ptr<ByteCodeVm> vm) {
+    m_programs[&program].idle.push_back(std::move(vm));
+}
+
+void VmPool::forget(const Program& program) {
+    m_programs.erase(&program);
+}
+
+size_t VmPool::get_idle_count(const Program& program) const {
+    auto itr = m_programs.find(&program);
+    if (itr == m_programs.end()) {
+        return 0;
+    }
+
+    return itr->second.idle.size();
+}
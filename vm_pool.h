@@ -0,0 +1,54 @@
+#pragma once
+
+#include "byte_code_vm.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class VmPool;
+
+// A vm borrowed from a VmPool, handed back when this goes out of scope
+class PooledVm {
+public:
+    PooledVm(VmPool& pool, const Program& program, std::unique_ptr<ByteCodeVm> vm);
+
+    PooledVm(PooledVm&& other) = default;
+
+    ~PooledVm();
+
+    ByteCodeVm& operator*() const;
+
+    ByteCodeVm* operator->() const;
+
+private:
+    VmPool* m_pool;
+    const Program* m_program;
+    std::unique_ptr<ByteCodeVm> m_vm;
+};
+
+// Keeps finished vms around per program so their stack, variables and call stack
+// don't need to be allocated again. The vms for a program share one engine. Pools are
+// not shared between threads, use local() to get the one for the calling thread.
+class VmPool {
+public:
+    static VmPool& local();
+
+    // The program must outlive every vm handed out for it
+    PooledVm acquire(const Program& program);
+
+    void release(const Program& program, std::unique_ptr<ByteCodeVm> vm);
+
+    // Drops the engine and idle vms for a program, only call once all its vms are returned
+    void forget(const Program& program);
+
+    size_t get_idle_count(const Program& program) const;
+
+private:
+    struct ProgramEntry {
+        std::unique_ptr<Engine> engine;
+        std::vector<std::unique_ptr<ByteCodeVm>> idle;
+    };
+
+    std::unordered_map<const Program*, ProgramEntry> m_programs;
+};
@@ -0,0 +1,49 @@
+#include "vm_string.h"
+
+#include "bump_arena.h"
+
+#include <cstring>
+#include <new>
+
+VmStringBuffer* vm_string_allocate(std::string_view value, std::pmr::memory_resource* memory) {
+    if (value.empty()) {
+        return nullptr;
+    }
+
+    void* block = memory->allocate(sizeof(VmStringBuffer) + value.size(), alignof(VmStringBuffer));
+
+    VmStringBuffer* buffer = new (block) VmStringBuffer();
+    buffer->reference_count.store(1, std::memory_order_relaxed);
+    buffer->memory = memory;
+    buffer->length = value.size();
+    buffer->capacity = value.size();
+
+    std::memcpy(buffer->data(), value.data(), value.size());
+
+    return buffer;
+}
+
+VmStringBuffer* vm_string_allocate(BumpArena& arena, size_t capacity) {
+    void* block = arena.allocate(sizeof(VmStringBuffer) + capacity, alignof(VmStringBuffer));
+
+    VmStringBuffer* buffer = new (block) VmStringBuffer();
+    buffer->reference_count.store(1, std::memory_order_relaxed);
+    buffer->memory = nullptr;
+    buffer->length = 0;
+    buffer->capacity = capacity;
+
+    return buffer;
+}
+
+void vm_string_append(VmStringBuffer* buffer, std::string_view value) {
+    std::memcpy(buffer->data() + buffer->length, value.data(), value.size());
+    buffer->length += value.size();
+}
+
+void vm_string_free(VmStringBuffer* buffer) {
+    std::pmr::memory_resource* memory = buffer->memory;
+    size_t size = sizeof(VmStringBuffer) + buffer->capacity;
+
+    buffer->~VmStringBuffer();
+    memory->deallocate(buffer, size, alignof(VmStringBuffer));
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+class BumpArena;
+
+// The characters of a string live in the same block, right after this header
+struct VmStringBuffer {
+    std::atomic<uint32_t> reference_count;
+
+    // Where the buffer goes back to, nullptr for arena strings
+    std::pmr::memory_resource* memory;
+
+    size_t length;
+    size_t capacity;
+
+    const char* data() const {
+        return reinterpret_cast<const char*>(this + 1);
+    }
+
+    char* data() {
+        return reinterpret_cast<char*>(this + 1);
+    }
+};
+
+// Returns nullptr for the empty string, which never allocates
+VmStringBuffer* vm_string_allocate(std::string_view value, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+// An empty string with room for capacity characters. Arena strings aren't freed
+// when their last reference goes, the arena takes all of them back at once.
+VmStringBuffer* vm_string_allocate(BumpArena& arena, size_t capacity);
+
+// Only for a buffer nothing else refers to yet, or that has a single reference
+void vm_string_append(VmStringBuffer* buffer, std::string_view value);
+
+void vm_string_free(VmStringBuffer* buffer);
+
+inline void vm_string_retain(VmStringBuffer* buffer) {
+    if (buffer) {
+        buffer->reference_count.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+inline void vm_string_release(VmStringBuffer* buffer) {
+    if (buffer && buffer->reference_count.fetch_sub(1, std::memory_order_acq_rel) == 1 && buffer->memory) {
+        vm_string_free(buffer);
+    }
+}
+
+inline std::string_view vm_string_view(const VmStringBuffer* buffer) {
+    return buffer ? std::string_view(buffer->data(), buffer->length) : std::string_view();
+}
+
+// Script strings are immutable, so every copy of one shares the same buffer and
+// copying only counts another reference. The stack, variables and constants all
+// hold strings this way, so a string is copied once when it is created and never
+// again on its way through the program. Only a string with a single reference is
+// ever appended to in place, where nothing else can see it change.
+class VmString {
+public:
+    VmString() = default;
+
+    VmString(std::string_view value)
+        : m_buffer (vm_string_allocate(value))
+    {}
+
+    VmString(std::string_view value, std::pmr::memory_resource* memory)
+        : m_buffer (vm_string_allocate(value, memory))
+    {}
+
+    VmString(const std::string& value)
+        : VmString(std::string_view(value))
+    {}
+
+    VmString(const char* value)
+        : VmString(std::string_view(value))
+    {}
+
+    VmString(const VmString& other)
+        : m_buffer (other.m_buffer)
+    {
+        vm_string_retain(m_buffer);
+    }
+
+    VmString(VmString&& other) noexcept
+        : m_buffer (other.m_buffer)
+    {
+        other.m_buffer = nullptr;
+    }
+
+    ~VmString() {
+        vm_string_release(m_buffer);
+    }
+
+    VmString& operator=(const VmString& other) {
+        vm_string_retain(other.m_buffer);
+        vm_string_release(m_buffer);
+        m_buffer = other.m_buffer;
+        return *this;
+    }
+
+    VmString& operator=(VmString&& other) noexcept {
+        if (this != &other) {
+            vm_string_release(m_buffer);
+            m_buffer = other.m_buffer;
+            other.m_buffer = nullptr;
+        }
+
+        return *this;
+    }
+
+    // Takes over a reference the caller already holds
+    static VmString adopt(VmStringBuffer* buffer) {
+        VmString string;
+        string.m_buffer = buffer;
+        return string;
+    }
+
+    // Adds a reference to a buffer held somewhere else
+    static VmString share(VmStringBuffer* buffer) {
+        vm_string_retain(buffer);
+        return adopt(buffer);
+    }
+
+    // Hands the reference over to the caller, leaving this empty
+    VmStringBuffer* release_buffer() {
+        VmStringBuffer* buffer = m_buffer;
+        m_buffer = nullptr;
+        return buffer;
+    }
+
+    VmStringBuffer* get_buffer() const {
+        return m_buffer;
+    }
+
+    std::string_view view() const {
+        return vm_string_view(m_buffer);
+    }
+
+    operator std::string_view() const {
+        return view();
+    }
+
+    size_t size() const {
+        return m_buffer ? m_buffer->length : 0;
+    }
+
+    bool is_in_arena() const {
+        return m_buffer && !m_buffer->memory;
+    }
+
+    uint32_t use_count() const {
+        return m_buffer ? m_buffer->reference_count.load(std::memory_order_relaxed) : 0;
+    }
+
+    bool operator==(const VmString& other) const {
+        return m_buffer == other.m_buffer || view() == other.view();
+    }
+
+    bool operator!=(const VmString& other) const {
+        return !(*this == other);
+    }
+
+private:
+    VmStringBuffer* m_buffer = nullptr;
+};
+
+// Copies an arena string into memory so it can outlive the arena, other strings are
+// shared as they are
+inline VmString vm_string_detach_from_arena(const VmString& value, std::pmr::memory_resource* memory) {
+    return value.is_in_arena() ? VmString(value.view(), memory) : value;
+}
+
+// For strings handed to the host, which may keep them after the vm is gone. Only
+// strings already on the default heap are shared, anything in the vm's arena or
+// memory is copied there.
+inline VmString vm_string_detach(const VmString& value) {
+    VmStringBuffer* buffer = value.get_buffer();
+
+    if (!buffer || buffer->memory == std::pmr::get_default_resource()) {
+        return value;
+    }
+
+    return VmString(value.view(), std::pmr::get_default_resource());
+}